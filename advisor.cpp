@@ -0,0 +1,472 @@
+// advisor.cpp - index recommendations from executed statements
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include "advisor.h"
+#include "schema.h"
+
+using namespace sqlite;
+
+namespace {
+
+    // Identifiers, keywords and operators of a statement.
+    struct token {
+        enum type { IDENT, KEYWORD, OP, OTHER };
+        type kind;
+        std::string text;   // upper case for keywords
+        std::string qual;   // qualifier of a column
+        bool call = false;  // function name
+
+        token(type kind, std::string text)
+            : kind(kind), text(std::move(text))
+        { }
+    };
+
+    std::vector<token> tokenize(const char* s)
+    {
+        std::vector<token> ts;
+
+        while (*s) {
+            unsigned char c = *s;
+            if (isspace(c)) {
+                ++s;
+            }
+            else if (c == '-' && s[1] == '-') {
+                while (*s && *s != '\n')
+                    ++s;
+            }
+            else if (c == '/' && s[1] == '*') {
+                const char* e = strstr(s + 2, "*/");
+                s = e ? e + 2 : s + strlen(s);
+            }
+            else if (c == '\'') {
+                for (++s; *s && !(*s == '\'' && s[1] != '\''); ++s)
+                    if (*s == '\'')
+                        ++s;
+                if (*s)
+                    ++s;
+                ts.emplace_back(token::OTHER, "'");
+            }
+            else if (c == '"' || c == '`' || c == '[') {
+                char close = c == '[' ? ']' : c;
+                std::string id;
+                for (++s; *s && !(*s == close && s[1] != close); ++s) {
+                    id.push_back(*s);
+                    if (*s == close)
+                        ++s;
+                }
+                if (*s)
+                    ++s;
+                ts.emplace_back(token::IDENT, id);
+            }
+            else if (isalpha(c) || c == '_' || c >= 0x80) {
+                const char* b = s;
+                while (isalnum(static_cast<unsigned char>(*s)) || *s == '_' || *s == '$' || static_cast<unsigned char>(*s) >= 0x80)
+                    ++s;
+                std::string w(b, s);
+                if (sqlite3_keyword_check(b, static_cast<int>(s - b))) {
+                    for (auto& wi : w)
+                        wi = static_cast<char>(toupper(static_cast<unsigned char>(wi)));
+                    ts.emplace_back(token::KEYWORD, w);
+                }
+                else {
+                    ts.emplace_back(token::IDENT, w);
+                }
+            }
+            else if (strchr("=<>!", c)) {
+                std::string op(1, c);
+                if (s[1] == '=' || (c == '<' && s[1] == '>'))
+                    op.push_back(s[1]);
+                s += op.size();
+                ts.emplace_back(token::OP, op);
+            }
+            else {
+                ++s;
+                ts.emplace_back(token::OTHER, std::string(1, c));
+            }
+
+            // qualified names and function calls
+            size_t n = ts.size();
+            if (n >= 3 && ts[n - 1].kind == token::IDENT && ts[n - 2].text == "." && ts[n - 3].kind == token::IDENT) {
+                ts[n - 1].qual = ts[n - 3].text;
+                ts.erase(ts.end() - 3, ts.end() - 1);
+            }
+            else if (n >= 2 && ts[n - 1].text == "(" && ts[n - 2].kind != token::OTHER) {
+                ts[n - 2].call = true;
+            }
+        }
+
+        return ts;
+    }
+
+    bool column(const token& t)
+    {
+        return t.kind == token::IDENT && !t.call;
+    }
+
+    // Column compared with something in a WHERE or ON clause.
+    struct predicate {
+        std::string qual;
+        std::string name;
+        bool equality;
+    };
+
+    std::vector<predicate> predicates(const std::vector<token>& ts)
+    {
+        std::vector<predicate> ps;
+
+        for (size_t k = 1; k < ts.size(); ++k) {
+            const auto& t = ts[k];
+            bool eq = t.text == "=" || t.text == "==" || t.text == "IN" || t.text == "IS";
+            bool range = t.text == "<" || t.text == "<=" || t.text == ">" || t.text == ">=" || t.text == "BETWEEN";
+            if (!eq && !range)
+                continue;
+            if (column(ts[k - 1]))
+                ps.push_back({ ts[k - 1].qual, ts[k - 1].text, eq });
+            if (t.kind == token::OP && k + 1 < ts.size() && column(ts[k + 1]))
+                ps.push_back({ ts[k + 1].qual, ts[k + 1].text, eq });
+        }
+
+        return ps;
+    }
+
+    // Map aliases and names of tables in the statement to table names.
+    std::map<std::string, std::string> aliases(open& db, const std::vector<token>& ts)
+    {
+        std::map<std::string, std::string> as;
+
+        for (size_t i = 0; i < ts.size(); ++i) {
+            if (!column(ts[i]) || !ts[i].qual.empty())
+                continue;
+            const table_info* t = schema(db).table(db, ts[i].text);
+            if (!t)
+                continue;
+            as[ts[i].text] = t->name;
+            size_t j = i + 1;
+            if (j < ts.size() && ts[j].text == "AS")
+                ++j;
+            if (j < ts.size() && column(ts[j]) && ts[j].qual.empty() && !schema(db).table(db, ts[j].text))
+                as[ts[j].text] = t->name;
+        }
+
+        return as;
+    }
+
+    // A loop from EXPLAIN QUERY PLAN that visits every row of a table.
+    struct loop {
+        std::string name;   // alias or table
+        std::vector<std::string> automatic; // columns of an automatic index
+    };
+
+    // SCAN t, SCAN TABLE t AS a, SEARCH t USING AUTOMATIC COVERING INDEX (a=? AND b>?)
+    bool parse_loop(const std::string& detail, loop& l)
+    {
+        std::vector<std::string> w;
+        for (size_t b = 0, e; b < detail.size(); b = e + 1) {
+            e = detail.find(' ', b);
+            if (e == std::string::npos)
+                e = detail.size();
+            w.emplace_back(detail.substr(b, e - b));
+        }
+        if (w.size() < 2 || (w[0] != "SCAN" && w[0] != "SEARCH"))
+            return false;
+
+        size_t i = 1;
+        if (w[i] == "TABLE" && i + 1 < w.size())
+            ++i;
+        l.name = w[i++];
+        if (i + 1 < w.size() && w[i] == "AS") {
+            l.name = w[i + 1];
+            i += 2;
+        }
+        l.automatic.clear();
+
+        if (detail.find("AUTOMATIC") != std::string::npos) {
+            size_t b = detail.find('('), e = detail.rfind(')');
+            if (b == std::string::npos || e == std::string::npos)
+                return false;
+            std::string cols = detail.substr(b + 1, e - b - 1);
+            for (size_t p = 0; p < cols.size();) {
+                size_t q = cols.find_first_of("=<>", p);
+                if (q == std::string::npos)
+                    break;
+                l.automatic.push_back(cols.substr(p, q - p));
+                p = cols.find(" AND ", q);
+                p = p == std::string::npos ? cols.size() : p + 5;
+            }
+
+            return !l.automatic.empty();
+        }
+
+        // full scans of a table or covering index
+        return w[0] == "SCAN" && (i == w.size() || detail.find("COVERING INDEX") != std::string::npos);
+    }
+
+    std::string quote(const std::string& id)
+    {
+        std::string q("\"");
+        for (char c : id) {
+            q.push_back(c);
+            if (c == '"')
+                q.push_back(c);
+        }
+        q.push_back('"');
+
+        return q;
+    }
+
+    std::string index_name(const std::string& table, const std::vector<std::string>& columns)
+    {
+        std::string name = "advisor_" + table;
+        for (const auto& c : columns)
+            name.append("_" + c);
+        for (auto& c : name) {
+            if (!isalnum(static_cast<unsigned char>(c)))
+                c = '_';
+        }
+
+        return name;
+    }
+
+    std::vector<std::string> plan(sqlite3* db, const std::string& sql)
+    {
+        std::vector<std::string> details;
+
+        sqlite3_stmt* pstmt = nullptr;
+        std::string eqp = "EXPLAIN QUERY PLAN " + sql;
+        if (SQLITE_OK != sqlite3_prepare_v2(db, eqp.c_str(), -1, &pstmt, nullptr))
+            throw std::runtime_error(sqlite3_errmsg(db));
+        while (SQLITE_ROW == sqlite3_step(pstmt))
+            details.emplace_back(reinterpret_cast<const char*>(sqlite3_column_text(pstmt, 3)));
+        sqlite3_finalize(pstmt);
+
+        return details;
+    }
+
+    // Fastest of repeat runs in seconds.
+    double run(sqlite3* db, const std::string& sql, unsigned repeat, size_t& rows)
+    {
+        double best = 0;
+
+        for (unsigned i = 0; i < repeat; ++i) {
+            auto t0 = std::chrono::steady_clock::now();
+            sqlite3_stmt* pstmt = nullptr;
+            if (SQLITE_OK != sqlite3_prepare_v2(db, sql.c_str(), -1, &pstmt, nullptr))
+                throw std::runtime_error(sqlite3_errmsg(db));
+            rows = 0;
+            int rc;
+            while (SQLITE_ROW == (rc = sqlite3_step(pstmt)))
+                ++rows;
+            sqlite3_finalize(pstmt);
+            if (rc != SQLITE_DONE)
+                throw std::runtime_error(sqlite3_errmsg(db));
+            double dt = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+            if (i == 0 || dt < best)
+                best = dt;
+        }
+
+        return best;
+    }
+
+}
+
+void index_advisor::observe(sqlite3_stmt* pstmt)
+{
+    if (!sqlite3_stmt_readonly(pstmt))
+        return;
+
+    size_t fullscan = sqlite3_stmt_status(pstmt, SQLITE_STMTSTATUS_FULLSCAN_STEP, 1);
+    size_t autoindex = sqlite3_stmt_status(pstmt, SQLITE_STMTSTATUS_AUTOINDEX, 1);
+    if (autoindex == 0 && fullscan < threshold)
+        return;
+
+    const char* sql = sqlite3_sql(pstmt);
+    auto i = statements.find(sql);
+    if (i == statements.end()) {
+        if (statements.size() >= capacity)
+            return;
+        i = statements.emplace(sql, observed{}).first;
+    }
+
+    observed& o = i->second;
+    ++o.executions;
+    o.fullscan += fullscan;
+    o.autoindex += autoindex;
+    if (char* sample = sqlite3_expanded_sql(pstmt)) {
+        o.sample = sample;
+        sqlite3_free(sample);
+    }
+}
+
+// Copy of the schema without data for trying candidate indexes.
+void index_advisor::refresh_shadow(open& db)
+{
+    int v = 0;
+    {
+        cached stmt(db, "PRAGMA schema_version");
+        if (SQLITE_ROW != sqlite3_step(stmt))
+            throw std::runtime_error(errmsg(stmt));
+        v = sqlite3_column_int(stmt, 0);
+    }
+    if (shadow && v == version)
+        return;
+
+    sqlite3_close(shadow);
+    shadow = nullptr;
+    if (SQLITE_OK != sqlite3_open(":memory:", &shadow))
+        throw std::runtime_error("index_advisor: cannot open shadow database");
+
+    // statements that do not work without the original data, like virtual tables, are skipped
+    sqlite3_stmt* pstmt = nullptr;
+    if (SQLITE_OK != sqlite3_prepare_v2(db, "SELECT sql FROM sqlite_master WHERE sql IS NOT NULL "
+        "AND name NOT LIKE 'sqlite_%' AND type IN ('table', 'index', 'view') "
+        "ORDER BY CASE type WHEN 'table' THEN 0 WHEN 'index' THEN 1 ELSE 2 END", -1, &pstmt, nullptr))
+        throw std::runtime_error(sqlite3_errmsg(db));
+    while (SQLITE_ROW == sqlite3_step(pstmt))
+        sqlite3_exec(shadow, reinterpret_cast<const char*>(sqlite3_column_text(pstmt, 0)), nullptr, nullptr, nullptr);
+    sqlite3_finalize(pstmt);
+
+    // use the statistics of the real data if ANALYZE has been run
+    if (SQLITE_OK == sqlite3_prepare_v2(db, "SELECT tbl, idx, stat FROM sqlite_stat1", -1, &pstmt, nullptr)) {
+        sqlite3_exec(shadow, "ANALYZE; DELETE FROM sqlite_stat1", nullptr, nullptr, nullptr);
+        sqlite3_stmt* pins = nullptr;
+        sqlite3_prepare_v2(shadow, "INSERT INTO sqlite_stat1 VALUES (?1, ?2, ?3)", -1, &pins, nullptr);
+        while (pins && SQLITE_ROW == sqlite3_step(pstmt)) {
+            for (int i = 0; i < 3; ++i)
+                sqlite3_bind_value(pins, i + 1, sqlite3_column_value(pstmt, i));
+            sqlite3_step(pins);
+            sqlite3_reset(pins);
+        }
+        sqlite3_finalize(pins);
+        sqlite3_exec(shadow, "ANALYZE sqlite_master", nullptr, nullptr, nullptr);
+    }
+    sqlite3_finalize(pstmt);
+
+    version = v;
+}
+
+// Does the planner use the index in the shadow schema?
+bool index_advisor::verify(const std::string& sql, const std::string& create, const std::string& name)
+{
+    if (SQLITE_OK != sqlite3_exec(shadow, create.c_str(), nullptr, nullptr, nullptr))
+        return false;
+
+    bool used = false;
+    try {
+        for (const auto& detail : plan(shadow, sql))
+            used = used || detail.find("INDEX " + name) != std::string::npos;
+    }
+    catch (const std::exception&) {
+        used = false;
+    }
+    sqlite3_exec(shadow, ("DROP INDEX " + quote(name)).c_str(), nullptr, nullptr, nullptr);
+
+    return used;
+}
+
+std::vector<index_recommendation> index_advisor::recommend(open& db)
+{
+    std::map<std::string, index_recommendation> recs; // by CREATE INDEX
+
+    refresh_shadow(db);
+    for (const auto& [sql, o] : statements) {
+        std::vector<std::string> details;
+        try {
+            details = plan(db, sql);
+        }
+        catch (const std::exception&) {
+            continue; // schema changed under the statement
+        }
+        auto ts = tokenize(sql.c_str());
+        auto as = aliases(db, ts);
+        auto ps = predicates(ts);
+
+        std::vector<index_recommendation> candidates;
+        loop l;
+        for (const auto& detail : details) {
+            if (!parse_loop(detail, l))
+                continue;
+            auto a = as.find(l.name);
+            const table_info* t = schema(db).table(db, a == as.end() ? l.name : a->second);
+            if (!t || t->type != "table")
+                continue;
+
+            index_recommendation r;
+            r.table = t->name;
+            if (!l.automatic.empty()) {
+                r.columns = l.automatic;
+            }
+            else {
+                // equality columns then one range column
+                for (int eq = 1; eq >= 0; --eq) {
+                    for (const auto& p : ps) {
+                        if (p.equality != (eq == 1))
+                            continue;
+                        if (!p.qual.empty() && sqlite3_stricmp(p.qual.c_str(), l.name.c_str()) != 0)
+                            continue;
+                        const column_info* c = t->column(p.name);
+                        if (c && std::find(r.columns.begin(), r.columns.end(), c->name) == r.columns.end()) {
+                            r.columns.push_back(c->name);
+                            if (!eq)
+                                break;
+                        }
+                    }
+                }
+            }
+            if (r.columns.empty())
+                continue;
+
+            std::string name = index_name(r.table, r.columns);
+            r.sql = "CREATE INDEX IF NOT EXISTS " + quote(name) + " ON " + quote(r.table) + "(";
+            for (size_t i = 0; i < r.columns.size(); ++i)
+                r.sql.append((i ? ", " : "") + quote(r.columns[i]));
+            r.sql.append(")");
+
+            if (verify(sql, r.sql, name))
+                candidates.push_back(std::move(r));
+        }
+
+        // rows visited are shared by the indexes that avoid them
+        for (auto& c : candidates) {
+            auto& r = recs[c.sql];
+            if (r.sql.empty())
+                r = std::move(c);
+            r.savings += (o.fullscan + o.autoindex) / candidates.size();
+            r.executions += o.executions;
+            if (r.statements.size() < 3)
+                r.statements.push_back(o.sample);
+        }
+    }
+
+    std::vector<index_recommendation> v;
+    for (auto& [sql, r] : recs)
+        v.push_back(std::move(r));
+    std::stable_sort(v.begin(), v.end(), [](const auto& a, const auto& b) { return a.savings > b.savings; });
+
+    return v;
+}
+
+std::vector<index_benchmark> index_advisor::apply(open& db, size_t n, unsigned repeat)
+{
+    std::vector<index_benchmark> report;
+
+    auto recs = recommend(db);
+    for (size_t i = 0; i < n && i < recs.size(); ++i) {
+        size_t k = report.size();
+        for (const auto& sql : recs[i].statements) {
+            index_benchmark b;
+            b.index = recs[i].sql;
+            b.statement = sql;
+            b.before = run(db, sql, repeat, b.rows);
+            report.push_back(std::move(b));
+        }
+        exec(db, recs[i].sql.c_str());
+        for (; k < report.size(); ++k)
+            report[k].after = run(db, report[k].statement, repeat, report[k].rows);
+    }
+    // counters were for the old plans
+    statements.clear();
+
+    return report;
+}
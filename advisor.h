@@ -0,0 +1,95 @@
+// advisor.h - index recommendations from executed statements
+#pragma once
+#include <map>
+#include <string>
+#include <vector>
+#include "sqlite.h"
+
+namespace sqlite {
+
+    struct index_recommendation {
+        std::string sql;        // CREATE INDEX statement
+        std::string table;
+        std::vector<std::string> columns;
+        size_t savings = 0;     // rows visited by full scans and automatic indexes
+        size_t executions = 0;  // of the statements that would use the index
+        std::vector<std::string> statements; // with parameter values expanded
+    };
+
+    struct index_benchmark {
+        std::string index;      // CREATE INDEX statement
+        std::string statement;
+        double before = 0;      // seconds
+        double after = 0;
+        size_t rows = 0;
+    };
+
+    // Watch read-only statements after they execute and recommend indexes
+    // for tables they scan or build automatic indexes on.
+    // Candidates come from EXPLAIN QUERY PLAN and the WHERE and ON
+    // predicates of the statement. A candidate is kept if the query planner
+    // uses it in a copy of the schema without data, like the sqlite3_expert
+    // extension, and is ranked by the rows its statements visited.
+    class index_advisor {
+        struct observed {
+            size_t executions = 0;
+            size_t fullscan = 0;
+            size_t autoindex = 0;
+            std::string sample; // sqlite3_expanded_sql
+        };
+        std::map<std::string, observed> statements; // by sqlite3_sql
+        sqlite3* shadow = nullptr;
+        int version = -1; // schema_version of shadow
+        void refresh_shadow(open& db);
+        bool verify(const std::string& sql, const std::string& create, const std::string& name);
+    public:
+        bool enabled = false;   // set by SQLITE.ADVISOR.WATCH
+        size_t threshold = 1000; // full scan steps that make a statement worth a look
+        size_t capacity = 256;   // statements remembered
+
+        index_advisor() = default;
+        index_advisor(const index_advisor&) = delete;
+        index_advisor& operator=(const index_advisor&) = delete;
+        ~index_advisor()
+        {
+            sqlite3_close(shadow);
+        }
+
+        size_t size() const
+        {
+            return statements.size();
+        }
+        void clear()
+        {
+            statements.clear();
+        }
+
+        // Read and reset the status counters of a statement that has run.
+        void observe(sqlite3_stmt* pstmt);
+
+        // Indexes ordered by savings.
+        std::vector<index_recommendation> recommend(open& db);
+
+        // Time the statements of the first n recommendations, create the
+        // indexes, and time them again. Each statement runs repeat times
+        // and the fastest time is reported.
+        std::vector<index_benchmark> apply(open& db, size_t n = 1, unsigned repeat = 3);
+    };
+
+    // Index advisor of a connection.
+    inline index_advisor& advisor(open& db)
+    {
+        if (!db.advisor)
+            db.advisor = std::make_shared<index_advisor>();
+
+        return *db.advisor;
+    }
+
+    // Report a statement that has run to the connection advisor if there is one.
+    inline void observe(open& db, sqlite3_stmt* pstmt)
+    {
+        if (db.advisor && db.advisor->enabled)
+            db.advisor->observe(pstmt);
+    }
+
+}
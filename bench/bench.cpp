@@ -0,0 +1,597 @@
+// bench.cpp - benchmarks of the portable core on chinook.db and generated data
+// Build and run from the repository root on Linux:
+//   g++ -std=c++20 -O2 -DNDEBUG -o xllsqlite_bench bench/bench.cpp builder.cpp fingerprint.cpp carray.cpp csv.cpp -lsqlite3 -lpthread
+//   ./xllsqlite_bench --db chinook.db --json bench.json
+// Options:
+//   --db file        chinook database. Default is chinook.db.
+//   --rows n         rows of generated data. Default is 200000.
+//   --filter text    only run benchmarks whose name contains text.
+//   --time seconds   minimum time per benchmark. Default is 0.5.
+//   --json file      write results as JSON. Default is standard output.
+//   --baseline file  compare results with those in file from an earlier run.
+//   --threshold pct  change in median latency that is reported. Default is 5.
+//   --compare base test
+//                    compare two result files without running benchmarks.
+// A run that reports regressions against its baseline exits with status 3.
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <random>
+#include "bench.h"
+#include "grid.h"
+#include "../sqlite.h"
+#include "../builder.h"
+#include "../carray.h"
+#include "../csv.h"
+#include "../fingerprint.h"
+#include "../query.h"
+
+using namespace sqlite;
+
+// Count heap allocations of C++ and of SQLite.
+static size_t allocations = 0;
+
+void* operator new(size_t n)
+{
+    ++allocations;
+    if (void* p = malloc(n ? n : 1))
+        return p;
+
+    throw std::bad_alloc();
+}
+// GCC warns about free when it inlines these into std::allocator
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+namespace {
+
+    sqlite3_mem_methods system_malloc;
+
+    void* counted_malloc(int n)
+    {
+        ++allocations;
+
+        return system_malloc.xMalloc(n);
+    }
+    void* counted_realloc(void* p, int n)
+    {
+        ++allocations;
+
+        return system_malloc.xRealloc(p, n);
+    }
+
+    // Must be called before SQLite is initialized.
+    void count_allocations()
+    {
+        sqlite3_config(SQLITE_CONFIG_GETMALLOC, &system_malloc);
+        sqlite3_mem_methods counted = system_malloc;
+        counted.xMalloc = counted_malloc;
+        counted.xRealloc = counted_realloc;
+        sqlite3_config(SQLITE_CONFIG_MALLOC, &counted);
+    }
+
+    // sqlite::value before it stored values inline.
+    class legacy_value {
+        sqlite3_value* val;
+    public:
+        legacy_value()
+            : val(sqlite3_value_dup(nullptr))
+        { }
+        explicit legacy_value(const sqlite3_value* v)
+            : val(sqlite3_value_dup(v))
+        { }
+        legacy_value(const legacy_value& v)
+            : val(sqlite3_value_dup(v.val))
+        { }
+        legacy_value& operator=(const legacy_value& v)
+        {
+            if (this != &v) {
+                sqlite3_value_free(val);
+                val = sqlite3_value_dup(v.val);
+            }
+
+            return *this;
+        }
+        ~legacy_value()
+        {
+            sqlite3_value_free(val);
+        }
+        int type() const
+        {
+            return sqlite3_value_type(val);
+        }
+    };
+
+    sqlite3_stmt* prepare(open& db, const char* sql)
+    {
+        sqlite3_stmt* pstmt = nullptr;
+        if (SQLITE_OK != sqlite3_prepare_v2(db, sql, -1, &pstmt, nullptr))
+            throw std::runtime_error(sqlite3_errmsg(db));
+
+        return pstmt;
+    }
+
+    // Rows returned by sql.
+    double count(open& db, const char* sql)
+    {
+        sqlite3_stmt* pstmt = prepare(db, sql);
+        double n = 0;
+        while (SQLITE_ROW == sqlite3_step(pstmt))
+            ++n;
+        sqlite3_finalize(pstmt);
+
+        return n;
+    }
+
+    // gen(id, k, x, s) with k in [0, 1000), x in [0, 1), and s of 8 to 40 characters.
+    void generate(open& db, int rows)
+    {
+        exec(db, "CREATE TABLE gen(id INTEGER PRIMARY KEY, k INTEGER, x REAL, s TEXT)");
+        exec(db, "BEGIN");
+        sqlite3_stmt* ins = prepare(db, "INSERT INTO gen(k, x, s) VALUES(?1, ?2, ?3)");
+        std::mt19937_64 rng(42);
+        std::string s;
+        for (int i = 0; i < rows; ++i) {
+            s.assign(8 + rng() % 33, 'a' + static_cast<char>(rng() % 26));
+            sqlite3_bind_int64(ins, 1, static_cast<sqlite_int64>(rng() % 1000));
+            sqlite3_bind_double(ins, 2, std::generate_canonical<double, 53>(rng));
+            sqlite3_bind_text(ins, 3, s.data(), static_cast<int>(s.size()), SQLITE_STATIC);
+            sqlite3_step(ins);
+            sqlite3_reset(ins);
+        }
+        sqlite3_finalize(ins);
+        exec(db, "COMMIT");
+        exec(db, "CREATE INDEX gen_k ON gen(k)");
+    }
+
+    void prepare_benchmarks(bench::suite& s, open& db)
+    {
+        const char* simple = "SELECT Name FROM tracks WHERE TrackId = ?";
+        const char* join = "SELECT t.Name, a.Title, r.Name FROM tracks t "
+            "JOIN albums a ON a.AlbumId = t.AlbumId JOIN artists r ON r.ArtistId = a.ArtistId "
+            "WHERE t.GenreId = ? ORDER BY t.Name";
+
+        s.run("prepare.simple", [&](size_t) {
+            sqlite3_finalize(prepare(db, simple));
+        });
+        s.run("prepare.join", [&](size_t) {
+            sqlite3_finalize(prepare(db, join));
+        });
+        s.run("prepare.cached", [&](size_t) {
+            cached stmt(db, join);
+        });
+    }
+
+    void step_benchmarks(bench::suite& s, open& db)
+    {
+        sqlite3_stmt* scan = prepare(db, "SELECT * FROM tracks");
+        double rows = count(db, "SELECT * FROM tracks");
+        s.run("step.scan_tracks", [&](size_t) {
+            int n = sqlite3_column_count(scan);
+            while (SQLITE_ROW == sqlite3_step(scan)) {
+                for (int i = 0; i < n; ++i)
+                    sqlite3_column_text(scan, i);
+            }
+            sqlite3_reset(scan);
+        }, rows);
+        sqlite3_finalize(scan);
+
+        sqlite3_stmt* lookup = prepare(db, "SELECT Name, Milliseconds FROM tracks WHERE TrackId = ?");
+        s.run("step.lookup", [&](size_t i) {
+            sqlite3_bind_int64(lookup, 1, 1 + static_cast<sqlite_int64>(i % 3503));
+            while (SQLITE_ROW == sqlite3_step(lookup))
+                sqlite3_column_text(lookup, 0);
+            sqlite3_reset(lookup);
+        });
+        sqlite3_finalize(lookup);
+
+        sqlite3_stmt* all = prepare(db, "SELECT id, x, s FROM gen");
+        double gen_rows = count(db, "SELECT id FROM gen");
+        s.run("step.gen_scan", [&](size_t) {
+            size_t n = 0;
+            while (SQLITE_ROW == sqlite3_step(all)) {
+                n += static_cast<size_t>(sqlite3_column_int64(all, 0)) + static_cast<size_t>(sqlite3_column_double(all, 1));
+                n += static_cast<size_t>(sqlite3_column_bytes(all, 2)) + (sqlite3_column_text(all, 2) != nullptr);
+            }
+            sqlite3_reset(all);
+            if (n == 0)
+                fprintf(stderr, "step.gen_scan: no rows\n");
+        }, gen_rows);
+        s.run("step.gen_scan_query", [&](size_t) {
+            size_t n = 0;
+            for (auto [id, x, t] : query<int64_t, double, std::string_view>(all))
+                n += static_cast<size_t>(id) + static_cast<size_t>(x) + t.size();
+            if (n == 0)
+                fprintf(stderr, "step.gen_scan_query: no rows\n");
+        }, gen_rows);
+        sqlite3_finalize(all);
+
+        sqlite3_stmt* range = prepare(db, "SELECT id, x, s FROM gen WHERE k = ?");
+        double per_key = count(db, "SELECT * FROM gen WHERE k = 0");
+        s.run("step.gen_index_range", [&](size_t i) {
+            sqlite3_bind_int64(range, 1, static_cast<sqlite_int64>(i % 1000));
+            while (SQLITE_ROW == sqlite3_step(range))
+                sqlite3_column_text(range, 2);
+            sqlite3_reset(range);
+        }, per_key);
+        sqlite3_finalize(range);
+    }
+
+    void exec_benchmarks(bench::suite& s, open& db)
+    {
+        struct query {
+            const char* name;
+            const char* sql;
+        } queries[] = {
+            { "tracks", "SELECT * FROM tracks" },
+            { "invoice_join", "SELECT i.InvoiceId, c.LastName, i.Total, l.UnitPrice, l.Quantity "
+                "FROM invoices i JOIN customers c USING(CustomerId) JOIN invoice_items l USING(InvoiceId)" },
+            { "gen_group_by", "SELECT k, count(*), avg(x), max(s) FROM gen GROUP BY k" },
+            { "gen_2000", "SELECT * FROM gen LIMIT 2000" },
+        };
+        for (const auto& q : queries) {
+            double rows = count(db, q.sql);
+            sqlite3_stmt* stmt = prepare(db, q.sql);
+            s.run(std::string("exec.") + q.name, [&](size_t) {
+                auto o = bench::exec(stmt, true);
+                sqlite3_reset(stmt);
+            }, rows);
+            s.run(std::string("exec12.") + q.name, [&](size_t) {
+                auto o = bench::exec12(stmt, true);
+                sqlite3_reset(stmt);
+            }, rows);
+            sqlite3_finalize(stmt);
+        }
+    }
+
+    void bind_benchmarks(bench::suite& s, open& db)
+    {
+        sqlite3_stmt* stmt = prepare(db, "SELECT ?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8, ?9, ?10");
+        std::vector<param> ps;
+        for (int i = 0; i < 10; ++i) {
+            if (i % 3 == 0)
+                ps.emplace_back(static_cast<sqlite_int64>(i));
+            else if (i % 3 == 1)
+                ps.emplace_back(i + 0.5);
+            else
+                ps.emplace_back(std::string("parameter ") + std::to_string(i));
+        }
+        s.run("bind.params10", [&](size_t) {
+            for (int i = 0; i < 10; ++i)
+                bind(stmt, i + 1, ps[i]);
+            sqlite3_clear_bindings(stmt);
+        }, 10);
+        sqlite3_finalize(stmt);
+
+        sqlite3_stmt* in = prepare(db, "SELECT count(*) FROM tracks WHERE TrackId IN carray(?1)");
+        std::vector<sqlite_int64> ids(1000);
+        for (size_t i = 0; i < ids.size(); ++i)
+            ids[i] = static_cast<sqlite_int64>(1 + 3 * i);
+        carray ids_(ids);
+        s.run("bind.carray1000", [&](size_t) {
+            ids_.bind(in, 1);
+            sqlite3_step(in);
+            sqlite3_reset(in);
+        }, 1000);
+        sqlite3_finalize(in);
+
+        builder b;
+        b.columns = { "Name" };
+        b.from = "tracks";
+        b.where = "GenreId = ? AND Milliseconds > ? AND Composer LIKE ?";
+        b.params[builder::WHERE] = { param(sqlite_int64(1)), param(200000.), param(std::string("%Jagger%")) };
+        b.limit = "?";
+        b.params[builder::LIMIT] = { param(sqlite_int64(10)) };
+        sqlite3_stmt* bs = prepare(db, b.sql().c_str());
+        s.run("bind.builder", [&](size_t) {
+            b.bind(bs);
+            sqlite3_clear_bindings(bs);
+        }, 4);
+        sqlite3_finalize(bs);
+    }
+
+    void insert_benchmarks(bench::suite& s, int rows)
+    {
+        open db(":memory:", SQLITE_OPEN_READWRITE);
+        exec(db, "CREATE TABLE bulk(id INTEGER PRIMARY KEY, k INTEGER, x REAL, s TEXT)");
+        sqlite3_stmt* ins = prepare(db, "INSERT INTO bulk(k, x, s) VALUES(?1, ?2, ?3)");
+        std::mt19937_64 rng(7);
+        std::string text(24, 'x');
+        const int batch = 10000;
+        s.run("insert.bulk_transaction", [&](size_t) {
+            exec(db, "BEGIN");
+            for (int i = 0; i < batch; ++i) {
+                sqlite3_bind_int64(ins, 1, static_cast<sqlite_int64>(rng() % 1000));
+                sqlite3_bind_double(ins, 2, 0.5);
+                sqlite3_bind_text(ins, 3, text.data(), static_cast<int>(text.size()), SQLITE_STATIC);
+                sqlite3_step(ins);
+                sqlite3_reset(ins);
+            }
+            exec(db, "COMMIT");
+            // keep the table near the generated size
+            if (sqlite3_last_insert_rowid(db) > rows)
+                exec(db, "DELETE FROM bulk");
+        }, batch);
+        sqlite3_finalize(ins);
+
+        exec(db, "CREATE TABLE param_bulk(a, b, c)");
+        sqlite3_stmt* pins = prepare(db, "INSERT INTO param_bulk VALUES(?1, ?2, ?3)");
+        std::vector<param> row = { param(sqlite_int64(1)), param(2.5), param(std::string("text value")) };
+        s.run("insert.bulk_params", [&](size_t) {
+            exec(db, "BEGIN");
+            for (int i = 0; i < batch; ++i) {
+                for (int j = 0; j < 3; ++j)
+                    bind(pins, j + 1, row[j]);
+                sqlite3_step(pins);
+                sqlite3_reset(pins);
+            }
+            exec(db, "COMMIT");
+            if (sqlite3_last_insert_rowid(db) > rows)
+                exec(db, "DELETE FROM param_bulk");
+        }, batch);
+        sqlite3_finalize(pins);
+    }
+
+    std::string temp_file(const char* name)
+    {
+        const char* dir = getenv("TMPDIR");
+
+        return std::string(dir ? dir : "/tmp") + "/xllsqlite_bench_" + name;
+    }
+
+    // Export and import of the generated rows through a file in the page cache.
+    // Items of export are rows and items of import are bytes, so items/s is
+    // the export rate in rows per second and the import rate in bytes per second.
+    // Use --rows 100000000 --filter export to time a 100 million row export.
+    void csv_benchmarks(bench::suite& s, open& db, int rows)
+    {
+        for (char delimiter : { ',', '\t' }) {
+            std::string name = delimiter == ',' ? "csv" : "tsv";
+            if (!s.selected(name + ".export") && !s.selected(name + ".import"))
+                continue;
+
+            csv_options opt;
+            opt.delimiter = delimiter;
+            std::string file = temp_file(("gen." + name).c_str());
+            s.run(name + ".export", [&](size_t) {
+                export_csv(db, "SELECT * FROM gen", file.c_str(), opt);
+            }, rows);
+            if (s.selected(name + ".import")) {
+                csv_stats out = export_csv(db, "SELECT * FROM gen", file.c_str(), opt);
+                s.run(name + ".import", [&](size_t) {
+                    open to(":memory:", SQLITE_OPEN_READWRITE);
+                    import_csv(to, "gen", file.c_str(), opt);
+                }, static_cast<double>(out.bytes));
+            }
+            remove(file.c_str());
+        }
+    }
+
+    // The SQL.* functions copy the builder at each step.
+    void builder_benchmarks(bench::suite& s, open& db)
+    {
+        auto chain = [] {
+            builder select;
+            select.columns = { "t.Name", "a.Title", "sum(l.Quantity) AS sold" };
+            builder from(select);
+            from.from = "tracks t";
+            builder join(from);
+            join.joins.push_back({ "JOIN", "albums a", "a.AlbumId = t.AlbumId", {} });
+            join.joins.push_back({ "JOIN", "invoice_items l", "l.TrackId = t.TrackId", {} });
+            builder where(join);
+            where.where = "t.GenreId = ?";
+            where.params[builder::WHERE] = { param(sqlite_int64(1)) };
+            builder group(where);
+            group.group_by = { "t.TrackId" };
+            builder order(group);
+            order.order_by = { "sold DESC" };
+            builder limit(order);
+            limit.limit = "?";
+            limit.params[builder::LIMIT] = { param(sqlite_int64(10)) };
+
+            return limit;
+        };
+
+        s.run("builder.chain", [&](size_t) {
+            auto b = chain();
+        });
+        builder b = chain();
+        s.run("builder.render", [&](size_t) {
+            auto sql = b.render();
+        });
+        s.run("builder.exec", [&](size_t) {
+            cached stmt(db, b.sql());
+            b.bind(stmt);
+            auto o = bench::exec(stmt, true);
+        });
+
+        std::string literal = "select Name, Milliseconds from tracks where GenreId = 7 "
+            "and Composer like '%Jobim%' and Milliseconds > 200000 order by Name limit 20";
+        fingerprint fp;
+        s.run("fingerprint.normalize", [&](size_t) {
+            fp.normalize(literal);
+        }, static_cast<double>(literal.size()));
+    }
+
+    // Values of the rows of sql kept in a vector as a result set or cache would.
+    void value_benchmarks(bench::suite& s, open& db)
+    {
+        const char* sql = "SELECT id, k, x, s FROM gen LIMIT 1000";
+        sqlite3_stmt* stmt = prepare(db, sql);
+        double cells = 4 * count(db, sql);
+        std::vector<legacy_value> legacy;
+        std::vector<value> values;
+        legacy.reserve(static_cast<size_t>(cells));
+        values.reserve(static_cast<size_t>(cells));
+        arena a;
+
+        s.run("value.legacy_default", [&](size_t) {
+            legacy_value v;
+            bench::keep(v);
+        });
+        s.run("value.default", [&](size_t) {
+            value v;
+            bench::keep(v);
+        });
+
+        s.run("value.legacy_column", [&](size_t) {
+            legacy.clear();
+            while (SQLITE_ROW == sqlite3_step(stmt)) {
+                for (int i = 0; i < 4; ++i)
+                    legacy.emplace_back(sqlite3_column_value(stmt, i));
+            }
+            sqlite3_reset(stmt);
+        }, cells);
+        s.run("value.column", [&](size_t) {
+            values.clear();
+            a.clear();
+            while (SQLITE_ROW == sqlite3_step(stmt)) {
+                for (int i = 0; i < 4; ++i)
+                    values.push_back(value::column(stmt, i, a));
+            }
+            sqlite3_reset(stmt);
+        }, cells);
+        sqlite3_finalize(stmt);
+
+        std::vector<legacy_value> legacy_copy;
+        std::vector<value> values_copy;
+        legacy_copy.reserve(legacy.size());
+        values_copy.reserve(values.size());
+        s.run("value.legacy_copy", [&](size_t) {
+            legacy_copy.assign(legacy.begin(), legacy.end());
+        }, cells);
+        s.run("value.copy", [&](size_t) {
+            values_copy.assign(values.begin(), values.end());
+        }, cells);
+
+        sqlite3_stmt* params = prepare(db, "SELECT ?1, ?2, ?3, ?4");
+        s.run("value.bind", [&](size_t i) {
+            for (int j = 0; j < 4; ++j)
+                bind(params, j + 1, values[(4 * i + j) % values.size()]);
+            sqlite3_step(params);
+            sqlite3_reset(params);
+        }, 4);
+        sqlite3_finalize(params);
+    }
+
+}
+
+int main(int argc, char** argv)
+{
+    bench::suite s;
+    std::string file = "chinook.db";
+    std::string json, baseline;
+    double threshold = 5;
+    int rows = 200000;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg(argv[i]);
+        const char* val = i + 1 < argc ? argv[i + 1] : "";
+        if (arg == "--db")
+            file = val, ++i;
+        else if (arg == "--rows")
+            rows = std::atoi(val), ++i;
+        else if (arg == "--filter")
+            s.filter = val, ++i;
+        else if (arg == "--time")
+            s.min_time = std::atof(val), ++i;
+        else if (arg == "--json")
+            json = val, ++i;
+        else if (arg == "--baseline")
+            baseline = val, ++i;
+        else if (arg == "--threshold")
+            threshold = std::atof(val), ++i;
+        else if (arg == "--compare" && i + 2 < argc) {
+            auto base = bench::load(argv[i + 1]);
+            auto test = bench::load(argv[i + 2]);
+            if (base.empty() || test.empty()) {
+                fprintf(stderr, "no results in %s\n", base.empty() ? argv[i + 1] : argv[i + 2]);
+
+                return 1;
+            }
+
+            return bench::compare(base, test, threshold, stdout) ? 3 : 0;
+        }
+        else {
+            fprintf(stderr, "usage: %s [--db file] [--rows n] [--filter text] [--time seconds] [--json file] "
+                "[--baseline file] [--threshold pct] [--compare base test]\n", argv[0]);
+
+            return 2;
+        }
+    }
+
+    try {
+        count_allocations();
+        s.allocations = [] { return allocations; };
+
+        // copy chinook into memory so the generated table can be added
+        open db(":memory:", SQLITE_OPEN_READWRITE);
+        {
+            open chinook(file.c_str());
+            sqlite3_backup* backup = sqlite3_backup_init(db, "main", chinook, "main");
+            if (!backup || SQLITE_DONE != sqlite3_backup_step(backup, -1))
+                throw std::runtime_error(sqlite3_errmsg(db));
+            sqlite3_backup_finish(backup);
+        }
+        if (SQLITE_OK != carray_init(db))
+            throw std::runtime_error("carray_init failed");
+        generate(db, rows);
+
+        s.context = {
+            { "sqlite_version", sqlite3_libversion() },
+            { "sqlite_source_id", sqlite3_sourceid() },
+            { "database", file },
+            { "rows", std::to_string(rows) },
+        };
+
+        prepare_benchmarks(s, db);
+        step_benchmarks(s, db);
+        exec_benchmarks(s, db);
+        bind_benchmarks(s, db);
+        insert_benchmarks(s, rows);
+        builder_benchmarks(s, db);
+        value_benchmarks(s, db);
+        csv_benchmarks(s, db, rows);
+    }
+    catch (const std::exception& ex) {
+        fprintf(stderr, "%s\n", ex.what());
+
+        return 1;
+    }
+
+    FILE* fp = json.empty() ? stdout : fopen(json.c_str(), "w");
+    if (!fp) {
+        fprintf(stderr, "cannot write %s\n", json.c_str());
+
+        return 1;
+    }
+    s.json(fp);
+    if (fp != stdout)
+        fclose(fp);
+
+    if (!baseline.empty()) {
+        auto base = bench::load(baseline.c_str());
+        if (base.empty()) {
+            fprintf(stderr, "no results in %s\n", baseline.c_str());
+
+            return 1;
+        }
+
+        return bench::compare(base, s.results(), threshold, stderr) ? 3 : 0;
+    }
+
+    return 0;
+}
@@ -0,0 +1,250 @@
+// bench.h - timing, percentiles, and JSON output for benchmarks
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+    // Latencies are nanoseconds per operation.
+    struct result {
+        std::string name;
+        size_t samples = 0;
+        size_t batch = 0;       // operations per sample
+        double items = 1;       // rows or bytes per operation
+        double mean = 0, min = 0, p50 = 0, p90 = 0, p99 = 0, max = 0;
+        double allocations = -1; // heap allocations per operation if counted
+
+        double ops_per_second() const
+        {
+            return mean > 0 ? 1e9 / mean : 0;
+        }
+        double items_per_second() const
+        {
+            return items * ops_per_second();
+        }
+    };
+
+    // Keep the compiler from optimizing away the construction of t.
+    template<class T>
+    inline void keep(const T& t)
+    {
+#if defined(__GNUC__)
+        asm volatile("" : : "m"(t) : "memory");
+#else
+        static const void* volatile sink;
+        sink = &t;
+#endif
+    }
+
+    // Nearest rank percentile of sorted x.
+    inline double percentile(const std::vector<double>& x, double p)
+    {
+        if (x.empty())
+            return 0;
+        size_t i = static_cast<size_t>(p / 100 * x.size());
+
+        return x[std::min(i, x.size() - 1)];
+    }
+
+    inline void json_string(FILE* fp, const std::string& s)
+    {
+        fputc('"', fp);
+        for (char c : s) {
+            if (c == '"' || c == '\\')
+                fputc('\\', fp);
+            if (static_cast<unsigned char>(c) < 0x20)
+                fprintf(fp, "\\u%04x", c);
+            else
+                fputc(c, fp);
+        }
+        fputc('"', fp);
+    }
+
+    // Number following "key": in a line written by suite::json.
+    inline double json_number(const char* line, const char* key)
+    {
+        std::string k = std::string("\"") + key + "\": ";
+        const char* p = strstr(line, k.c_str());
+
+        return p ? strtod(p + k.size(), nullptr) : 0;
+    }
+
+    // Results from a file written by suite::json. Each benchmark is on its own line.
+    inline std::vector<result> load(const char* file)
+    {
+        std::vector<result> rs;
+        FILE* fp = fopen(file, "r");
+        if (!fp)
+            return rs;
+
+        char line[4096];
+        while (fgets(line, sizeof(line), fp)) {
+            const char* p = strstr(line, "{\"name\": \"");
+            if (!p)
+                continue;
+            result r;
+            for (p += 10; *p && *p != '"'; ++p) {
+                if (*p == '\\' && p[1])
+                    ++p;
+                r.name.push_back(*p);
+            }
+            r.samples = static_cast<size_t>(json_number(p, "samples"));
+            r.batch = static_cast<size_t>(json_number(p, "batch"));
+            r.items = json_number(p, "items");
+            r.mean = json_number(p, "mean");
+            r.min = json_number(p, "min");
+            r.p50 = json_number(p, "p50");
+            r.p90 = json_number(p, "p90");
+            r.p99 = json_number(p, "p99");
+            r.max = json_number(p, "max");
+            if (strstr(p, "\"allocations\": "))
+                r.allocations = json_number(p, "allocations");
+            rs.push_back(r);
+        }
+        fclose(fp);
+
+        return rs;
+    }
+
+    // Print the change in median latency of each benchmark in both base and test.
+    // Changes larger than threshold percent and beyond the p90 of the faster
+    // run are marked as a regression or improvement. Returns the number of regressions.
+    inline int compare(const std::vector<result>& base, const std::vector<result>& test, double threshold, FILE* fp)
+    {
+        int regressions = 0, improvements = 0;
+
+        fprintf(fp, "%-32s %14s %14s %9s\n", "benchmark", "base p50 ns", "test p50 ns", "change");
+        for (const result& t : test) {
+            auto b = std::find_if(base.begin(), base.end(), [&t](const result& r) { return r.name == t.name; });
+            if (b == base.end() || b->p50 <= 0)
+                continue;
+            double change = 100 * (t.p50 - b->p50) / b->p50;
+            const char* mark = "";
+            // a change must also be outside the spread of the other run
+            if (change > threshold && t.p50 > b->p90)
+                mark = "regression", ++regressions;
+            else if (change < -threshold && b->p50 > t.p90)
+                mark = "improvement", ++improvements;
+            fprintf(fp, "%-32s %14.0f %14.0f %+8.1f%% %s\n", t.name.c_str(), b->p50, t.p50, change, mark);
+        }
+        fprintf(fp, "%d regressions and %d improvements over %.0f%%\n", regressions, improvements, threshold);
+
+        return regressions;
+    }
+
+    // Each benchmark runs batches of operations long enough for the clock
+    // and records the time per operation of each batch until min_time has
+    // passed and min_samples batches ran, or max_samples batches ran.
+    class suite {
+        std::vector<result> results_;
+    public:
+        std::string filter;     // run benchmarks whose name contains filter
+        double min_time = 0.5;  // seconds per benchmark
+        size_t min_samples = 5;
+        size_t max_samples = 1000;
+        std::vector<std::pair<std::string, std::string>> context; // reported with the results
+        size_t(*allocations)() = nullptr; // running count of heap allocations
+
+        const std::vector<result>& results() const
+        {
+            return results_;
+        }
+        bool selected(const std::string& name) const
+        {
+            return filter.empty() || name.find(filter) != std::string::npos;
+        }
+
+        // Time f(i) for i = 0, 1, ... where each call processes items rows or bytes.
+        template<class F>
+        const result* run(const std::string& name, F&& f, double items = 1)
+        {
+            using clock = std::chrono::steady_clock;
+            if (!selected(name))
+                return nullptr;
+
+            size_t i = 0;
+            // warm up and size batches to take at least 50us
+            size_t batch = 1;
+            for (;;) {
+                auto t0 = clock::now();
+                for (size_t k = 0; k < batch; ++k)
+                    f(i++);
+                auto ns = std::chrono::duration<double, std::nano>(clock::now() - t0).count();
+                if (ns >= 50000 || batch >= (1u << 20))
+                    break;
+                batch *= 2;
+            }
+
+            std::vector<double> ns;
+            ns.reserve(max_samples);
+            size_t allocs = allocations ? allocations() : 0;
+            auto start = clock::now();
+            while (ns.size() < max_samples
+                && (ns.size() < min_samples || std::chrono::duration<double>(clock::now() - start).count() < min_time)) {
+                auto t0 = clock::now();
+                for (size_t k = 0; k < batch; ++k)
+                    f(i++);
+                ns.push_back(std::chrono::duration<double, std::nano>(clock::now() - t0).count() / batch);
+            }
+
+            result r;
+            r.name = name;
+            r.samples = ns.size();
+            r.batch = batch;
+            r.items = items;
+            if (allocations)
+                r.allocations = static_cast<double>(allocations() - allocs) / (ns.size() * batch);
+            double sum = 0;
+            for (double x : ns)
+                sum += x;
+            r.mean = sum / ns.size();
+            std::sort(ns.begin(), ns.end());
+            r.min = ns.front();
+            r.p50 = percentile(ns, 50);
+            r.p90 = percentile(ns, 90);
+            r.p99 = percentile(ns, 99);
+            r.max = ns.back();
+            results_.push_back(r);
+
+            fprintf(stderr, "%-32s %12.0f ns/op p50 %12.0f p99 %12.0f %14.0f items/s",
+                name.c_str(), r.mean, r.p50, r.p99, r.items_per_second());
+            if (r.allocations >= 0)
+                fprintf(stderr, " %10.2f allocs/op", r.allocations);
+            fprintf(stderr, "\n");
+
+            return &results_.back();
+        }
+
+        void json(FILE* fp) const
+        {
+            fprintf(fp, "{\n  \"context\": {");
+            for (size_t i = 0; i < context.size(); ++i) {
+                fprintf(fp, "%s\n    ", i ? "," : "");
+                json_string(fp, context[i].first);
+                fprintf(fp, ": ");
+                json_string(fp, context[i].second);
+            }
+            fprintf(fp, "\n  },\n  \"benchmarks\": [");
+            for (size_t i = 0; i < results_.size(); ++i) {
+                const result& r = results_[i];
+                fprintf(fp, "%s\n    {\"name\": ", i ? "," : "");
+                json_string(fp, r.name);
+                fprintf(fp, ", \"unit\": \"ns\", \"samples\": %zu, \"batch\": %zu, \"items\": %g, "
+                    "\"mean\": %.1f, \"min\": %.1f, \"p50\": %.1f, \"p90\": %.1f, \"p99\": %.1f, \"max\": %.1f, "
+                    "\"ops_per_second\": %.1f, \"items_per_second\": %.1f",
+                    r.samples, r.batch, r.items, r.mean, r.min, r.p50, r.p90, r.p99, r.max,
+                    r.ops_per_second(), r.items_per_second());
+                if (r.allocations >= 0)
+                    fprintf(fp, ", \"allocations\": %.2f", r.allocations);
+                fprintf(fp, "}");
+            }
+            fprintf(fp, "\n  ]\n}\n");
+        }
+    };
+
+}
@@ -0,0 +1,48 @@
+#!/bin/sh
+# diff.sh - run the benchmarks against each vendored SQLite amalgamation and compare them
+# Usage from the repository root:
+#   bench/diff.sh [base test] [-- benchmark options]
+# base and test default to the oldest and newest sqlite-amalgamation-* directories.
+# Each directory needs sqlite3.c from https://www.sqlite.org/download.html next to sqlite3.h.
+# Results are written to $TMPDIR/xllsqlite-bench/bench-<version>.json and the exit
+# status is 3 if the test version has regressions over the threshold.
+set -e
+
+base=
+test=
+if [ $# -ge 2 ] && [ "$1" != "--" ]; then
+    base=$1
+    test=$2
+    shift 2
+fi
+[ "$1" = "--" ] && shift
+if [ -z "$base" ]; then
+    base=$(ls -d sqlite-amalgamation-* | sort | head -n 1 | sed 's/sqlite-amalgamation-//')
+    test=$(ls -d sqlite-amalgamation-* | sort | tail -n 1 | sed 's/sqlite-amalgamation-//')
+fi
+
+CXX=${CXX:-g++}
+CC=${CC:-gcc}
+# match the PreprocessorDefinitions of xllsqlite.vcxproj
+DEFINES="-DNDEBUG -DSQLITE_ENABLE_DBSTAT_VTAB"
+out=${TMPDIR:-/tmp}/xllsqlite-bench
+mkdir -p "$out"
+
+for v in "$base" "$test"; do
+    dir=sqlite-amalgamation-$v
+    if [ ! -f "$dir/sqlite3.c" ]; then
+        echo "$dir/sqlite3.c not found" >&2
+        exit 1
+    fi
+    # sqlite3.c is compiled as C and the core finds sqlite3.h through -I
+    $CC -O2 $DEFINES -I"$dir" -c "$dir/sqlite3.c" -o "$out/sqlite3-$v.o"
+    $CXX -std=c++20 -O2 $DEFINES -I"$dir" -o "$out/bench-$v" \
+        bench/bench.cpp builder.cpp fingerprint.cpp carray.cpp csv.cpp "$out/sqlite3-$v.o" -lpthread -ldl -lm
+done
+
+"$out/bench-$base" --json "$out/bench-$base.json" "$@"
+"$out/bench-$test" --json "$out/bench-$test.json" "$@"
+
+echo "sqlite $base -> $test"
+# --compare returns as soon as it is parsed so the threshold goes first
+"$out/bench-$test" $(echo "$@" | grep -o -- '--threshold [0-9.]*') --compare "$out/bench-$base.json" "$out/bench-$test.json"
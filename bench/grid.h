@@ -0,0 +1,105 @@
+// grid.h - result grid standing in for xll::OPER so sqlite_exec can be timed without Excel
+// exec and exec12 run the row loops of range.h that the add-in uses.
+#pragma once
+#include <string>
+#include <vector>
+#include "../range.h"
+
+namespace bench {
+
+    // A cell owns its string like an OPER does.
+    template<class S>
+    struct cell {
+        enum { nil, num, str, err } type = nil;
+        double val = 0;
+        S text;
+
+        cell() = default;
+        cell(double x)
+            : type(num), val(x)
+        { }
+        cell(const typename S::value_type* s, size_t n)
+            : type(str), text(s, n)
+        { }
+        cell(const typename S::value_type* s)
+            : type(str), text(s)
+        { }
+        static cell error(int e)
+        {
+            cell c;
+            c.type = err;
+            c.val = e;
+
+            return c;
+        }
+    };
+
+    // Row-major multi like OPER. push_back grows to the exact new size and
+    // copies the old cells as XOPER::push_back does.
+    template<class S>
+    class grid {
+        unsigned r = 0, c = 0;
+        std::vector<cell<S>> cells;
+    public:
+        grid() = default;
+        grid(unsigned rows, unsigned columns)
+            : r(rows), c(columns), cells(rows * columns)
+        { }
+
+        unsigned rows() const
+        {
+            return r;
+        }
+        unsigned columns() const
+        {
+            return c;
+        }
+        void resize(unsigned rows, unsigned columns)
+        {
+            std::vector<cell<S>> cells_(rows * columns);
+            for (unsigned i = 0; i < rows * columns && i < r * c; ++i)
+                cells_[i] = std::move(cells[i]);
+            cells.swap(cells_);
+            r = rows;
+            c = columns;
+        }
+        cell<S>& operator[](unsigned i)
+        {
+            return cells[i];
+        }
+        cell<S>& operator()(unsigned i, unsigned j)
+        {
+            return cells[i * c + j];
+        }
+        void push_back(const grid& row)
+        {
+            std::vector<cell<S>> cells_;
+            cells_.reserve(cells.size() + row.cells.size());
+            cells_.insert(cells_.end(), cells.begin(), cells.end());
+            cells_.insert(cells_.end(), row.cells.begin(), row.cells.end());
+            cells.swap(cells_);
+            c = row.c;
+            r += row.r;
+        }
+    };
+
+    using grid4 = grid<std::string>;
+    using grid12 = grid<std::u16string>;
+
+    // sqlite_exec from xllsqlite.h with grid4 in place of OPER4.
+    inline grid4 exec(sqlite3_stmt* stmt, bool header = false)
+    {
+        using cell4 = cell<std::string>;
+
+        return sqlite::rows<grid4, cell4>(stmt, header, cell4::error(SQLITE_NULL), cell4::error(SQLITE_BLOB));
+    }
+
+    // sqlite_exec12 from xllsqlite.h with grid12 in place of OPER.
+    inline grid12 exec12(sqlite3_stmt* stmt, bool header = false)
+    {
+        using cell12 = cell<std::u16string>;
+
+        return sqlite::rows12<grid12, char16_t, cell12>(stmt, header, cell12::error(SQLITE_NULL), cell12::error(SQLITE_BLOB));
+    }
+
+}
@@ -0,0 +1,128 @@
+// builder.cpp - SQL SELECT statements built from clauses
+#include <stdexcept>
+#include "builder.h"
+
+using namespace sqlite;
+
+namespace {
+
+    void append_list(std::string& sql, const std::vector<std::string>& list)
+    {
+        for (size_t i = 0; i < list.size(); ++i) {
+            if (i > 0)
+                sql.append(", ");
+            sql.append(list[i]);
+        }
+    }
+
+}
+
+// select-core followed by compound selects
+// https://www.sqlite.org/syntax/select-core.html
+void builder::render_core(std::string& sql) const
+{
+    sql.append(distinct ? "SELECT DISTINCT " : "SELECT ");
+    if (columns.empty())
+        sql.append("*");
+    append_list(sql, columns);
+    if (!from.empty()) {
+        sql.append(" FROM ");
+        sql.append(from);
+    }
+    for (const auto& j : joins) {
+        sql.append(" ");
+        sql.append(j.op);
+        sql.append(" ");
+        sql.append(j.table);
+        if (!j.on.empty()) {
+            sql.append(" ON ");
+            sql.append(j.on);
+        }
+        if (!j.using_.empty()) {
+            sql.append(" USING (");
+            append_list(sql, j.using_);
+            sql.append(")");
+        }
+    }
+    if (!where.empty()) {
+        sql.append(" WHERE ");
+        sql.append(where);
+    }
+    if (!group_by.empty()) {
+        sql.append(" GROUP BY ");
+        append_list(sql, group_by);
+    }
+    if (!having.empty()) {
+        sql.append(" HAVING ");
+        sql.append(having);
+    }
+    for (const auto& c : compounds) {
+        sql.append(" ");
+        sql.append(c.op);
+        sql.append(" ");
+        c.select->render_core(sql);
+    }
+}
+
+// https://www.sqlite.org/lang_select.html
+std::string builder::render() const
+{
+    std::string sql;
+
+    if (!with.empty()) {
+        sql.append(recursive ? "WITH RECURSIVE " : "WITH ");
+        for (size_t i = 0; i < with.size(); ++i) {
+            if (i > 0)
+                sql.append(", ");
+            sql.append(with[i].name);
+            sql.append(" AS (");
+            sql.append(with[i].select->sql());
+            sql.append(")");
+        }
+        sql.append(" ");
+    }
+    render_core(sql);
+    if (!order_by.empty()) {
+        sql.append(" ORDER BY ");
+        append_list(sql, order_by);
+    }
+    if (!limit.empty()) {
+        sql.append(" LIMIT ");
+        sql.append(limit);
+        if (!offset.empty()) {
+            sql.append(" OFFSET ");
+            sql.append(offset);
+        }
+    }
+
+    return sql;
+}
+
+void builder::parameters(std::vector<const param*>& ps) const
+{
+    auto append = [&ps](const std::vector<param>& p) {
+        for (const auto& pi : p)
+            ps.push_back(&pi);
+    };
+
+    for (const auto& c : with)
+        c.select->parameters(ps);
+    for (int i = COLUMNS; i <= HAVING; ++i)
+        append(params[i]);
+    for (const auto& c : compounds)
+        c.select->parameters(ps);
+    append(params[ORDER_BY]);
+    append(params[LIMIT]);
+}
+
+int builder::bind(sqlite3_stmt* pstmt) const
+{
+    std::vector<const param*> ps;
+    parameters(ps);
+    for (int i = 0; i < static_cast<int>(ps.size()); ++i) {
+        if (SQLITE_OK != sqlite::bind(pstmt, i + 1, *ps[i]))
+            throw std::runtime_error(sqlite3_errmsg(sqlite3_db_handle(pstmt)));
+    }
+
+    return static_cast<int>(ps.size());
+}
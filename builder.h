@@ -0,0 +1,84 @@
+// builder.h - SQL SELECT statements built from clauses
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include "sqlite.h"
+
+namespace sqlite {
+
+    // Structured SELECT statement. Clauses are set by the SQL.* builder
+    // functions and the canonical SQL is rendered once on first use.
+    // Values for ? placeholders are kept with the clause containing them
+    // and bound in the order they occur in the rendered SQL.
+    class builder {
+        // rendered SQL that is not copied with the clauses
+        struct rendered {
+            std::string sql;
+            rendered() = default;
+            rendered(const rendered&)
+            { }
+            rendered& operator=(const rendered&)
+            {
+                sql.clear();
+
+                return *this;
+            }
+        };
+        mutable rendered sql_;
+        void render_core(std::string& sql) const;
+    public:
+        // https://www.sqlite.org/syntax/join-clause.html
+        struct join {
+            std::string op; // JOIN, LEFT JOIN, ...
+            std::string table;
+            std::string on;
+            std::vector<std::string> using_;
+        };
+        // https://www.sqlite.org/syntax/common-table-expression.html
+        struct cte {
+            std::string name;
+            std::shared_ptr<const builder> select;
+        };
+        // https://www.sqlite.org/syntax/compound-operator.html
+        struct compound {
+            std::string op; // UNION, UNION ALL, INTERSECT, EXCEPT
+            std::shared_ptr<const builder> select;
+        };
+        enum clause {
+            COLUMNS, FROM, WHERE, GROUP_BY, HAVING, ORDER_BY, LIMIT,
+            CLAUSES
+        };
+
+        bool recursive = false;
+        std::vector<cte> with;
+        bool distinct = false;
+        std::vector<std::string> columns;
+        std::string from;
+        std::vector<join> joins;
+        std::string where;
+        std::vector<std::string> group_by;
+        std::string having;
+        std::vector<compound> compounds;
+        std::vector<std::string> order_by;
+        std::string limit;
+        std::string offset;
+        std::vector<param> params[CLAUSES];
+
+        const std::string& sql() const
+        {
+            if (sql_.sql.empty())
+                sql_.sql = render();
+
+            return sql_.sql;
+        }
+        std::string render() const;
+
+        // Placeholder values in the order they occur in sql().
+        void parameters(std::vector<const param*>& ps) const;
+        // Bind placeholder values starting at ?1 and return the number bound.
+        // Text is not copied so the builder must outlive the statement execution.
+        int bind(sqlite3_stmt* pstmt) const;
+    };
+
+}
@@ -0,0 +1,185 @@
+// carray.cpp - table-valued function over arrays bound as pointers
+#include <new>
+#include "carray.h"
+
+using namespace sqlite;
+
+void carray::result(sqlite3_context* ctx, size_t i) const
+{
+    switch (data.index()) {
+    case 0:
+        sqlite3_result_int64(ctx, std::get<0>(data)[i]);
+        break;
+    case 1:
+        sqlite3_result_double(ctx, std::get<1>(data)[i]);
+        break;
+    case 2: {
+        const std::string& t = std::get<2>(data)[i];
+        sqlite3_result_text(ctx, t.data(), static_cast<int>(t.size()), SQLITE_STATIC);
+        break;
+    }
+    }
+}
+
+namespace {
+
+    enum column {
+        CARRAY_VALUE,
+        CARRAY_POINTER, // hidden
+    };
+
+    struct cursor : public sqlite3_vtab_cursor {
+        const carray* array = nullptr;
+        sqlite3_value* scalar = nullptr; // argument that is not a carray pointer
+        size_t i = 0, n = 0;
+    };
+
+    int connect(sqlite3* db, void*, int, const char* const*, sqlite3_vtab** ppvtab, char**)
+    {
+        int rc = sqlite3_declare_vtab(db, "CREATE TABLE x(value, pointer HIDDEN)");
+        if (rc == SQLITE_OK) {
+            *ppvtab = static_cast<sqlite3_vtab*>(sqlite3_malloc(sizeof(sqlite3_vtab)));
+            if (!*ppvtab)
+                return SQLITE_NOMEM;
+            **ppvtab = sqlite3_vtab{};
+        }
+
+        return rc;
+    }
+
+    int disconnect(sqlite3_vtab* pvtab)
+    {
+        sqlite3_free(pvtab);
+
+        return SQLITE_OK;
+    }
+
+    // Require pointer = ? to produce rows.
+    int best_index(sqlite3_vtab*, sqlite3_index_info* info)
+    {
+        info->idxNum = 0;
+        info->estimatedCost = 1e12;
+        for (int i = 0; i < info->nConstraint; ++i) {
+            const auto& c = info->aConstraint[i];
+            if (c.iColumn == CARRAY_POINTER && c.op == SQLITE_INDEX_CONSTRAINT_EQ && c.usable) {
+                info->aConstraintUsage[i].argvIndex = 1;
+                info->aConstraintUsage[i].omit = 1;
+                info->idxNum = 1;
+                info->estimatedCost = 1;
+                info->estimatedRows = 100;
+                break;
+            }
+        }
+
+        return SQLITE_OK;
+    }
+
+    int open(sqlite3_vtab*, sqlite3_vtab_cursor** ppcur)
+    {
+        *ppcur = new(std::nothrow) cursor;
+
+        return *ppcur ? SQLITE_OK : SQLITE_NOMEM;
+    }
+
+    int close(sqlite3_vtab_cursor* pcur)
+    {
+        cursor* cur = static_cast<cursor*>(pcur);
+        sqlite3_value_free(cur->scalar);
+        delete cur;
+
+        return SQLITE_OK;
+    }
+
+    int filter(sqlite3_vtab_cursor* pcur, int idxNum, const char*, int, sqlite3_value** argv)
+    {
+        cursor* cur = static_cast<cursor*>(pcur);
+        sqlite3_value_free(cur->scalar);
+        cur->scalar = nullptr;
+        cur->array = nullptr;
+        cur->i = 0;
+        cur->n = 0;
+
+        if (idxNum == 1) {
+            cur->array = static_cast<const carray*>(sqlite3_value_pointer(argv[0], carray::type));
+            if (cur->array) {
+                cur->n = cur->array->size();
+            }
+            else if (sqlite3_value_type(argv[0]) != SQLITE_NULL) {
+                cur->scalar = sqlite3_value_dup(argv[0]);
+                if (!cur->scalar)
+                    return SQLITE_NOMEM;
+                cur->n = 1;
+            }
+        }
+
+        return SQLITE_OK;
+    }
+
+    int next(sqlite3_vtab_cursor* pcur)
+    {
+        ++static_cast<cursor*>(pcur)->i;
+
+        return SQLITE_OK;
+    }
+
+    int eof(sqlite3_vtab_cursor* pcur)
+    {
+        const cursor* cur = static_cast<cursor*>(pcur);
+
+        return cur->i >= cur->n;
+    }
+
+    int column(sqlite3_vtab_cursor* pcur, sqlite3_context* ctx, int col)
+    {
+        const cursor* cur = static_cast<cursor*>(pcur);
+        if (col == CARRAY_VALUE) {
+            if (cur->array)
+                cur->array->result(ctx, cur->i);
+            else
+                sqlite3_result_value(ctx, cur->scalar);
+        }
+
+        return SQLITE_OK;
+    }
+
+    int rowid(sqlite3_vtab_cursor* pcur, sqlite_int64* prowid)
+    {
+        *prowid = static_cast<sqlite_int64>(static_cast<cursor*>(pcur)->i) + 1;
+
+        return SQLITE_OK;
+    }
+
+    // eponymous-only since xCreate is null
+    const sqlite3_module module = {
+        0,          // iVersion
+        nullptr,    // xCreate
+        connect,
+        best_index,
+        disconnect,
+        nullptr,    // xDestroy
+        open,
+        close,
+        filter,
+        next,
+        eof,
+        column,
+        rowid,
+        nullptr,    // xUpdate
+        nullptr,    // xBegin
+        nullptr,    // xSync
+        nullptr,    // xCommit
+        nullptr,    // xRollback
+        nullptr,    // xFindFunction
+        nullptr,    // xRename
+        nullptr,    // xSavepoint
+        nullptr,    // xRelease
+        nullptr,    // xRollbackTo
+        nullptr,    // xShadowName
+    };
+
+}
+
+int sqlite::carray_init(sqlite3* db)
+{
+    return sqlite3_create_module(db, "carray", &module, nullptr);
+}
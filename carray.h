@@ -0,0 +1,47 @@
+// carray.h - table-valued function over arrays bound as pointers
+#pragma once
+#include <string>
+#include <variant>
+#include <vector>
+#include "sqlite3.h"
+
+namespace sqlite {
+
+    // Bind an array as a parameter and use it as a table in SQL.
+    // SELECT * FROM t WHERE id IN carray(?1)
+    // A parameter that is not a carray pointer is treated as a one element array.
+    class carray {
+        std::variant<std::vector<sqlite_int64>, std::vector<double>, std::vector<std::string>> data;
+    public:
+        // pointer type passed to sqlite3_bind_pointer
+        static constexpr const char* type = "carray";
+
+        carray(std::vector<sqlite_int64> i = {})
+            : data(std::move(i))
+        { }
+        carray(std::vector<double> d)
+            : data(std::move(d))
+        { }
+        carray(std::vector<std::string> t)
+            : data(std::move(t))
+        { }
+
+        size_t size() const
+        {
+            return std::visit([](const auto& v) { return v.size(); }, data);
+        }
+
+        // Bind to parameter col of stmt. The array must outlive the statement execution.
+        int bind(sqlite3_stmt* stmt, int col) const
+        {
+            return sqlite3_bind_pointer(stmt, col, const_cast<carray*>(this), type, nullptr);
+        }
+
+        // Set the result to the i-th element.
+        void result(sqlite3_context* ctx, size_t i) const;
+    };
+
+    // Register the eponymous carray virtual table with db.
+    int carray_init(sqlite3* db);
+
+}
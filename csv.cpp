@@ -0,0 +1,621 @@
+// csv.cpp - bulk import and export of delimited files
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <thread>
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "csv.h"
+
+using namespace sqlite;
+
+namespace {
+
+    // Read only memory map of an entire file.
+    class mmap_file {
+        const char* data_ = nullptr;
+        size_t size_ = 0;
+#ifdef _WIN32
+        HANDLE file = INVALID_HANDLE_VALUE;
+        HANDLE map = nullptr;
+#else
+        int fd = -1;
+#endif
+        void close()
+        {
+#ifdef _WIN32
+            if (data_)
+                UnmapViewOfFile(data_);
+            if (map)
+                CloseHandle(map);
+            if (file != INVALID_HANDLE_VALUE)
+                CloseHandle(file);
+#else
+            if (data_)
+                munmap(const_cast<char*>(data_), size_);
+            if (fd >= 0)
+                ::close(fd);
+#endif
+        }
+    public:
+        mmap_file(const char* name)
+        {
+#ifdef _WIN32
+            file = CreateFileA(name, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+            if (file == INVALID_HANDLE_VALUE)
+                throw std::runtime_error(std::string("cannot open file: ") + name);
+            LARGE_INTEGER n;
+            GetFileSizeEx(file, &n);
+            size_ = static_cast<size_t>(n.QuadPart);
+            if (size_) {
+                map = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+                if (map)
+                    data_ = static_cast<const char*>(MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0));
+            }
+#else
+            fd = ::open(name, O_RDONLY);
+            if (fd < 0)
+                throw std::runtime_error(std::string("cannot open file: ") + name);
+            struct stat st;
+            if (fstat(fd, &st) != 0) {
+                close();
+                throw std::runtime_error(std::string("cannot stat file: ") + name);
+            }
+            size_ = static_cast<size_t>(st.st_size);
+            if (size_) {
+                void* p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (p != MAP_FAILED) {
+                    madvise(p, size_, MADV_SEQUENTIAL);
+                    data_ = static_cast<const char*>(p);
+                }
+            }
+#endif
+            if (size_ && !data_) {
+                close();
+                throw std::runtime_error(std::string("cannot map file: ") + name);
+            }
+        }
+        mmap_file(const mmap_file&) = delete;
+        mmap_file& operator=(const mmap_file&) = delete;
+        ~mmap_file()
+        {
+            close();
+        }
+
+        const char* data() const
+        {
+            return data_;
+        }
+        size_t size() const
+        {
+            return size_;
+        }
+    };
+
+    struct field {
+        int type = SQLITE_NULL;
+        sqlite_int64 i = 0;
+        double d = 0;
+        std::string_view t;
+    };
+
+    // Parsed rows of a chunk. Text refers to the file or to unescaped copies.
+    struct chunk_rows {
+        size_t count = 0;
+        std::vector<field> fields; // count * columns
+        std::deque<std::string> unescaped;
+    };
+
+    // Tab delimited files have backslash escapes and no quoted fields.
+    bool escapes(const csv_options& opt)
+    {
+        return opt.delimiter == '\t';
+    }
+
+    // Decode \t, \n, \r, and \\ as written by export_csv. Other backslashes are kept.
+    std::string_view unescape(std::string_view t, std::deque<std::string>& unescaped)
+    {
+        if (t.find('\\') == std::string_view::npos)
+            return t;
+
+        std::string& s = unescaped.emplace_back();
+        s.reserve(t.size());
+        for (size_t k = 0; k < t.size(); ++k) {
+            char c = t[k];
+            if (c == '\\' && k + 1 < t.size()) {
+                char d = t[k + 1];
+                if (d == 't' || d == 'n' || d == 'r' || d == '\\') {
+                    c = d == 't' ? '\t' : d == 'n' ? '\n' : d == 'r' ? '\r' : '\\';
+                    ++k;
+                }
+            }
+            s.push_back(c);
+        }
+
+        return s;
+    }
+
+    // Parse one record starting at p, append its fields, and return the position after it.
+    const char* parse_record(const char* p, const char* e, const csv_options& opt,
+        std::vector<field>& out, std::deque<std::string>& unescaped)
+    {
+        while (true) {
+            field f;
+            if (!escapes(opt) && p < e && *p == opt.quote) {
+                const char* b = ++p;
+                bool escaped = false;
+                while (true) {
+                    p = static_cast<const char*>(memchr(p, opt.quote, e - p));
+                    if (!p)
+                        throw std::runtime_error("import_csv: unterminated quoted field");
+                    if (p + 1 < e && p[1] == opt.quote) {
+                        escaped = true;
+                        p += 2;
+                    }
+                    else {
+                        break;
+                    }
+                }
+                f.type = SQLITE_TEXT;
+                f.t = std::string_view(b, p - b);
+                ++p;
+                if (escaped) {
+                    std::string& s = unescaped.emplace_back();
+                    s.reserve(f.t.size());
+                    for (size_t k = 0; k < f.t.size(); ++k) {
+                        s.push_back(f.t[k]);
+                        if (f.t[k] == opt.quote)
+                            ++k;
+                    }
+                    f.t = s;
+                }
+            }
+            else {
+                const char* b = p;
+                while (p < e && *p != opt.delimiter && *p != '\n')
+                    ++p;
+                const char* q = p;
+                if (q > b && q[-1] == '\r' && (p == e || *p == '\n'))
+                    --q;
+                f.t = std::string_view(b, q - b);
+                f.type = f.t.empty() ? SQLITE_NULL : SQLITE_TEXT;
+                if (escapes(opt))
+                    f.t = unescape(f.t, unescaped);
+            }
+            out.push_back(f);
+
+            if (p < e && *p == opt.delimiter) {
+                ++p;
+                continue;
+            }
+            if (p < e && *p == '\r')
+                ++p;
+            if (p < e && *p != '\n')
+                throw std::runtime_error("import_csv: unexpected character after quoted field");
+
+            return p < e ? p + 1 : p;
+        }
+    }
+
+    // Convert text to integer or float if the whole field is a number.
+    void parse_number(field& f)
+    {
+        if (f.type != SQLITE_TEXT || f.t.empty())
+            return;
+        const char* b = f.t.data();
+        const char* e = b + f.t.size();
+        if (!(isdigit(static_cast<unsigned char>(*b)) || *b == '-' || *b == '.'))
+            return;
+
+        auto [pi, eci] = std::from_chars(b, e, f.i);
+        if (eci == std::errc() && pi == e) {
+            f.type = SQLITE_INTEGER;
+            return;
+        }
+        auto [pd, ecd] = std::from_chars(b, e, f.d);
+        if (ecd == std::errc() && pd == e) {
+            f.type = SQLITE_FLOAT;
+        }
+    }
+
+    // Parse at most limit records having numeric.size() columns.
+    chunk_rows parse_chunk(const char* b, const char* e, const csv_options& opt,
+        const std::vector<char>& numeric, size_t limit)
+    {
+        chunk_rows rows;
+        size_t n = numeric.size();
+
+        while (b < e && rows.count < limit) {
+            if (*b == '\n' || (*b == '\r' && b + 1 < e && b[1] == '\n')) {
+                b += *b == '\n' ? 1 : 2;
+                continue;
+            }
+            size_t first = rows.fields.size();
+            b = parse_record(b, e, opt, rows.fields, rows.unescaped);
+            size_t m = rows.fields.size() - first;
+            if (m > n)
+                throw std::runtime_error("import_csv: row has " + std::to_string(m) + " fields, expected " + std::to_string(n));
+            rows.fields.resize(first + n);
+            for (size_t j = 0; j < n; ++j) {
+                if (numeric[j])
+                    parse_number(rows.fields[first + j]);
+            }
+            ++rows.count;
+        }
+
+        return rows;
+    }
+
+    // Split [b, e) into chunks of about opt.chunk bytes ending at a newline outside quotes.
+    std::vector<std::pair<const char*, const char*>> split(const char* b, const char* e, const csv_options& opt)
+    {
+        std::vector<std::pair<const char*, const char*>> chunks;
+        // tab delimited files have no quoted newlines
+        auto count = [&opt](const char* p, const char* q) {
+            return escapes(opt) ? 0 : static_cast<size_t>(std::count(p, q, opt.quote));
+        };
+
+        while (b < e) {
+            const char* p = static_cast<size_t>(e - b) > opt.chunk ? b + opt.chunk : e;
+            size_t quotes = count(b, p);
+            while (p < e) {
+                const char* nl = static_cast<const char*>(memchr(p, '\n', e - p));
+                if (!nl) {
+                    p = e;
+                    break;
+                }
+                quotes += count(p, nl);
+                p = nl + 1;
+                if (quotes % 2 == 0)
+                    break;
+            }
+            chunks.emplace_back(b, p);
+            b = p;
+        }
+
+        return chunks;
+    }
+
+    // Whether columns of an existing table have numeric affinity. Empty if no table.
+    // https://www.sqlite.org/datatype3.html#determination_of_column_affinity
+    std::vector<char> table_numeric(sqlite::open& db, const char* table)
+    {
+        std::vector<char> numeric;
+
+        sqlite::open::stmt stmt(db);
+        std::string sql = "PRAGMA table_info(" + quote_identifier(table) + ")";
+        if (SQLITE_OK != stmt.prepare(sql.c_str()))
+            throw std::runtime_error(stmt.errmsg());
+        while (SQLITE_ROW == sqlite3_step(stmt)) {
+            const unsigned char* decl = sqlite3_column_text(stmt, 2);
+            std::string type(decl ? reinterpret_cast<const char*>(decl) : "");
+            std::transform(type.begin(), type.end(), type.begin(), [](unsigned char c) { return static_cast<char>(toupper(c)); });
+            auto has = [&type](const char* s) { return type.find(s) != std::string::npos; };
+            bool text = has("CHAR") || has("CLOB") || has("TEXT") || has("BLOB") || type.empty();
+            numeric.push_back(has("INT") || !text);
+        }
+
+        return numeric;
+    }
+
+    // Create table with columns typed from a sample of rows.
+    std::vector<char> create_from_sample(sqlite::open& db, const char* table, const std::vector<field>& head,
+        const char* b, const char* e, const csv_options& opt)
+    {
+        std::deque<std::string> unescaped;
+        std::vector<field> first;
+        parse_record(b, e, opt, first, unescaped);
+        size_t n = head.empty() ? first.size() : head.size();
+        if (n == 0)
+            throw std::runtime_error("import_csv: no columns");
+
+        std::vector<char> numeric(n, 1);
+        chunk_rows sample = parse_chunk(b, e, opt, numeric, opt.sample);
+        std::vector<int> type(n, SQLITE_INTEGER);
+        std::vector<char> seen(n, 0);
+        for (size_t r = 0; r < sample.count; ++r) {
+            for (size_t j = 0; j < n; ++j) {
+                int t = sample.fields[r * n + j].type;
+                if (t == SQLITE_NULL)
+                    continue;
+                seen[j] = 1;
+                if (t == SQLITE_TEXT)
+                    type[j] = SQLITE_TEXT;
+                else if (t == SQLITE_FLOAT && type[j] == SQLITE_INTEGER)
+                    type[j] = SQLITE_FLOAT;
+            }
+        }
+
+        std::vector<std::string> names(n);
+        std::vector<column_def> columns(n);
+        for (size_t j = 0; j < n; ++j) {
+            names[j] = quote_identifier(j < head.size() ? head[j].t : "c" + std::to_string(j + 1));
+            if (!seen[j])
+                type[j] = SQLITE_TEXT;
+            columns[j].name = names[j];
+            columns[j].type = type[j] == SQLITE_INTEGER ? "INTEGER" : type[j] == SQLITE_FLOAT ? "REAL" : "TEXT";
+            numeric[j] = type[j] != SQLITE_TEXT;
+        }
+        create_table(db, quote_identifier(table), columns);
+
+        return numeric;
+    }
+
+}
+
+csv_stats sqlite::import_csv(open& db, const char* table, const char* file, const csv_options& opt)
+{
+    csv_stats stats;
+    auto start = std::chrono::steady_clock::now();
+
+    mmap_file map(file);
+    const char* b = map.data();
+    const char* e = b + map.size();
+    stats.bytes = map.size();
+    if (e - b >= 3 && memcmp(b, "\xEF\xBB\xBF", 3) == 0)
+        b += 3;
+
+    std::deque<std::string> unescaped;
+    std::vector<field> head;
+    if (opt.header && b < e)
+        b = parse_record(b, e, opt, head, unescaped);
+
+    // One savepoint covers the created table and every row so a failed import
+    // leaves the database as it was. Savepoints nest inside an open transaction.
+    exec(db, "SAVEPOINT import_csv");
+    open::stmt insert(db);
+    try {
+        std::vector<char> numeric = table_numeric(db, table);
+        if (numeric.empty()) {
+            if (!opt.create)
+                throw std::runtime_error(std::string("import_csv: no such table: ") + table);
+            numeric = create_from_sample(db, table, head, b, e, opt);
+        }
+        size_t n = numeric.size();
+
+        std::string sql = "INSERT INTO " + quote_identifier(table) + " VALUES (?";
+        for (size_t j = 1; j < n; ++j)
+            sql.append(", ?");
+        sql.append(")");
+        if (SQLITE_OK != insert.prepare(sql.c_str()))
+            throw std::runtime_error(insert.errmsg());
+
+        auto chunks = split(b, e, opt);
+        unsigned threads = opt.threads ? opt.threads : std::max(1u, std::thread::hardware_concurrency());
+        std::deque<std::future<chunk_rows>> pending;
+        size_t next = 0;
+        while (next < chunks.size() || !pending.empty()) {
+            while (next < chunks.size() && pending.size() < 2 * threads) {
+                auto [cb, ce] = chunks[next++];
+                pending.push_back(std::async(std::launch::async, parse_chunk, cb, ce, std::cref(opt), std::cref(numeric), SIZE_MAX));
+            }
+            chunk_rows rows = pending.front().get();
+            pending.pop_front();
+
+            for (size_t r = 0; r < rows.count; ++r) {
+                const field* f = &rows.fields[r * n];
+                for (int j = 0; j < static_cast<int>(n); ++j) {
+                    switch (f[j].type) {
+                    case SQLITE_INTEGER:
+                        insert.bind(j + 1, f[j].i);
+                        break;
+                    case SQLITE_FLOAT:
+                        insert.bind(j + 1, f[j].d);
+                        break;
+                    case SQLITE_TEXT:
+                        insert.bind(j + 1, f[j].t.data(), static_cast<int>(f[j].t.size()));
+                        break;
+                    default:
+                        sqlite3_bind_null(insert, j + 1);
+                    }
+                }
+                if (SQLITE_DONE != sqlite3_step(insert))
+                    throw std::runtime_error("import_csv: row " + std::to_string(stats.rows + r + 1) + ": " + insert.errmsg());
+                sqlite3_reset(insert);
+            }
+            stats.rows += rows.count;
+        }
+        exec(db, "RELEASE import_csv");
+    }
+    catch (...) {
+        sqlite3_reset(insert);
+        sqlite3_exec(db, "ROLLBACK TO import_csv; RELEASE import_csv", nullptr, nullptr, nullptr);
+
+        throw;
+    }
+
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    return stats;
+}
+
+namespace {
+
+    // Buffered file output written in large blocks.
+    class file_writer {
+        FILE* fp;
+        std::vector<char> buf;
+        size_t n = 0;
+        size_t bytes_ = 0;
+    public:
+        file_writer(const char* file, size_t size = 4 << 20)
+            : fp(fopen(file, "wb")), buf(size)
+        {
+            if (!fp)
+                throw std::runtime_error(std::string("cannot open file for writing: ") + file);
+        }
+        file_writer(const file_writer&) = delete;
+        file_writer& operator=(const file_writer&) = delete;
+        ~file_writer()
+        {
+            if (fp)
+                fclose(fp);
+        }
+
+        void flush()
+        {
+            if (n && fwrite(buf.data(), 1, n, fp) != n)
+                throw std::runtime_error("export_csv: write failed");
+            bytes_ += n;
+            n = 0;
+        }
+        void close()
+        {
+            flush();
+            FILE* f = fp;
+            fp = nullptr;
+            if (fclose(f) != 0)
+                throw std::runtime_error("export_csv: close failed");
+        }
+        size_t bytes() const
+        {
+            return bytes_ + n;
+        }
+
+        void put(char c)
+        {
+            if (n == buf.size())
+                flush();
+            buf[n++] = c;
+        }
+        void write(const char* p, size_t len)
+        {
+            if (len > buf.size() - n) {
+                flush();
+                if (len > buf.size()) {
+                    if (fwrite(p, 1, len, fp) != len)
+                        throw std::runtime_error("export_csv: write failed");
+                    bytes_ += len;
+                    return;
+                }
+            }
+            memcpy(buf.data() + n, p, len);
+            n += len;
+        }
+        // Format with std::to_chars directly into the buffer.
+        template<class T>
+        void number(T t)
+        {
+            constexpr size_t max = 32;
+            if (buf.size() - n < max)
+                flush();
+            auto [p, ec] = std::to_chars(buf.data() + n, buf.data() + n + max, t);
+            n = p - buf.data();
+        }
+    };
+
+    void write_field(file_writer& out, std::string_view t, const csv_options& opt)
+    {
+        if (opt.delimiter == '\t') {
+            size_t b = 0;
+            for (size_t i = 0; i < t.size(); ++i) {
+                char c = t[i];
+                if (c == '\t' || c == '\n' || c == '\r' || c == '\\') {
+                    out.write(t.data() + b, i - b);
+                    out.put('\\');
+                    out.put(c == '\t' ? 't' : c == '\n' ? 'n' : c == '\r' ? 'r' : '\\');
+                    b = i + 1;
+                }
+            }
+            out.write(t.data() + b, t.size() - b);
+
+            return;
+        }
+
+        const char special[] = { opt.delimiter, opt.quote, '\n', '\r' };
+        if (t.find_first_of(special, 0, sizeof(special)) == std::string_view::npos) {
+            out.write(t.data(), t.size());
+
+            return;
+        }
+        out.put(opt.quote);
+        size_t b = 0;
+        for (size_t q = t.find(opt.quote); q != std::string_view::npos; q = t.find(opt.quote, q + 1)) {
+            out.write(t.data() + b, q + 1 - b);
+            out.put(opt.quote);
+            b = q + 1;
+        }
+        out.write(t.data() + b, t.size() - b);
+        out.put(opt.quote);
+    }
+
+}
+
+csv_stats sqlite::export_csv(open& db, const char* sql, const char* file, const csv_options& opt)
+{
+    csv_stats stats;
+    auto start = std::chrono::steady_clock::now();
+
+    open::stmt stmt(db);
+    if (SQLITE_OK != stmt.prepare(sql))
+        throw std::runtime_error(stmt.errmsg());
+    // only comments and semicolons may follow, which prepare to no statement
+    open::stmt rest(db);
+    if (SQLITE_OK != rest.prepare(stmt.tail()))
+        throw std::runtime_error(rest.errmsg());
+    if (rest)
+        throw std::runtime_error("export_csv: sql must be a single statement");
+    int n = sqlite3_column_count(stmt);
+
+    file_writer out(file);
+    if (opt.header) {
+        for (int j = 0; j < n; ++j) {
+            if (j)
+                out.put(opt.delimiter);
+            write_field(out, sqlite3_column_name(stmt, j), opt);
+        }
+        out.put('\n');
+    }
+
+    static const char hex[] = "0123456789ABCDEF";
+    int rc;
+    while (SQLITE_ROW == (rc = sqlite3_step(stmt))) {
+        for (int j = 0; j < n; ++j) {
+            if (j)
+                out.put(opt.delimiter);
+            switch (sqlite3_column_type(stmt, j)) {
+            case SQLITE_INTEGER:
+                out.number(sqlite3_column_int64(stmt, j));
+                break;
+            case SQLITE_FLOAT:
+                out.number(sqlite3_column_double(stmt, j));
+                break;
+            case SQLITE_TEXT: {
+                const char* t = reinterpret_cast<const char*>(sqlite3_column_text(stmt, j));
+                write_field(out, std::string_view(t, sqlite3_column_bytes(stmt, j)), opt);
+                break;
+            }
+            case SQLITE_BLOB: {
+                const unsigned char* b = static_cast<const unsigned char*>(sqlite3_column_blob(stmt, j));
+                for (int k = 0; k < sqlite3_column_bytes(stmt, j); ++k) {
+                    out.put(hex[b[k] >> 4]);
+                    out.put(hex[b[k] & 0xF]);
+                }
+                break;
+            }
+            }
+        }
+        out.put('\n');
+        ++stats.rows;
+    }
+    if (rc != SQLITE_DONE)
+        throw std::runtime_error(stmt.errmsg());
+
+    out.close();
+    stats.bytes = out.bytes();
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    return stats;
+}
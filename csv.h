@@ -0,0 +1,42 @@
+// csv.h - bulk import and export of delimited files
+#pragma once
+#include "sqlite.h"
+
+namespace sqlite {
+
+    // A tab delimiter reads and writes backslash escapes instead of quoting.
+    struct csv_options {
+        char delimiter = ',';
+        char quote = '"';
+        bool header = true;     // first line has column names
+        bool create = true;     // create the table if it does not exist
+        size_t sample = 1000;   // rows used to infer column types
+        unsigned threads = 0;   // parser threads, 0 for hardware concurrency
+        size_t chunk = 16 << 20;    // bytes per parser chunk
+    };
+
+    struct csv_stats {
+        size_t rows = 0;
+        size_t bytes = 0;
+        double seconds = 0;
+
+        double mb_per_sec() const
+        {
+            return seconds > 0 ? bytes / (seconds * 1024 * 1024) : 0;
+        }
+    };
+
+    // Import a memory mapped delimited file into table.
+    // Chunks are parsed on multiple threads and inserted in file order by the
+    // calling thread using one prepared INSERT inside a single savepoint.
+    // On error nothing is imported, including a table created for the file,
+    // and the message has the row that failed.
+    // Column types of a new table are inferred from the first sample rows.
+    csv_stats import_csv(open& db, const char* table, const char* file, const csv_options& options = csv_options{});
+
+    // Write the rows of sql to file through a large buffer.
+    // Throws if sql has more than one statement.
+    // Memory use does not depend on the number of rows.
+    csv_stats export_csv(open& db, const char* sql, const char* file, const csv_options& options = csv_options{});
+
+}
@@ -0,0 +1,476 @@
+// fingerprint.cpp - SQL tokenizer for statement fingerprints
+#include <charconv>
+#include <cstring>
+#include "fingerprint.h"
+
+using namespace sqlite;
+
+namespace {
+
+    // https://www.sqlite.org/lang_keywords.html
+    // https://www.sqlite.org/lang_expr.html#literal_values_constants_
+    enum token {
+        END, SPACE, WORD, QUOTED, STRING, BLOB, NUMBER, PARAMETER, LPAREN, RPAREN, SEMI, OTHER
+    };
+
+    // character classes
+    enum : unsigned char {
+        C_SPACE = 1, C_WORD = 2, C_DIGIT = 4, C_HEX = 8,
+    };
+    struct classes {
+        unsigned char c[256] = {};
+        constexpr classes()
+        {
+            for (int i : { ' ', '\t', '\n', '\r', '\f' })
+                c[i] = C_SPACE;
+            for (int i = 'a'; i <= 'z'; ++i)
+                c[i] = C_WORD;
+            for (int i = 'A'; i <= 'Z'; ++i)
+                c[i] = C_WORD;
+            for (int i = 0x80; i < 0x100; ++i)
+                c[i] = C_WORD;
+            c['_'] = C_WORD;
+            for (int i = '0'; i <= '9'; ++i)
+                c[i] = C_DIGIT | C_HEX;
+            for (int i = 'a'; i <= 'f'; ++i)
+                c[i] |= C_HEX;
+            for (int i = 'A'; i <= 'F'; ++i)
+                c[i] |= C_HEX;
+        }
+    };
+    constexpr classes table;
+
+    bool is_space(char c)
+    {
+        return table.c[static_cast<unsigned char>(c)] & C_SPACE;
+    }
+    bool word_start(char c)
+    {
+        return table.c[static_cast<unsigned char>(c)] & C_WORD;
+    }
+    bool word_char(char c)
+    {
+        return (table.c[static_cast<unsigned char>(c)] & (C_WORD | C_DIGIT)) || c == '$';
+    }
+    bool digit(char c)
+    {
+        return table.c[static_cast<unsigned char>(c)] & C_DIGIT;
+    }
+    bool hex(char c)
+    {
+        return table.c[static_cast<unsigned char>(c)] & C_HEX;
+    }
+
+    // Length and kind of the next token in s[i, n).
+    token next(const char* s, size_t i, size_t n, size_t& len)
+    {
+        const size_t b = i;
+        if (i == n) {
+            len = 0;
+
+            return END;
+        }
+
+        char c = s[i];
+        token t = OTHER;
+        if (is_space(c)) {
+            while (i < n && is_space(s[i]))
+                ++i;
+            t = SPACE;
+        }
+        else if (c == '-' && i + 1 < n && s[i + 1] == '-') {
+            while (i < n && s[i] != '\n')
+                ++i;
+            t = SPACE;
+        }
+        else if (c == '/' && i + 1 < n && s[i + 1] == '*') {
+            i += 2;
+            while (i + 1 < n && !(s[i] == '*' && s[i + 1] == '/'))
+                ++i;
+            i = i + 1 < n ? i + 2 : n;
+            t = SPACE;
+        }
+        else if ((c == 'x' || c == 'X') && i + 1 < n && s[i + 1] == '\'') {
+            for (i += 2; i < n && s[i] != '\''; ++i)
+                ;
+            i = i < n ? i + 1 : n;
+            t = BLOB;
+        }
+        else if (word_start(c)) {
+            while (i < n && word_char(s[i]))
+                ++i;
+            t = WORD;
+        }
+        else if (digit(c) || (c == '.' && i + 1 < n && digit(s[i + 1]))) {
+            if (c == '0' && i + 2 < n && (s[i + 1] == 'x' || s[i + 1] == 'X') && hex(s[i + 2])) {
+                for (i += 2; i < n && hex(s[i]); ++i)
+                    ;
+            }
+            else {
+                while (i < n && digit(s[i]))
+                    ++i;
+                if (i < n && s[i] == '.')
+                    for (++i; i < n && digit(s[i]); ++i)
+                        ;
+                if (i + 1 < n && (s[i] == 'e' || s[i] == 'E')) {
+                    size_t j = i + 1;
+                    if (j < n && (s[j] == '+' || s[j] == '-'))
+                        ++j;
+                    if (j < n && digit(s[j]))
+                        for (i = j; i < n && digit(s[i]); ++i)
+                            ;
+                }
+            }
+            t = NUMBER;
+        }
+        else if (c == '\'') {
+            // '' is an escaped quote
+            for (++i; i < n; ++i) {
+                if (s[i] == '\'') {
+                    if (i + 1 < n && s[i + 1] == '\'')
+                        ++i;
+                    else
+                        break;
+                }
+            }
+            i = i < n ? i + 1 : n;
+            t = STRING;
+        }
+        else if (c == '"' || c == '`' || c == '[') {
+            char close = c == '[' ? ']' : c;
+            for (++i; i < n; ++i) {
+                if (s[i] == close) {
+                    if (close != ']' && i + 1 < n && s[i + 1] == close)
+                        ++i;
+                    else
+                        break;
+                }
+            }
+            i = i < n ? i + 1 : n;
+            t = QUOTED;
+        }
+        else if (c == '?' || c == ':' || c == '@' || c == '$') {
+            for (++i; i < n && word_char(s[i]); ++i)
+                ;
+            t = PARAMETER;
+        }
+        else {
+            ++i;
+            t = c == '(' ? LPAREN : c == ')' ? RPAREN : c == ';' ? SEMI : OTHER;
+            // multi-character operators
+            if (t == OTHER && i < n) {
+                char d = s[i];
+                if ((c == '<' && (d == '=' || d == '>' || d == '<')) || (c == '>' && (d == '=' || d == '>'))
+                    || (c == '!' && d == '=') || (c == '=' && d == '=') || (c == '|' && d == '|')) {
+                    ++i;
+                }
+                else if (c == '-' && d == '>') {
+                    i += (i + 1 < n && s[i + 1] == '>') ? 2 : 1;
+                }
+            }
+        }
+        len = i - b;
+
+        return t;
+    }
+
+    // Case insensitive comparison with an upper case keyword.
+    bool is(std::string_view word, std::string_view keyword)
+    {
+        if (word.size() != keyword.size())
+            return false;
+        for (size_t i = 0; i < word.size(); ++i) {
+            if ((word[i] & ~0x20) != keyword[i])
+                return false;
+        }
+
+        return true;
+    }
+    template<size_t N>
+    bool is_any(std::string_view word, const std::string_view (&keywords)[N])
+    {
+        for (const auto& kw : keywords) {
+            if (is(word, kw))
+                return true;
+        }
+
+        return false;
+    }
+
+    // Statements that accept parameters in place of literals.
+    constexpr std::string_view parameterizable[] = {
+        "SELECT", "INSERT", "UPDATE", "DELETE", "REPLACE", "VALUES", "WITH"
+    };
+    // Keywords ending an ORDER BY or GROUP BY list.
+    constexpr std::string_view ends_terms[] = {
+        "HAVING", "LIMIT", "WINDOW", "UNION", "INTERSECT", "EXCEPT", "SELECT"
+    };
+    // Keywords ending a result column list.
+    constexpr std::string_view ends_columns[] = {
+        "FROM", "WHERE", "GROUP", "HAVING", "WINDOW", "ORDER", "LIMIT", "UNION", "INTERSECT", "EXCEPT"
+    };
+    // Keywords followed by table names, which SQLite also reads from string literals.
+    constexpr std::string_view names_follow[] = {
+        "FROM", "JOIN", "INTO", "UPDATE", "TABLE"
+    };
+
+    // Value of a numeric literal or false if it does not fit in a param.
+    bool number(std::string_view t, param& p)
+    {
+        const char* b = t.data();
+        const char* e = b + t.size();
+        if (t.size() > 2 && (t[1] == 'x' || t[1] == 'X')) {
+            // hex literals are 64-bit two's complement
+            uint64_t u;
+            auto [ptr, ec] = std::from_chars(b + 2, e, u, 16);
+            if (ec != std::errc{} || ptr != e)
+                return false;
+            p = static_cast<sqlite_int64>(u);
+        }
+        else if (t.find_first_of(".eE") == std::string_view::npos) {
+            // decimal literals that overflow are REAL
+            sqlite_int64 i;
+            auto [ptr, ec] = std::from_chars(b, e, i);
+            if (ec != std::errc{} || ptr != e)
+                return false;
+            p = i;
+        }
+        else {
+            double d;
+            auto [ptr, ec] = std::from_chars(b, e, d);
+            if (ec != std::errc{} || ptr != e)
+                return false;
+            p = d;
+        }
+
+        return true;
+    }
+
+    bool quoted(std::string_view t)
+    {
+        return t.size() >= 2 && t.back() == '\'';
+    }
+
+    // '' escapes removed
+    std::string unquote(std::string_view t)
+    {
+        std::string s;
+        s.reserve(t.size() - 2);
+        for (size_t i = 1; i + 1 < t.size(); ++i) {
+            s.push_back(t[i]);
+            if (t[i] == '\'')
+                ++i;
+        }
+
+        return s;
+    }
+
+    // What happens to literals at one level of parentheses.
+    enum mode {
+        NORMAL,     // extract
+        TERMS,      // ORDER BY or GROUP BY terms where integers are column numbers
+        KEEP,       // window definitions and expressions in terms
+    };
+
+}
+
+size_t fingerprint::normalize(std::string_view sql_)
+{
+    // Literals can be bound only in DML without user parameters.
+    // Extraction stops when either is found and the SQL is normalized again
+    // if literals were already extracted.
+    bool extract = true;
+    if (!tokenize(sql_, extract) && !params.empty()) {
+        extract = false;
+        tokenize(sql_, extract);
+    }
+
+    return params.size();
+}
+
+bool fingerprint::tokenize(std::string_view sql_, bool& extract)
+{
+    sql.clear();
+    params.clear();
+    sql.reserve(sql_.size());
+
+    const char* s = sql_.data();
+    const size_t n = sql_.size();
+    const bool extract_ = extract;
+    bool first = true;      // next word starts a statement
+
+    std::vector<mode> modes{ NORMAL };
+    std::string_view prev;  // previous word or empty
+    bool name = false;      // previous token is a function or table name
+    bool window = false;    // in a WINDOW clause
+    bool columns = false;   // in a result column list or RETURNING clause
+    bool table = false;     // strings are table names
+    size_t nest = 0;        // parentheses in the result column list
+    size_t begin = 0, end = 0; // verbatim result columns
+
+    // single space between tokens except after ( . and before ) , . ; and ( of a call
+    auto space = [this]() {
+        if (!sql.empty() && sql.back() != ' ' && sql.back() != '(' && sql.back() != '.')
+            sql.push_back(' ');
+    };
+    auto trim = [this]() {
+        if (!sql.empty() && sql.back() == ' ')
+            sql.pop_back();
+    };
+
+    size_t len;
+    for (size_t i = 0; i <= n; i += len) {
+        token t = next(s, i, n, len);
+        std::string_view tok(s + i, len);
+
+        if (columns) {
+            if (t == LPAREN) {
+                ++nest;
+            }
+            else if (t == RPAREN && nest) {
+                --nest;
+            }
+            else if (t == END || t == SEMI || t == RPAREN || (t == WORD && nest == 0 && is_any(tok, ends_columns))) {
+                columns = false;
+                if (end > begin) {
+                    space();
+                    sql.append(s + begin, end - begin);
+                }
+            }
+            if (columns) {
+                if (t == PARAMETER)
+                    extract = false;
+                if (t != SPACE) {
+                    if (end == 0)
+                        begin = i;
+                    end = i + len;
+                }
+
+                continue;
+            }
+        }
+
+        mode& m = modes.back();
+        bool call = name;
+        if (t != SPACE)
+            name = t == QUOTED;
+        // table names are listed after the keyword, with aliases and commas
+        if (t != SPACE && t != WORD && t != STRING && tok != ",")
+            table = false;
+        switch (t) {
+        case END:
+            len = 1;
+
+            break;
+        case SPACE:
+            break;
+        case WORD: {
+            if (first && !is_any(tok, parameterizable))
+                extract = false;
+            first = false;
+            bool keyword = sqlite3_keyword_check(tok.data(), static_cast<int>(tok.size())) != 0;
+            space();
+            size_t k = sql.size();
+            sql.append(tok);
+            name = !keyword;
+            if (!keyword) {
+                prev = tok;
+
+                break;
+            }
+            table = is_any(tok, names_follow);
+            for (; k < sql.size(); ++k) {
+                if (sql[k] >= 'a' && sql[k] <= 'z')
+                    sql[k] -= 0x20;
+            }
+
+            if (is(tok, "SELECT") || is(tok, "RETURNING")) {
+                columns = true;
+                nest = begin = end = 0;
+            }
+            else if (is(tok, "BY") && (is(prev, "ORDER") || is(prev, "GROUP"))) {
+                if (m == NORMAL)
+                    m = TERMS;
+                window = false;
+            }
+            else if (is(tok, "WINDOW")) {
+                window = true;
+            }
+            else if (is_any(tok, ends_terms)) {
+                if (m == TERMS)
+                    m = NORMAL;
+                window = false;
+            }
+            prev = tok;
+
+            break;
+        }
+        case NUMBER:
+        case STRING: {
+            param p;
+            space();
+            if (t == STRING && table) {
+                // FROM 'tracks' is FROM "tracks"
+                sql.append(tok);
+                name = true;
+            }
+            else if (extract && m == NORMAL && (t == STRING ? quoted(tok) && (p = unquote(tok), true) : number(tok, p))) {
+                sql.push_back('?');
+                params.push_back(std::move(p));
+            }
+            else {
+                sql.append(tok);
+            }
+            prev = std::string_view{};
+
+            break;
+        }
+        case LPAREN:
+            if (call)
+                trim();
+            else
+                space();
+            sql.push_back('(');
+            // arguments of a call are kept so expression indexes still match
+            modes.push_back(call || m != NORMAL || is(prev, "OVER") || (window && is(prev, "AS")) ? KEEP : NORMAL);
+            prev = std::string_view{};
+
+            break;
+        case RPAREN:
+            trim();
+            sql.push_back(')');
+            if (modes.size() > 1)
+                modes.pop_back();
+            prev = std::string_view{};
+
+            break;
+        case SEMI:
+            first = true;
+            trim();
+            sql.push_back(';');
+            modes.assign(1, NORMAL);
+            window = false;
+            prev = std::string_view{};
+
+            break;
+        case PARAMETER:
+            extract = false;
+            space();
+            sql.append(tok);
+            prev = std::string_view{};
+
+            break;
+        default:
+            if (tok == "," || tok == ".")
+                trim();
+            else
+                space();
+            sql.append(tok);
+            prev = std::string_view{};
+        }
+    }
+    while (!sql.empty() && (sql.back() == ' ' || sql.back() == ';'))
+        sql.pop_back();
+
+    return extract == extract_;
+}
@@ -0,0 +1,61 @@
+// fingerprint.h - normalized SQL with literals extracted into parameters
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "sqlite.h"
+
+namespace sqlite {
+
+    // SQL text that differs only in whitespace, comments, keyword case or
+    // literal constants has the same fingerprint.
+    // Numeric and string literals are replaced by ? and kept in params so
+    // the normalized SQL can be used as the statement cache key.
+    // Literals are not extracted from statements other than SELECT, INSERT,
+    // UPDATE, DELETE, REPLACE, VALUES and WITH, from SQL that already has
+    // parameters, from result columns, ORDER BY and GROUP BY terms,
+    // window definitions, or function call arguments so expression
+    // indexes such as substr(name, 1, 3) still match. Result columns are
+    // copied verbatim so column names do not change.
+    class fingerprint {
+        // Return false if extract was set to false.
+        bool tokenize(std::string_view sql_, bool& extract);
+    public:
+        std::string sql;
+        std::vector<param> params;
+
+        fingerprint() = default;
+        fingerprint(std::string_view sql_)
+        {
+            normalize(sql_);
+        }
+
+        // Replace the fingerprint with that of sql_ and return the number of extracted literals.
+        size_t normalize(std::string_view sql_);
+
+        // 64-bit FNV-1a hash of the normalized SQL that is stable across processes.
+        uint64_t hash() const
+        {
+            uint64_t h = 0xcbf29ce484222325ull;
+            for (unsigned char c : sql) {
+                h ^= c;
+                h *= 0x100000001b3ull;
+            }
+
+            return h;
+        }
+
+        // Bind extracted literals to ?1, ?2, ... and return the number bound.
+        int bind(sqlite3_stmt* pstmt) const
+        {
+            for (int i = 0; i < static_cast<int>(params.size()); ++i) {
+                if (SQLITE_OK != sqlite::bind(pstmt, i + 1, params[i]))
+                    throw std::runtime_error(errmsg(pstmt));
+            }
+
+            return static_cast<int>(params.size());
+        }
+    };
+
+}
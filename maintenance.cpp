@@ -0,0 +1,129 @@
+// maintenance.cpp - background PRAGMA optimize, ANALYZE and WAL checkpoints
+#include <algorithm>
+#include <functional>
+#include "maintenance.h"
+
+using namespace sqlite;
+using std::chrono::steady_clock;
+
+maintenance_scheduler::maintenance_scheduler(open& db, const maintenance_options& options)
+    : activity(db.activity), options(options)
+{
+    const char* file = sqlite3_db_filename(db, "main");
+    if (!file || !*file)
+        throw std::runtime_error("maintenance_scheduler: database must be a file");
+    if (sqlite3_db_readonly(db, "main"))
+        throw std::runtime_error("maintenance_scheduler: database must be writable");
+
+    if (SQLITE_OK != sqlite3_open_v2(file, &pdb, SQLITE_OPEN_READWRITE, nullptr)) {
+        std::string err(sqlite3_errmsg(pdb));
+        sqlite3_close(pdb);
+
+        throw std::runtime_error(err);
+    }
+    sqlite3_busy_timeout(pdb, options.busy_timeout);
+    // https://www.sqlite.org/pragma.html#pragma_analysis_limit
+    std::string limit = "PRAGMA analysis_limit=" + std::to_string(options.analysis_limit);
+    sqlite3_exec(pdb, limit.c_str(), nullptr, nullptr, nullptr);
+
+    thread = std::thread(&maintenance_scheduler::run, this);
+}
+
+maintenance_scheduler::~maintenance_scheduler()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    cv.notify_all();
+    if (thread.joinable())
+        thread.join();
+    sqlite3_close(pdb);
+}
+
+// Run f and record its duration and result.
+void maintenance_scheduler::task(maintenance_task& t, const std::function<int()>& f)
+{
+    auto last = std::chrono::system_clock::now();
+    auto t0 = steady_clock::now();
+    int rc = f();
+    double seconds = std::chrono::duration<double>(steady_clock::now() - t0).count();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    ++t.runs;
+    t.last = last;
+    t.seconds = seconds;
+    if (rc != SQLITE_OK) {
+        ++t.errors;
+        t.error = sqlite3_errmsg(pdb);
+    }
+}
+
+void maintenance_scheduler::run()
+{
+    using std::chrono::milliseconds;
+
+    // poll often enough to notice idle periods
+    const milliseconds tick = std::clamp(options.idle / 4, milliseconds(10), milliseconds(1000));
+
+    size_t seen = activity.load(std::memory_order_relaxed);
+    auto changed = steady_clock::now();
+    struct due {
+        milliseconds interval;
+        bool never = true;
+        steady_clock::time_point last{};
+
+        bool operator()(steady_clock::time_point now) const
+        {
+            return interval.count() > 0 && (never || now - last >= interval);
+        }
+        void ran(steady_clock::time_point now)
+        {
+            never = false;
+            last = now;
+        }
+    } optimize{ options.optimize }, analyze{ options.analyze }, checkpoint{ options.checkpoint };
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stop) {
+        cv.wait_for(lock, tick);
+        if (stop)
+            break;
+
+        auto now = steady_clock::now();
+        size_t a = activity.load(std::memory_order_relaxed);
+        if (a != seen) {
+            seen = a;
+            changed = now;
+        }
+        status_.idle = now - changed >= options.idle;
+        if (!status_.idle)
+            continue;
+
+        // tasks run without the lock so status() does not wait for them
+        status_.running = true;
+        lock.unlock();
+        if (optimize(now)) {
+            // https://www.sqlite.org/pragma.html#pragma_optimize
+            // 0x10002 considers every table, not only those used by this connection
+            task(status_.optimize, [this] { return sqlite3_exec(pdb, "PRAGMA optimize=0x10002", nullptr, nullptr, nullptr); });
+            optimize.ran(now);
+        }
+        if (analyze(now) && activity.load(std::memory_order_relaxed) == seen) {
+            task(status_.analyze, [this] { return sqlite3_exec(pdb, "ANALYZE", nullptr, nullptr, nullptr); });
+            analyze.ran(now);
+        }
+        if (checkpoint(now) && activity.load(std::memory_order_relaxed) == seen) {
+            int log = -1, ckpt = -1;
+            task(status_.checkpoint, [this, &log, &ckpt] {
+                return sqlite3_wal_checkpoint_v2(pdb, nullptr, options.checkpoint_mode, &log, &ckpt);
+            });
+            checkpoint.ran(now);
+            std::lock_guard<std::mutex> guard(mutex);
+            status_.wal_frames = log;
+            status_.checkpointed_frames = ckpt;
+        }
+        lock.lock();
+        status_.running = false;
+    }
+}
@@ -0,0 +1,86 @@
+// maintenance.h - background PRAGMA optimize, ANALYZE and WAL checkpoints
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "sqlite.h"
+
+namespace sqlite {
+
+    // Tasks run when no statement has started on the connection for idle.
+    // Each task runs at the first idle period and then at most once per interval.
+    // An interval of 0 disables a task.
+    struct maintenance_options {
+        std::chrono::milliseconds idle{ 5000 };
+        std::chrono::milliseconds optimize{ 3600000 };      // PRAGMA optimize
+        std::chrono::milliseconds analyze{ 86400000 };      // ANALYZE
+        std::chrono::milliseconds checkpoint{ 60000 };      // sqlite3_wal_checkpoint_v2
+        int analysis_limit = 400;   // rows examined per index, 0 for no limit
+        int checkpoint_mode = SQLITE_CHECKPOINT_TRUNCATE;
+        int busy_timeout = 100;     // milliseconds to wait for locks
+    };
+
+    struct maintenance_task {
+        size_t runs = 0;
+        size_t errors = 0;
+        double seconds = 0;         // duration of the last run
+        std::chrono::system_clock::time_point last; // start of the last run
+        std::string error;          // of the last failed run
+    };
+
+    struct maintenance_status {
+        bool running = false;       // a task is running now
+        bool idle = false;
+        maintenance_task optimize, analyze, checkpoint;
+        int wal_frames = -1;        // from the last checkpoint, -1 if not in WAL mode
+        int checkpointed_frames = -1;
+    };
+
+    // Background thread with its own connection to the database file so the
+    // caller's connection and statement cache are never used off its thread.
+    // Idle is detected from open::activity.
+    class maintenance_scheduler {
+        const std::atomic<size_t>& activity;
+        sqlite3* pdb = nullptr;
+        maintenance_options options;
+        mutable std::mutex mutex;
+        std::condition_variable cv;
+        bool stop = false;
+        maintenance_status status_;
+        std::thread thread;
+
+        void run();
+        void task(maintenance_task& t, const std::function<int()>& f);
+    public:
+        // The database must be a writable file.
+        maintenance_scheduler(open& db, const maintenance_options& options = maintenance_options{});
+        maintenance_scheduler(const maintenance_scheduler&) = delete;
+        maintenance_scheduler& operator=(const maintenance_scheduler&) = delete;
+        ~maintenance_scheduler();
+
+        maintenance_status status() const
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            return status_;
+        }
+    };
+
+    // Replace the scheduler of a connection.
+    inline maintenance_scheduler& start_maintenance(open& db, const maintenance_options& options = maintenance_options{})
+    {
+        db.maintenance.reset();
+        db.maintenance = std::make_shared<maintenance_scheduler>(db, options);
+
+        return *db.maintenance;
+    }
+
+    inline void stop_maintenance(open& db)
+    {
+        db.maintenance.reset();
+    }
+
+}
@@ -0,0 +1,411 @@
+// pcache.cpp - page cache shared by all connections under one memory budget
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include "pcache.h"
+
+using namespace sqlite;
+
+namespace {
+
+    struct cache;
+
+    // Allocated with sqlite3_malloc64 followed by the page and extra bytes.
+    struct page {
+        sqlite3_pcache_page base;
+        cache* owner;
+        unsigned key;
+        bool pinned;
+        page* prev; // LRU list of unpinned pages, most recent first
+        page* next;
+    };
+    static_assert(sizeof(page) % 8 == 0);
+
+    struct cache {
+        int szPage;
+        int szExtra;
+        bool purgeable;
+        std::unordered_map<unsigned, page*> pages;
+        size_t pinned = 0;
+        size_t hits = 0, misses = 0, evictions = 0;
+        // set by pcache_connection
+        const sqlite3* db = nullptr;
+        std::string schema, file;
+
+        cache(int szPage, int szExtra, bool purgeable)
+            : szPage(szPage), szExtra(szExtra), purgeable(purgeable)
+        { }
+        sqlite_int64 page_bytes() const
+        {
+            return static_cast<sqlite_int64>(sizeof(page)) + szPage + szExtra;
+        }
+    };
+
+    // Everything is guarded by one mutex like the shared pcache1 mode.
+    struct state {
+        std::mutex mutex;
+        bool installed = false;
+        sqlite_int64 budget = 0;
+        sqlite_int64 used = 0;
+        page lru{}; // sentinel, lru.next is most recent
+        std::map<cache*, std::unique_ptr<cache>> caches;
+
+        state()
+        {
+            lru.prev = lru.next = &lru;
+        }
+        void unlink(page* p)
+        {
+            p->prev->next = p->next;
+            p->next->prev = p->prev;
+            p->prev = p->next = nullptr;
+        }
+        void push_front(page* p)
+        {
+            p->next = lru.next;
+            p->prev = &lru;
+            lru.next->prev = p;
+            lru.next = p;
+        }
+        // Remove an unpinned page from its cache and the LRU list without freeing it.
+        void detach(page* p)
+        {
+            unlink(p);
+            p->owner->pages.erase(p->key);
+            used -= p->owner->page_bytes();
+        }
+        void discard(page* p)
+        {
+            cache* c = p->owner;
+            if (p->pinned)
+                --c->pinned;
+            else if (p->prev)
+                unlink(p);
+            c->pages.erase(p->key);
+            used -= c->page_bytes();
+            sqlite3_free(p);
+        }
+        // Evict least recently used pages while over budget.
+        void evict(sqlite_int64 budget)
+        {
+            while (used > budget && lru.prev != &lru) {
+                page* p = lru.prev;
+                ++p->owner->evictions;
+                detach(p);
+                sqlite3_free(p);
+            }
+        }
+    } pc;
+
+    // caches whose first page was fetched on this thread while probing
+    thread_local std::vector<cache*>* probed = nullptr;
+
+    int xInit(void*)
+    {
+        return SQLITE_OK;
+    }
+
+    void xShutdown(void*)
+    { }
+
+    sqlite3_pcache* xCreate(int szPage, int szExtra, int bPurgeable)
+    {
+        auto c = std::make_unique<cache>(szPage, szExtra, bPurgeable != 0);
+        cache* p = c.get();
+
+        std::lock_guard<std::mutex> lock(pc.mutex);
+        pc.caches.emplace(p, std::move(c));
+
+        return reinterpret_cast<sqlite3_pcache*>(p);
+    }
+
+    void xCachesize(sqlite3_pcache*, int)
+    { }
+
+    int xPagecount(sqlite3_pcache* pcache)
+    {
+        std::lock_guard<std::mutex> lock(pc.mutex);
+
+        return static_cast<int>(reinterpret_cast<cache*>(pcache)->pages.size());
+    }
+
+    sqlite3_pcache_page* xFetch(sqlite3_pcache* pcache, unsigned key, int createFlag)
+    {
+        cache* c = reinterpret_cast<cache*>(pcache);
+
+        std::lock_guard<std::mutex> lock(pc.mutex);
+        if (probed) {
+            if (key == 1)
+                probed->push_back(c);
+        }
+        auto i = c->pages.find(key);
+        if (i != c->pages.end()) {
+            page* p = i->second;
+            if (!probed)
+                ++c->hits;
+            if (!p->pinned) {
+                pc.unlink(p);
+                p->pinned = true;
+                ++c->pinned;
+            }
+
+            return &p->base;
+        }
+        if (createFlag == 0)
+            return nullptr;
+
+        // https://www.sqlite.org/c3ref/pcache_methods2.html createFlag 1 may fail
+        const sqlite_int64 bytes = c->page_bytes();
+        page* p = nullptr;
+        if (pc.used + bytes > pc.budget) {
+            // recycle the least recently used page if it has the right size
+            if (pc.lru.prev != &pc.lru) {
+                page* q = pc.lru.prev;
+                ++q->owner->evictions;
+                pc.detach(q);
+                if (q->owner->page_bytes() == bytes)
+                    p = q;
+                else
+                    sqlite3_free(q);
+                pc.evict(pc.budget - bytes);
+            }
+            else if (createFlag == 1) {
+                return nullptr;
+            }
+        }
+        if (!p) {
+            p = static_cast<page*>(sqlite3_malloc64(bytes));
+            if (!p)
+                return nullptr;
+        }
+        char* buf = reinterpret_cast<char*>(p + 1);
+        p->base.pBuf = buf;
+        p->base.pExtra = buf + c->szPage;
+        // SQLite expects a zero header in the extra bytes of a new page
+        std::memset(p->base.pExtra, 0, c->szExtra);
+        p->owner = c;
+        p->key = key;
+        p->pinned = true;
+        p->prev = p->next = nullptr;
+        c->pages.emplace(key, p);
+        ++c->pinned;
+        if (!probed)
+            ++c->misses;
+        pc.used += bytes;
+
+        return &p->base;
+    }
+
+    void xUnpin(sqlite3_pcache* pcache, sqlite3_pcache_page* pPage, int discard)
+    {
+        cache* c = reinterpret_cast<cache*>(pcache);
+        page* p = reinterpret_cast<page*>(pPage);
+
+        std::lock_guard<std::mutex> lock(pc.mutex);
+        if (discard) {
+            pc.discard(p);
+
+            return;
+        }
+        p->pinned = false;
+        --c->pinned;
+        if (c->purgeable) {
+            pc.push_front(p);
+            pc.evict(pc.budget);
+        }
+        else {
+            // never evicted
+            p->prev = p->next = nullptr;
+        }
+    }
+
+    void xRekey(sqlite3_pcache* pcache, sqlite3_pcache_page* pPage, unsigned oldKey, unsigned newKey)
+    {
+        cache* c = reinterpret_cast<cache*>(pcache);
+        page* p = reinterpret_cast<page*>(pPage);
+
+        std::lock_guard<std::mutex> lock(pc.mutex);
+        auto i = c->pages.find(newKey);
+        if (i != c->pages.end())
+            pc.discard(i->second);
+        c->pages.erase(oldKey);
+        p->key = newKey;
+        c->pages.emplace(newKey, p);
+    }
+
+    void xTruncate(sqlite3_pcache* pcache, unsigned iLimit)
+    {
+        cache* c = reinterpret_cast<cache*>(pcache);
+
+        std::lock_guard<std::mutex> lock(pc.mutex);
+        std::vector<page*> drop;
+        for (const auto& [key, p] : c->pages) {
+            if (key >= iLimit)
+                drop.push_back(p);
+        }
+        for (page* p : drop)
+            pc.discard(p);
+    }
+
+    void xDestroy(sqlite3_pcache* pcache)
+    {
+        cache* c = reinterpret_cast<cache*>(pcache);
+
+        std::lock_guard<std::mutex> lock(pc.mutex);
+        while (!c->pages.empty())
+            pc.discard(c->pages.begin()->second);
+        pc.caches.erase(c);
+    }
+
+    void xShrink(sqlite3_pcache* pcache)
+    {
+        cache* c = reinterpret_cast<cache*>(pcache);
+
+        std::lock_guard<std::mutex> lock(pc.mutex);
+        std::vector<page*> drop;
+        for (const auto& [key, p] : c->pages) {
+            if (!p->pinned && c->purgeable)
+                drop.push_back(p);
+        }
+        for (page* p : drop)
+            pc.discard(p);
+    }
+
+    void add(pcache_stats& s, const cache& c)
+    {
+        ++s.caches;
+        s.pages += c.pages.size();
+        s.pinned += c.pinned;
+        s.bytes += c.page_bytes() * static_cast<sqlite_int64>(c.pages.size());
+        s.hits += c.hits;
+        s.misses += c.misses;
+        s.evictions += c.evictions;
+    }
+
+    // Run a statement that reads the first page of schema.
+    void probe(open& db, const std::string& schema)
+    {
+        std::string sql = "SELECT 1 FROM \"" + schema + "\".sqlite_master LIMIT 1";
+        sqlite3_exec(db, sql.c_str(), nullptr, nullptr, nullptr);
+    }
+
+}
+
+int sqlite::pcache_install(sqlite_int64 budget)
+{
+    static const sqlite3_pcache_methods2 methods = {
+        1, nullptr, xInit, xShutdown, xCreate, xCachesize, xPagecount,
+        xFetch, xUnpin, xRekey, xTruncate, xDestroy, xShrink
+    };
+
+    int rc = sqlite3_config(SQLITE_CONFIG_PCACHE2, &methods);
+    if (rc == SQLITE_OK) {
+        std::lock_guard<std::mutex> lock(pc.mutex);
+        pc.installed = true;
+        pc.budget = budget;
+    }
+
+    return rc;
+}
+
+bool sqlite::pcache_installed()
+{
+    std::lock_guard<std::mutex> lock(pc.mutex);
+
+    return pc.installed;
+}
+
+void sqlite::pcache_budget(sqlite_int64 budget)
+{
+    std::lock_guard<std::mutex> lock(pc.mutex);
+    pc.budget = budget;
+    pc.evict(budget);
+}
+
+sqlite_int64 sqlite::pcache_budget()
+{
+    std::lock_guard<std::mutex> lock(pc.mutex);
+
+    return pc.budget;
+}
+
+pcache_stats sqlite::pcache_total()
+{
+    pcache_stats s;
+
+    std::lock_guard<std::mutex> lock(pc.mutex);
+    for (const auto& [p, c] : pc.caches)
+        add(s, *c);
+
+    return s;
+}
+
+std::vector<pcache_stats> sqlite::pcache_files()
+{
+    std::map<std::string, pcache_stats> files;
+
+    std::lock_guard<std::mutex> lock(pc.mutex);
+    for (const auto& [p, c] : pc.caches) {
+        pcache_stats& s = files[c->file];
+        s.file = c->file;
+        add(s, *c);
+    }
+
+    std::vector<pcache_stats> stats;
+    for (auto& [file, s] : files)
+        stats.push_back(std::move(s));
+
+    return stats;
+}
+
+std::vector<pcache_stats> sqlite::pcache_connection(open& db)
+{
+    std::vector<pcache_stats> stats;
+    if (!pcache_installed())
+        return stats;
+
+    // https://www.sqlite.org/pragma.html#pragma_database_list
+    std::vector<std::pair<std::string, std::string>> schemas;
+    {
+        open::stmt stmt(db);
+        if (SQLITE_OK != stmt.prepare("PRAGMA database_list"))
+            throw std::runtime_error(sqlite3_errmsg(db));
+        while (SQLITE_ROW == sqlite3_step(stmt)) {
+            auto text = [&stmt](int i) {
+                const char* s = reinterpret_cast<const char*>(sqlite3_column_text(stmt, i));
+                return std::string(s ? s : "");
+            };
+            schemas.emplace_back(text(1), text(2));
+        }
+    }
+
+    for (const auto& [schema, file] : schemas) {
+        // the first probe loads the schema of every database
+        probe(db, schema);
+        std::vector<cache*> caches;
+        probed = &caches;
+        probe(db, schema);
+        probed = nullptr;
+
+        pcache_stats s;
+        s.schema = schema;
+        s.file = file;
+        std::lock_guard<std::mutex> lock(pc.mutex);
+        for (cache* c : caches) {
+            // the cache may have been destroyed by the probe
+            if (pc.caches.count(c)) {
+                c->db = db;
+                c->schema = schema;
+                c->file = file;
+            }
+        }
+        for (const auto& [p, c] : pc.caches) {
+            if (c->db == db && c->schema == schema)
+                add(s, *c);
+        }
+        stats.push_back(std::move(s));
+    }
+
+    return stats;
+}
@@ -0,0 +1,49 @@
+// pcache.h - page cache shared by all connections under one memory budget
+#pragma once
+#include <string>
+#include <vector>
+#include "sqlite.h"
+
+namespace sqlite {
+
+    struct pcache_stats {
+        std::string file;       // database file, empty if temporary or not labeled yet
+        std::string schema;     // main, temp, or attached name for a connection
+        size_t caches = 0;
+        size_t pages = 0;
+        size_t pinned = 0;      // pages in use by their connection
+        sqlite_int64 bytes = 0; // page, extra, and header bytes
+        size_t hits = 0;
+        size_t misses = 0;      // pages created
+        size_t evictions = 0;   // pages recycled for any cache
+
+        double hit_rate() const
+        {
+            return hits + misses ? static_cast<double>(hits) / (hits + misses) : 0;
+        }
+    };
+
+    // https://www.sqlite.org/c3ref/pcache_methods2.html
+    // Replace the page cache of every connection with one that shares a
+    // memory budget. Unpinned pages of all connections are kept on one LRU
+    // list and the least recently used page is recycled when the budget is
+    // reached, so busy connections keep their pages while idle ones give
+    // theirs up. PRAGMA cache_size is ignored.
+    // Pages of temporary and in-memory databases count against the budget
+    // but are never evicted.
+    // Call before SQLite is initialized or it returns SQLITE_MISUSE.
+    int pcache_install(sqlite_int64 budget);
+    bool pcache_installed();
+    // Evicts unpinned pages until the cache fits.
+    void pcache_budget(sqlite_int64 budget);
+    sqlite_int64 pcache_budget();
+
+    // All caches.
+    pcache_stats pcache_total();
+    // Caches grouped by database file over all connections.
+    std::vector<pcache_stats> pcache_files();
+    // Each database of a connection. This labels the caches of the
+    // connection with their schema and file by reading their first page.
+    std::vector<pcache_stats> pcache_connection(open& db);
+
+}
@@ -0,0 +1,419 @@
+// percentile.cpp - percentile, median, and t-digest aggregate functions
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include "percentile.h"
+
+using namespace sqlite;
+
+namespace {
+
+    constexpr double pi = 3.14159265358979323846;
+
+    // Number of values percentile() keeps exactly before switching to a t-digest.
+    constexpr size_t exact_limit = 8192;
+
+    constexpr char version = 1;
+
+    // k1 scale function and its inverse
+    double k(double q, double delta)
+    {
+        return delta / (2 * pi) * std::asin(2 * q - 1);
+    }
+    double k_inv(double k, double delta)
+    {
+        if (k >= delta / 4)
+            return 1;
+
+        return (std::sin(k * 2 * pi / delta) + 1) / 2;
+    }
+
+    template<class T>
+    void put(std::string& s, T t)
+    {
+        s.append(reinterpret_cast<const char*>(&t), sizeof(T));
+    }
+    template<class T>
+    T get(const unsigned char*& p)
+    {
+        T t;
+        memcpy(&t, p, sizeof(T));
+        p += sizeof(T);
+
+        return t;
+    }
+
+}
+
+tdigest::tdigest(double compression)
+    : delta(compression), total(0), min_(INFINITY), max_(-INFINITY)
+{
+    if (!(10 <= delta && delta <= 10000))
+        throw std::invalid_argument("tdigest: compression must be between 10 and 10000");
+}
+
+void tdigest::add(double x, double w)
+{
+    if (std::isnan(x) || w <= 0)
+        return;
+
+    min_ = std::min(min_, x);
+    max_ = std::max(max_, x);
+    total += w;
+    buffer.push_back({ x, w });
+    if (buffer.size() >= 5 * delta)
+        compress();
+}
+
+void tdigest::merge(const tdigest& td)
+{
+    if (td.total == 0)
+        return;
+
+    min_ = std::min(min_, td.min_);
+    max_ = std::max(max_, td.max_);
+    total += td.total;
+    buffer.insert(buffer.end(), td.merged.begin(), td.merged.end());
+    buffer.insert(buffer.end(), td.buffer.begin(), td.buffer.end());
+    compress();
+}
+
+void tdigest::compress()
+{
+    if (buffer.empty())
+        return;
+
+    buffer.insert(buffer.end(), merged.begin(), merged.end());
+    std::sort(buffer.begin(), buffer.end(), [](const centroid& a, const centroid& b) {
+        return a.mean < b.mean;
+    });
+
+    merged.clear();
+    double so_far = 0; // weight to the left of cur
+    centroid cur = buffer[0];
+    double limit = total * k_inv(k(0, delta) + 1, delta);
+    for (size_t i = 1; i < buffer.size(); ++i) {
+        const centroid& c = buffer[i];
+        if (so_far + cur.weight + c.weight <= limit) {
+            cur.weight += c.weight;
+            cur.mean += (c.mean - cur.mean) * c.weight / cur.weight;
+        }
+        else {
+            so_far += cur.weight;
+            merged.push_back(cur);
+            limit = total * k_inv(k(so_far / total, delta) + 1, delta);
+            cur = c;
+        }
+    }
+    merged.push_back(cur);
+    buffer.clear();
+}
+
+// Interpolate between centroid centers, and between min/max and the outer centroids.
+double tdigest::quantile(double q)
+{
+    compress();
+
+    if (merged.empty())
+        return NAN;
+    if (q <= 0)
+        return min_;
+    if (q >= 1)
+        return max_;
+
+    double index = q * total;
+    const centroid& first = merged.front();
+    if (index < first.weight / 2) {
+        return min_ + (first.mean - min_) * index / (first.weight / 2);
+    }
+
+    double so_far = first.weight / 2; // weight to the left of the center of merged[i]
+    for (size_t i = 0; i + 1 < merged.size(); ++i) {
+        const centroid& a = merged[i];
+        const centroid& b = merged[i + 1];
+        double step = (a.weight + b.weight) / 2;
+        if (so_far + step > index) {
+            return a.mean + (b.mean - a.mean) * (index - so_far) / step;
+        }
+        so_far += step;
+    }
+
+    const centroid& last = merged.back();
+    double t = std::min(1., (index - so_far) / (last.weight / 2));
+
+    return last.mean + (max_ - last.mean) * t;
+}
+
+std::string tdigest::serialize()
+{
+    compress();
+
+    std::string s;
+    s.reserve(4 + 3 * sizeof(double) + sizeof(uint32_t) + merged.size() * sizeof(centroid));
+    s.append("TD", 2);
+    s.push_back(version);
+    s.push_back(0);
+    put(s, delta);
+    put(s, min_);
+    put(s, max_);
+    put(s, static_cast<uint32_t>(merged.size()));
+    for (const auto& c : merged) {
+        put(s, c.mean);
+        put(s, c.weight);
+    }
+
+    return s;
+}
+
+tdigest tdigest::deserialize(const void* blob, int n)
+{
+    constexpr int head = static_cast<int>(4 + 3 * sizeof(double) + sizeof(uint32_t));
+    const unsigned char* p = static_cast<const unsigned char*>(blob);
+    if (n < head || p[0] != 'T' || p[1] != 'D' || p[2] != version)
+        throw std::invalid_argument("tdigest: not a t-digest BLOB");
+    p += 4;
+
+    tdigest td(get<double>(p));
+    td.min_ = get<double>(p);
+    td.max_ = get<double>(p);
+    uint32_t m = get<uint32_t>(p);
+    if (static_cast<size_t>(n - head) != m * sizeof(centroid))
+        throw std::invalid_argument("tdigest: truncated t-digest BLOB");
+    td.merged.resize(m);
+    for (auto& c : td.merged) {
+        c.mean = get<double>(p);
+        c.weight = get<double>(p);
+        if (std::isnan(c.mean) || !(c.weight > 0 && std::isfinite(c.weight)))
+            throw std::invalid_argument("tdigest: invalid centroid in t-digest BLOB");
+        td.total += c.weight;
+    }
+
+    return td;
+}
+
+namespace {
+
+    // Exact percentiles for small inputs, t-digest beyond exact_limit values.
+    struct percentile_state {
+        double p = NAN;
+        std::vector<double> values;
+        std::unique_ptr<tdigest> td;
+
+        void add(double x)
+        {
+            if (td) {
+                td->add(x);
+            }
+            else if (values.size() < exact_limit) {
+                values.push_back(x);
+            }
+            else {
+                td = std::make_unique<tdigest>();
+                for (double v : values)
+                    td->add(v);
+                td->add(x);
+                std::vector<double>().swap(values);
+            }
+        }
+        // Linear interpolation between closest ranks, like Excel PERCENTILE.INC.
+        double result()
+        {
+            double q = p / 100;
+            if (td)
+                return td->quantile(q);
+
+            double ix = q * (values.size() - 1);
+            size_t i = static_cast<size_t>(ix);
+            auto vi = values.begin() + i;
+            std::nth_element(values.begin(), vi, values.end());
+            if (i + 1 == values.size() || ix == i)
+                return *vi;
+
+            double hi = *std::min_element(vi + 1, values.end());
+
+            return *vi + (hi - *vi) * (ix - i);
+        }
+    };
+
+    // Aggregate context holds a pointer to state allocated on the first step.
+    template<class T, class... Args>
+    T* state_init(sqlite3_context* ctx, Args&&... args)
+    {
+        T** pp = static_cast<T**>(sqlite3_aggregate_context(ctx, sizeof(T*)));
+        if (!pp)
+            throw std::bad_alloc();
+        if (!*pp)
+            *pp = new T(std::forward<Args>(args)...);
+
+        return *pp;
+    }
+    template<class T>
+    std::unique_ptr<T> state_final(sqlite3_context* ctx)
+    {
+        T** pp = static_cast<T**>(sqlite3_aggregate_context(ctx, 0));
+        std::unique_ptr<T> s(pp ? *pp : nullptr);
+        if (pp)
+            *pp = nullptr;
+
+        return s;
+    }
+
+    bool is_numeric(sqlite3_value* v)
+    {
+        int type = sqlite3_value_numeric_type(v);
+
+        return type == SQLITE_INTEGER || type == SQLITE_FLOAT;
+    }
+
+    void percentile_add(sqlite3_context* ctx, const char* name, sqlite3_value* x, double p)
+    {
+        percentile_state* s = state_init<percentile_state>(ctx);
+        if (std::isnan(s->p)) {
+            s->p = p;
+        }
+        else if (s->p != p) {
+            throw std::invalid_argument(std::string(name) + "(): percentile must be constant");
+        }
+
+        if (sqlite3_value_type(x) == SQLITE_NULL)
+            return;
+        if (!is_numeric(x))
+            throw std::invalid_argument(std::string(name) + "(): 1st argument is not numeric");
+
+        s->add(sqlite3_value_double(x));
+    }
+
+    void percentile_step(sqlite3_context* ctx, int, sqlite3_value** argv)
+    {
+        try {
+            double p = sqlite3_value_double(argv[1]);
+            if (!is_numeric(argv[1]) || p < 0 || p > 100)
+                throw std::invalid_argument("percentile(): 2nd argument must be a number between 0 and 100");
+
+            percentile_add(ctx, "percentile", argv[0], p);
+        }
+        catch (const std::bad_alloc&) {
+            sqlite3_result_error_nomem(ctx);
+        }
+        catch (const std::exception& ex) {
+            sqlite3_result_error(ctx, ex.what(), -1);
+        }
+    }
+
+    void median_step(sqlite3_context* ctx, int, sqlite3_value** argv)
+    {
+        try {
+            percentile_add(ctx, "median", argv[0], 50);
+        }
+        catch (const std::bad_alloc&) {
+            sqlite3_result_error_nomem(ctx);
+        }
+        catch (const std::exception& ex) {
+            sqlite3_result_error(ctx, ex.what(), -1);
+        }
+    }
+
+    void percentile_final(sqlite3_context* ctx)
+    {
+        auto s = state_final<percentile_state>(ctx);
+        if (s && (s->td || !s->values.empty()))
+            sqlite3_result_double(ctx, s->result());
+    }
+
+    void result_tdigest(sqlite3_context* ctx, tdigest& td)
+    {
+        std::string blob = td.serialize();
+        sqlite3_result_blob(ctx, blob.data(), static_cast<int>(blob.size()), SQLITE_TRANSIENT);
+    }
+
+    void tdigest_step(sqlite3_context* ctx, int argc, sqlite3_value** argv)
+    {
+        try {
+            double delta = argc > 1 ? sqlite3_value_double(argv[1]) : 100;
+            tdigest* td = state_init<tdigest>(ctx, delta);
+            if (sqlite3_value_type(argv[0]) == SQLITE_NULL)
+                return;
+            if (!is_numeric(argv[0]))
+                throw std::invalid_argument("tdigest(): 1st argument is not numeric");
+
+            td->add(sqlite3_value_double(argv[0]));
+        }
+        catch (const std::bad_alloc&) {
+            sqlite3_result_error_nomem(ctx);
+        }
+        catch (const std::exception& ex) {
+            sqlite3_result_error(ctx, ex.what(), -1);
+        }
+    }
+
+    void tdigest_merge_step(sqlite3_context* ctx, int, sqlite3_value** argv)
+    {
+        try {
+            if (sqlite3_value_type(argv[0]) == SQLITE_NULL)
+                return;
+
+            tdigest td = tdigest::deserialize(sqlite3_value_blob(argv[0]), sqlite3_value_bytes(argv[0]));
+            state_init<tdigest>(ctx, td.compression())->merge(td);
+        }
+        catch (const std::bad_alloc&) {
+            sqlite3_result_error_nomem(ctx);
+        }
+        catch (const std::exception& ex) {
+            sqlite3_result_error(ctx, ex.what(), -1);
+        }
+    }
+
+    void tdigest_final(sqlite3_context* ctx)
+    {
+        auto td = state_final<tdigest>(ctx);
+        if (td && td->count() > 0)
+            result_tdigest(ctx, *td);
+    }
+
+    void tdigest_percentile(sqlite3_context* ctx, int, sqlite3_value** argv)
+    {
+        try {
+            if (sqlite3_value_type(argv[0]) == SQLITE_NULL)
+                return;
+
+            double p = sqlite3_value_double(argv[1]);
+            if (!is_numeric(argv[1]) || p < 0 || p > 100)
+                throw std::invalid_argument("tdigest_percentile(): 2nd argument must be a number between 0 and 100");
+
+            tdigest td = tdigest::deserialize(sqlite3_value_blob(argv[0]), sqlite3_value_bytes(argv[0]));
+            if (td.count() > 0)
+                sqlite3_result_double(ctx, td.quantile(p / 100));
+        }
+        catch (const std::bad_alloc&) {
+            sqlite3_result_error_nomem(ctx);
+        }
+        catch (const std::exception& ex) {
+            sqlite3_result_error(ctx, ex.what(), -1);
+        }
+    }
+
+}
+
+int sqlite::percentile_init(sqlite3* db)
+{
+    constexpr int flags = SQLITE_UTF8 | SQLITE_DETERMINISTIC;
+    int rc = SQLITE_OK;
+
+    if (rc == SQLITE_OK)
+        rc = sqlite3_create_function(db, "percentile", 2, flags, 0, 0, percentile_step, percentile_final);
+    if (rc == SQLITE_OK)
+        rc = sqlite3_create_function(db, "median", 1, flags, 0, 0, median_step, percentile_final);
+    if (rc == SQLITE_OK)
+        rc = sqlite3_create_function(db, "tdigest", 1, flags, 0, 0, tdigest_step, tdigest_final);
+    if (rc == SQLITE_OK)
+        rc = sqlite3_create_function(db, "tdigest", 2, flags, 0, 0, tdigest_step, tdigest_final);
+    if (rc == SQLITE_OK)
+        rc = sqlite3_create_function(db, "tdigest_merge", 1, flags, 0, 0, tdigest_merge_step, tdigest_final);
+    if (rc == SQLITE_OK)
+        rc = sqlite3_create_function(db, "tdigest_percentile", 2, flags, 0, tdigest_percentile, 0, 0);
+
+    return rc;
+}
@@ -0,0 +1,57 @@
+// percentile.h - percentile, median, and t-digest aggregate functions
+#pragma once
+#include <string>
+#include <vector>
+#include "sqlite3.h"
+
+namespace sqlite {
+
+    // Merging t-digest for streaming quantile estimates in bounded memory.
+    // https://github.com/tdunning/t-digest/blob/main/docs/t-digest-paper/histo.pdf
+    class tdigest {
+    public:
+        struct centroid {
+            double mean;
+            double weight;
+        };
+    private:
+        double delta; // compression
+        double total; // sum of weights
+        double min_, max_;
+        std::vector<centroid> merged;
+        std::vector<centroid> buffer; // unmerged points
+        void compress();
+    public:
+        tdigest(double compression = 100);
+
+        void add(double x, double w = 1);
+        void merge(const tdigest& td);
+        // q in [0, 1]
+        double quantile(double q);
+        double count() const
+        {
+            return total;
+        }
+        double compression() const
+        {
+            return delta;
+        }
+        size_t size() const
+        {
+            return merged.size() + buffer.size();
+        }
+
+        // Little endian BLOB: "TD", version byte, padding byte,
+        // compression, min, max, number of centroids, {mean, weight}...
+        // Deserialize throws unless means are numbers and weights are positive.
+        std::string serialize();
+        static tdigest deserialize(const void* blob, int n);
+    };
+
+    // Register percentile(x, p), median(x), tdigest(x[, compression]),
+    // tdigest_merge(blob), and tdigest_percentile(blob, p) with db.
+    // tdigest_merge uses the compression of the first digest.
+    // Percentiles p are in [0, 100] as in the sqlite percentile extension.
+    int percentile_init(sqlite3* db);
+
+}
@@ -0,0 +1,268 @@
+// pool.cpp - size-class pool allocator for SQLite
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include "pool.h"
+
+using namespace sqlite;
+
+namespace {
+
+    // Every block starts with its usable size and SQLite needs 8 byte alignment.
+    constexpr size_t header = 8;
+
+    constexpr size_t sizes[] = {
+        16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048, 3072, 4096
+    };
+    constexpr int classes = sizeof(sizes) / sizeof(*sizes);
+    constexpr size_t largest = sizes[classes - 1];
+    constexpr size_t slab = 64 * 1024;
+    constexpr unsigned cache_max = 64; // blocks per class in a thread cache
+    constexpr unsigned refill = 32;    // blocks moved to or from the global list
+
+    // size class of (n + 15)/16 for n <= largest
+    struct class_table {
+        unsigned char index[largest / 16 + 1];
+
+        constexpr class_table()
+            : index{}
+        {
+            int c = 0;
+            for (size_t i = 0; i <= largest / 16; ++i) {
+                while (sizes[c] < i * 16)
+                    ++c;
+                index[i] = static_cast<unsigned char>(c);
+            }
+        }
+    };
+    constexpr class_table table;
+
+    inline int size_class(size_t n)
+    {
+        return table.index[(n + 15) / 16];
+    }
+
+    struct free_block {
+        free_block* next;
+    };
+
+    struct counters {
+        std::atomic<size_t> allocations{ 0 }, frees{ 0 }, reallocs{ 0 }, large{ 0 }, cached{ 0 };
+        std::atomic<sqlite_int64> used{ 0 }, peak{ 0 }, reserved{ 0 };
+        std::atomic<bool> installed{ false };
+
+        void add(sqlite_int64 n)
+        {
+            sqlite_int64 u = used.fetch_add(n, std::memory_order_relaxed) + n;
+            sqlite_int64 p = peak.load(std::memory_order_relaxed);
+            while (u > p && !peak.compare_exchange_weak(p, u, std::memory_order_relaxed))
+                ;
+        }
+    } stats;
+
+    // Blocks shared by all threads.
+    struct global_list {
+        std::mutex mutex;
+        free_block* head = nullptr;
+        char* next = nullptr; // uncarved part of the current slab
+        char* end = nullptr;
+    } global[classes];
+
+    // Move up to count blocks of class c to list and return how many.
+    unsigned take(int c, free_block*& list, unsigned count)
+    {
+        global_list& g = global[c];
+        const size_t block = header + sizes[c];
+        unsigned n = 0;
+
+        std::lock_guard<std::mutex> lock(g.mutex);
+        for (; n < count && g.head; ++n) {
+            free_block* b = g.head;
+            g.head = b->next;
+            b->next = list;
+            list = b;
+        }
+        for (; n < count; ++n) {
+            if (g.next + block > g.end) {
+                g.next = static_cast<char*>(std::malloc(slab));
+                if (!g.next) {
+                    g.end = nullptr;
+                    break;
+                }
+                g.end = g.next + slab - slab % block;
+                stats.reserved.fetch_add(slab, std::memory_order_relaxed);
+            }
+            free_block* b = reinterpret_cast<free_block*>(g.next);
+            g.next += block;
+            b->next = list;
+            list = b;
+        }
+
+        return n;
+    }
+
+    // Return count blocks from the front of list to the global list.
+    void give(int c, free_block*& list, unsigned count)
+    {
+        global_list& g = global[c];
+
+        std::lock_guard<std::mutex> lock(g.mutex);
+        for (unsigned n = 0; n < count && list; ++n) {
+            free_block* b = list;
+            list = b->next;
+            b->next = g.head;
+            g.head = b;
+        }
+    }
+
+    // Blocks are headers followed by usable memory and the free list
+    // links the headers.
+    struct thread_cache {
+        free_block* head[classes] = {};
+        unsigned count[classes] = {};
+
+        ~thread_cache()
+        {
+            for (int c = 0; c < classes; ++c)
+                give(c, head[c], count[c]);
+        }
+    };
+    thread_local thread_cache cache;
+
+    void* xMalloc(int n_)
+    {
+        size_t n = n_ > 0 ? static_cast<size_t>(n_) : 1;
+        char* p;
+
+        if (n > largest) {
+            // xSize reports the rounded size and SQLite may use all of it
+            n = (n + 7) & ~size_t(7);
+            p = static_cast<char*>(std::malloc(header + n));
+            if (!p)
+                return nullptr;
+            stats.large.fetch_add(1, std::memory_order_relaxed);
+        }
+        else {
+            int c = size_class(n);
+            n = sizes[c];
+            if (cache.head[c]) {
+                stats.cached.fetch_add(1, std::memory_order_relaxed);
+            }
+            else {
+                cache.count[c] += take(c, cache.head[c], refill);
+                if (!cache.head[c])
+                    return nullptr;
+            }
+            free_block* b = cache.head[c];
+            cache.head[c] = b->next;
+            --cache.count[c];
+            p = reinterpret_cast<char*>(b);
+        }
+        *reinterpret_cast<sqlite_uint64*>(p) = n;
+        stats.allocations.fetch_add(1, std::memory_order_relaxed);
+        stats.add(static_cast<sqlite_int64>(n));
+
+        return p + header;
+    }
+
+    int xSize(void* p)
+    {
+        return p ? static_cast<int>(*reinterpret_cast<sqlite_uint64*>(static_cast<char*>(p) - header)) : 0;
+    }
+
+    void xFree(void* p)
+    {
+        if (!p)
+            return;
+
+        char* b = static_cast<char*>(p) - header;
+        size_t n = static_cast<size_t>(*reinterpret_cast<sqlite_uint64*>(b));
+        stats.frees.fetch_add(1, std::memory_order_relaxed);
+        stats.used.fetch_sub(static_cast<sqlite_int64>(n), std::memory_order_relaxed);
+        if (n > largest) {
+            std::free(b);
+
+            return;
+        }
+
+        int c = size_class(n);
+        free_block* f = reinterpret_cast<free_block*>(b);
+        f->next = cache.head[c];
+        cache.head[c] = f;
+        if (++cache.count[c] > cache_max) {
+            give(c, cache.head[c], refill);
+            cache.count[c] -= refill;
+        }
+    }
+
+    int xRoundup(int n)
+    {
+        if (n <= 0)
+            return static_cast<int>(sizes[0]);
+        if (static_cast<size_t>(n) > largest)
+            return (n + 7) & ~7;
+
+        return static_cast<int>(sizes[size_class(n)]);
+    }
+
+    void* xRealloc(void* p, int n)
+    {
+        // same class, nothing to do
+        if (xRoundup(n) == xSize(p))
+            return p;
+
+        void* q = xMalloc(n);
+        if (q) {
+            std::memcpy(q, p, std::min(static_cast<size_t>(xSize(p)), static_cast<size_t>(n)));
+            xFree(p);
+            stats.reallocs.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        return q;
+    }
+
+    int xInit(void*)
+    {
+        return SQLITE_OK;
+    }
+
+    void xShutdown(void*)
+    { }
+
+}
+
+int sqlite::pool_install()
+{
+    static const sqlite3_mem_methods methods = {
+        xMalloc, xFree, xRealloc, xSize, xRoundup, xInit, xShutdown, nullptr
+    };
+
+    int rc = sqlite3_config(SQLITE_CONFIG_MALLOC, &methods);
+    if (rc == SQLITE_OK)
+        stats.installed = true;
+
+    return rc;
+}
+
+pool_stats sqlite::pool_status()
+{
+    pool_stats s;
+    s.installed = stats.installed;
+    s.allocations = stats.allocations;
+    s.frees = stats.frees;
+    s.reallocs = stats.reallocs;
+    s.large = stats.large;
+    s.cached = stats.cached;
+    s.used = stats.used;
+    s.peak = stats.peak;
+    s.reserved = stats.reserved;
+
+    return s;
+}
+
+void sqlite::pool_reset_peak()
+{
+    stats.peak = stats.used.load();
+}
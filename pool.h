@@ -0,0 +1,38 @@
+// pool.h - size-class pool allocator for SQLite and lookaside tuning
+#pragma once
+#include "sqlite.h"
+
+namespace sqlite {
+
+    struct pool_stats {
+        bool installed = false;
+        size_t allocations = 0;
+        size_t frees = 0;
+        size_t reallocs = 0;    // that moved the allocation
+        size_t large = 0;       // allocations bigger than the largest size class
+        size_t cached = 0;      // allocations served by a thread cache
+        sqlite_int64 used = 0;  // bytes in use rounded up to the size class
+        sqlite_int64 peak = 0;  // highest used since installed or reset
+        sqlite_int64 reserved = 0; // bytes of slabs taken from the system
+    };
+
+    // https://www.sqlite.org/c3ref/mem_methods.html
+    // Replace the SQLite allocator with size-class pools of 16 to 4096
+    // bytes. Each thread keeps a short free list per class so most calls
+    // take no lock. Slabs are never returned to the system.
+    // Call before SQLite is initialized, i.e. before the first connection
+    // is opened, or it returns SQLITE_MISUSE.
+    int pool_install();
+    pool_stats pool_status();
+    void pool_reset_peak();
+
+    // https://www.sqlite.org/c3ref/c_dbconfig_defensive.html#sqlitedbconfiglookaside
+    // Lookaside slots of size bytes for a connection. Call before
+    // the connection runs any statement.
+    inline void lookaside(open& db, int size, int count)
+    {
+        if (SQLITE_OK != sqlite3_db_config(db, SQLITE_DBCONFIG_LOOKASIDE, nullptr, size, count))
+            throw std::runtime_error("sqlite::lookaside: connection is using lookaside memory");
+    }
+
+}
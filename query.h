@@ -0,0 +1,198 @@
+// query.h - rows of a SELECT as typed tuples
+#pragma once
+#include <cstddef>
+#include <iterator>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "sqlite.h"
+
+namespace sqlite {
+
+    // Column i of the current row of pstmt as T.
+    // std::string_view and std::span<const std::byte> point into the statement
+    // and are valid until the next step. NULL is 0 or empty unless T is std::optional.
+    template<class T>
+    inline T column(sqlite3_stmt* pstmt, int i)
+    {
+        if constexpr (is_optional<T>::value) {
+            if (sqlite3_column_type(pstmt, i) == SQLITE_NULL)
+                return std::nullopt;
+
+            return column<typename T::value_type>(pstmt, i);
+        }
+        else if constexpr (std::is_same_v<T, bool>) {
+            return sqlite3_column_int(pstmt, i) != 0;
+        }
+        else if constexpr (std::is_integral_v<T> && sizeof(T) <= sizeof(int)) {
+            return static_cast<T>(sqlite3_column_int(pstmt, i));
+        }
+        else if constexpr (std::is_integral_v<T>) {
+            return static_cast<T>(sqlite3_column_int64(pstmt, i));
+        }
+        else if constexpr (std::is_floating_point_v<T>) {
+            return static_cast<T>(sqlite3_column_double(pstmt, i));
+        }
+        else if constexpr (std::is_same_v<T, std::string_view> || std::is_same_v<T, std::string>) {
+            // text before bytes so the length is of the UTF-8 conversion
+            const char* t = reinterpret_cast<const char*>(sqlite3_column_text(pstmt, i));
+
+            return T(t ? t : "", static_cast<size_t>(sqlite3_column_bytes(pstmt, i)));
+        }
+        else if constexpr (std::is_same_v<T, std::span<const std::byte>>) {
+            const std::byte* b = static_cast<const std::byte*>(sqlite3_column_blob(pstmt, i));
+
+            return T(b, static_cast<size_t>(sqlite3_column_bytes(pstmt, i)));
+        }
+        else {
+            static_assert(!sizeof(T), "sqlite::column: unsupported type");
+        }
+    }
+
+    // Rows of a SELECT as std::tuple<Ts...> decoded at compile time.
+    //   for (auto [id, x, name] : query<int64_t, double, std::string_view>(db, sql, 42))
+    // Iteration steps the statement in place and does not allocate. Text and
+    // blob views are valid until the next row. A query can be iterated once.
+    template<class... Ts>
+    class query {
+        sqlite3_stmt* pstmt;
+        bool owned;
+
+        template<size_t... I>
+        std::tuple<Ts...> row(std::index_sequence<I...>) const
+        {
+            return std::tuple<Ts...>(column<Ts>(pstmt, static_cast<int>(I))...);
+        }
+        void check()
+        {
+            if (sqlite3_column_count(pstmt) < static_cast<int>(sizeof...(Ts)))
+                throw std::runtime_error("sqlite::query: fewer columns than types");
+        }
+    public:
+        using value_type = std::tuple<Ts...>;
+
+        class iterator {
+            query* q;
+        public:
+            using iterator_category = std::input_iterator_tag;
+            using value_type = std::tuple<Ts...>;
+            using difference_type = std::ptrdiff_t;
+
+            explicit iterator(query* q = nullptr)
+                : q(q)
+            { }
+            value_type operator*() const
+            {
+                return q->row(std::index_sequence_for<Ts...>{});
+            }
+            iterator& operator++()
+            {
+                if (!q->step())
+                    q = nullptr;
+
+                return *this;
+            }
+            void operator++(int)
+            {
+                ++*this;
+            }
+            bool operator==(std::default_sentinel_t) const
+            {
+                return q == nullptr;
+            }
+        };
+
+        // Prepare sql on db and bind args to ?1, ?2, ...
+        template<class... Args>
+        query(sqlite3* db, std::string_view sql, const Args&... args)
+            : pstmt(nullptr), owned(true)
+        {
+            if (SQLITE_OK != sqlite3_prepare_v2(db, sql.data(), static_cast<int>(sql.size()), &pstmt, nullptr))
+                throw std::runtime_error(sqlite3_errmsg(db));
+            if (!pstmt)
+                throw std::runtime_error("sqlite::query: no statement in SQL");
+            try {
+                check();
+                bind(args...);
+            }
+            catch (...) {
+                sqlite3_finalize(pstmt);
+                throw;
+            }
+        }
+        template<class... Args>
+        query(open& db, std::string_view sql, const Args&... args)
+            : query(static_cast<sqlite3*>(db), sql, args...)
+        {
+            db.touch();
+        }
+        // Iterate rows of a statement prepared elsewhere, e.g. sqlite::cached.
+        // The statement is reset but not finalized.
+        explicit query(sqlite3_stmt* pstmt)
+            : pstmt(pstmt), owned(false)
+        {
+            sqlite3_reset(pstmt);
+            check();
+        }
+        query(const query&) = delete;
+        query& operator=(const query&) = delete;
+        ~query()
+        {
+            if (owned)
+                sqlite3_finalize(pstmt);
+            else
+                sqlite3_reset(pstmt);
+        }
+
+        // for use in sqlite3_* functions
+        operator sqlite3_stmt*()
+        {
+            return pstmt;
+        }
+
+        // Bind args to ?1, ?2, ... Text and blobs are copied so args may be temporaries.
+        template<class... Args>
+        query& bind(const Args&... args)
+        {
+            int col = 0;
+            int rc = SQLITE_OK;
+            ((rc == SQLITE_OK ? rc = bind_value(pstmt, ++col, args, SQLITE_TRANSIENT) : rc), ...);
+            if (rc != SQLITE_OK)
+                throw std::runtime_error(errmsg(pstmt));
+
+            return *this;
+        }
+
+        // Advance to the next row and return false when there are no more.
+        bool step()
+        {
+            int rc = sqlite3_step(pstmt);
+            if (rc == SQLITE_ROW)
+                return true;
+            if (rc != SQLITE_DONE)
+                throw std::runtime_error(errmsg(pstmt));
+
+            return false;
+        }
+        // Current row.
+        value_type get() const
+        {
+            return row(std::index_sequence_for<Ts...>{});
+        }
+
+        iterator begin()
+        {
+            return iterator(step() ? this : nullptr);
+        }
+        std::default_sentinel_t end() const
+        {
+            return std::default_sentinel;
+        }
+    };
+
+}
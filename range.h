@@ -0,0 +1,199 @@
+// range.h - rows of a statement as a two dimensional range
+// X is a row-major range such as xll::OPER with X(rows, columns), resize,
+// push_back of a row, and operator[] returning a cell. Cells are assigned or
+// constructed from double, int, and text. The benchmarks use the same code
+// with a stand-in for xll::OPER.
+#pragma once
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "sqlite.h"
+
+namespace sqlite {
+
+    // Maximum rows and string length of Excel 2007 and later.
+    constexpr size_t max_rows12 = 1048576;
+    constexpr int max_chars12 = 32767;
+
+    // Set cell o to column i of the current row.
+    template<class C>
+    inline void column_cell(sqlite3_stmt* stmt, int i, C& o, const C& null, const C& na)
+    {
+        switch (sqlite3_column_type(stmt, i)) {
+        case SQLITE_FLOAT:
+            o = sqlite3_column_double(stmt, i);
+            break;
+        case SQLITE_TEXT:
+            o = (const char*)sqlite3_column_text(stmt, i);
+            break;
+        case SQLITE_INTEGER:
+            o = sqlite3_column_int(stmt, i);
+            break;
+        case SQLITE_NULL:
+            o = null;
+            break;
+        default:
+            o = na;
+        }
+    }
+
+    // Rows of stmt with an optional header of column names.
+    // Each row is appended with push_back.
+    template<class X, class C>
+    inline X rows(sqlite3_stmt* stmt, bool header, const C& null, const C& na)
+    {
+        X o;
+
+        int rc = sqlite3_step(stmt);
+        if (rc != SQLITE_ROW && rc != SQLITE_DONE)
+            throw std::runtime_error(errmsg(stmt));
+
+        int n = sqlite3_column_count(stmt);
+        if (header) {
+            X head(1, n);
+            for (int i = 0; i < n; ++i) {
+                head[i] = sqlite3_column_name(stmt, i);
+            }
+            o.push_back(head);
+        }
+        while (SQLITE_ROW == rc) {
+            X row(1, n);
+            for (int i = 0; i < n; ++i) {
+                column_cell(stmt, i, row[i], null, na);
+            }
+            o.push_back(row);
+            rc = sqlite3_step(stmt);
+        }
+
+        return o;
+    }
+
+    // Execute stmt once for each of params rows after bind(stmt, i) binds row i.
+    // A query returns the rows of every execution stacked after a column with
+    // the parameter row number, starting at 1. Other statements return the
+    // number of rows changed by each execution.
+    // Statements that write run in a savepoint so either all rows are applied or none.
+    // Throws if the result has more than max_rows rows.
+    template<class X, class C, class B>
+    inline X exec_many(open& db, sqlite3_stmt* stmt, unsigned params, B bind, bool header,
+        const C& null, const C& na, size_t max_rows)
+    {
+        int n = sqlite3_column_count(stmt);
+        unsigned width = n ? n + 1 : 1;
+        bool write = !sqlite3_stmt_readonly(stmt);
+        std::vector<C> cells;
+        auto limit = [&cells, width, max_rows]() {
+            if (cells.size() >= max_rows * width)
+                throw std::runtime_error("sqlite::exec_many: result has more than " + std::to_string(max_rows) + " rows");
+        };
+
+        if (write)
+            exec(db, "SAVEPOINT exec_many");
+        try {
+            if (header) {
+                cells.emplace_back(n ? "row" : "changes");
+                for (int j = 0; j < n; ++j)
+                    cells.emplace_back(sqlite3_column_name(stmt, j));
+            }
+            for (unsigned i = 0; i < params; ++i) {
+                sqlite3_reset(stmt);
+                bind(stmt, i);
+                int rc;
+                while (SQLITE_ROW == (rc = sqlite3_step(stmt))) {
+                    limit();
+                    cells.emplace_back(i + 1.);
+                    for (int j = 0; j < n; ++j) {
+                        cells.emplace_back();
+                        column_cell(stmt, j, cells.back(), null, na);
+                    }
+                }
+                if (rc != SQLITE_DONE)
+                    throw std::runtime_error(errmsg(stmt));
+                if (!n) {
+                    limit();
+                    cells.emplace_back(static_cast<double>(sqlite3_changes(db)));
+                }
+            }
+        }
+        catch (...) {
+            sqlite3_reset(stmt);
+            // ignore errors so the original exception is reported
+            if (write)
+                sqlite3_exec(db, "ROLLBACK TO exec_many; RELEASE exec_many", nullptr, nullptr, nullptr);
+            throw;
+        }
+        sqlite3_reset(stmt);
+        if (write)
+            exec(db, "RELEASE exec_many");
+
+        X o;
+        if (!cells.empty()) {
+            o.resize(static_cast<unsigned>(cells.size() / width), width);
+            for (size_t k = 0; k < cells.size(); ++k)
+                o[static_cast<unsigned>(k)] = std::move(cells[k]);
+        }
+
+        return o;
+    }
+
+    // Rows of stmt with text read as UTF-16 into counted strings of Char.
+    // Cells are collected and moved into X once its size is known.
+    // Throws if there are more than max_rows12 rows and truncates text to max_chars12.
+    template<class X, class Char, class C>
+    inline X rows12(sqlite3_stmt* stmt, bool header, const C& null, const C& na)
+    {
+        static_assert(sizeof(Char) == 2, "sqlite::rows12: Char must be UTF-16");
+        int n = sqlite3_column_count(stmt);
+        std::vector<C> cells;
+
+        if (header) {
+            for (int i = 0; i < n; ++i) {
+                const Char* name = static_cast<const Char*>(sqlite3_column_name16(stmt, i));
+                cells.emplace_back(name, std::char_traits<Char>::length(name));
+            }
+        }
+
+        int rc;
+        while (SQLITE_ROW == (rc = sqlite3_step(stmt))) {
+            if (cells.size() >= max_rows12 * n)
+                throw std::runtime_error("sqlite_exec12: result has more than 1048576 rows");
+            for (int i = 0; i < n; ++i) {
+                switch (sqlite3_column_type(stmt, i)) {
+                case SQLITE_FLOAT:
+                    cells.emplace_back(sqlite3_column_double(stmt, i));
+                    break;
+                case SQLITE_INTEGER:
+                    cells.emplace_back(static_cast<double>(sqlite3_column_int64(stmt, i)));
+                    break;
+                case SQLITE_TEXT: {
+                    const Char* t = static_cast<const Char*>(sqlite3_column_text16(stmt, i));
+                    int len = sqlite3_column_bytes16(stmt, i) / static_cast<int>(sizeof(Char));
+                    cells.emplace_back(t, static_cast<size_t>(std::min(len, max_chars12)));
+                    break;
+                }
+                case SQLITE_NULL:
+                    cells.push_back(null);
+                    break;
+                default:
+                    cells.push_back(na);
+                }
+            }
+        }
+        if (rc != SQLITE_DONE)
+            throw std::runtime_error(errmsg(stmt));
+
+        X o;
+        if (n > 0 && !cells.empty()) {
+            o.resize(static_cast<unsigned>(cells.size() / n), n);
+            for (size_t i = 0; i < cells.size(); ++i) {
+                o[static_cast<unsigned>(i)] = std::move(cells[i]);
+            }
+        }
+
+        return o;
+    }
+
+}
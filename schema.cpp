@@ -0,0 +1,248 @@
+// schema.cpp - per-connection cache of schema metadata
+#include "schema.h"
+
+using namespace sqlite;
+
+namespace {
+
+    std::string text(sqlite3_stmt* pstmt, int i)
+    {
+        auto t = reinterpret_cast<const char*>(sqlite3_column_text(pstmt, i));
+
+        return t ? std::string(t, sqlite3_column_bytes(pstmt, i)) : std::string{};
+    }
+
+    // Prepared statement for one of the metadata queries.
+    class query {
+        sqlite3_stmt* pstmt = nullptr;
+    public:
+        query(sqlite3* db, const char* sql)
+        {
+            if (SQLITE_OK != sqlite3_prepare_v2(db, sql, -1, &pstmt, nullptr))
+                throw std::runtime_error(sqlite3_errmsg(db));
+        }
+        query(const query&) = delete;
+        query& operator=(const query&) = delete;
+        ~query()
+        {
+            sqlite3_finalize(pstmt);
+        }
+        void bind(int i, const std::string& t)
+        {
+            sqlite3_bind_text(pstmt, i, t.data(), static_cast<int>(t.size()), SQLITE_TRANSIENT);
+        }
+        bool step()
+        {
+            int rc = sqlite3_step(pstmt);
+            if (rc != SQLITE_ROW && rc != SQLITE_DONE)
+                throw std::runtime_error(errmsg(pstmt));
+
+            return rc == SQLITE_ROW;
+        }
+        operator sqlite3_stmt*()
+        {
+            return pstmt;
+        }
+    };
+
+    // Queries of one schema with its name bound to ?1 and put in place of SCHEMA.
+    // The table-valued pragma functions require 3.16.0.
+    constexpr const char* tables_sql =
+        "SELECT name, type FROM SCHEMA.sqlite_master WHERE type IN ('table', 'view')";
+    // one table at a time since a view of a dropped table fails
+    constexpr const char* columns_sql =
+        "SELECT cid, name, type, \"notnull\", dflt_value, pk FROM pragma_table_info(?2, ?1)";
+    constexpr const char* indexes_sql =
+        "SELECT m.name, l.name, l.\"unique\", l.origin, l.partial, i.name "
+        "FROM SCHEMA.sqlite_master m JOIN pragma_index_list(m.name, ?1) l JOIN pragma_index_xinfo(l.name, ?1) i "
+        "WHERE m.type = 'table' AND i.key ORDER BY m.name, l.name, i.seqno";
+    constexpr const char* foreign_keys_sql =
+        "SELECT m.name, f.id, f.\"table\", f.\"from\", f.\"to\", f.on_update, f.on_delete "
+        "FROM SCHEMA.sqlite_master m JOIN pragma_foreign_key_list(m.name, ?1) f "
+        "WHERE m.type = 'table' ORDER BY m.name, f.id, f.seq";
+
+    std::string in_schema(const char* sql, const std::string& schema)
+    {
+        std::string s(sql);
+        size_t i = s.find("SCHEMA");
+        if (i != std::string::npos)
+            s.replace(i, 6, quote_identifier(schema));
+
+        return s;
+    }
+
+}
+
+bool schema_cache::nocase::operator()(std::string_view a, std::string_view b) const
+{
+    size_t n = a.size() < b.size() ? a.size() : b.size();
+    int cmp = sqlite3_strnicmp(a.data(), b.data(), static_cast<int>(n));
+
+    return cmp < 0 || (cmp == 0 && a.size() < b.size());
+}
+
+const column_info* table_info::column(std::string_view name_) const
+{
+    for (const auto& c : columns) {
+        if (c.name.size() == name_.size() && 0 == sqlite3_strnicmp(c.name.data(), name_.data(), static_cast<int>(name_.size())))
+            return &c;
+    }
+
+    return nullptr;
+}
+
+std::string table_info::qualified_name() const
+{
+    return sqlite3_stricmp(schema.c_str(), "main") ? schema + "." + name : name;
+}
+
+void schema_cache::load(open& db, const std::string& schema)
+{
+    std::vector<table_info*> loaded;
+    query tables(db, in_schema(tables_sql, schema).c_str());
+    while (tables.step()) {
+        table_info t;
+        t.schema = schema;
+        t.name = text(tables, 0);
+        t.type = text(tables, 1);
+        std::string name = t.qualified_name();
+        loaded.push_back(&tables_.emplace(std::move(name), std::move(t)).first->second);
+    }
+
+    query columns(db, columns_sql);
+    columns.bind(1, schema);
+    for (table_info* t : loaded) {
+        columns.bind(2, t->name);
+        int rc;
+        while (SQLITE_ROW == (rc = sqlite3_step(columns))) {
+            column_info c;
+            c.cid = sqlite3_column_int(columns, 0);
+            c.name = text(columns, 1);
+            c.type = text(columns, 2);
+            c.notnull = sqlite3_column_int(columns, 3) != 0;
+            c.has_default = sqlite3_column_type(columns, 4) != SQLITE_NULL;
+            c.dflt_value = text(columns, 4);
+            c.pk = sqlite3_column_int(columns, 5);
+            t->columns.push_back(std::move(c));
+        }
+        if (rc != SQLITE_DONE) {
+            t->error = errmsg(columns);
+            t->columns.clear();
+        }
+        sqlite3_reset(columns);
+    }
+
+    // rows are ordered by table so look each table up once
+    table_info* pt = nullptr;
+    std::string prefix = sqlite3_stricmp(schema.c_str(), "main") ? schema + "." : "";
+    auto find = [this, &pt, &prefix](sqlite3_stmt* pstmt) {
+        auto name = reinterpret_cast<const char*>(sqlite3_column_text(pstmt, 0));
+        if (!pt || pt->name != name) {
+            auto i = tables_.find(prefix + name);
+            pt = i == tables_.end() ? nullptr : &i->second;
+        }
+
+        return pt;
+    };
+
+    query indexes(db, in_schema(indexes_sql, schema).c_str());
+    indexes.bind(1, schema);
+    while (indexes.step()) {
+        if (table_info* t = find(indexes)) {
+            std::string name = text(indexes, 1);
+            if (t->indexes.empty() || t->indexes.back().name != name) {
+                index_info i;
+                i.name = std::move(name);
+                i.unique = sqlite3_column_int(indexes, 2) != 0;
+                i.origin = text(indexes, 3);
+                i.partial = sqlite3_column_int(indexes, 4) != 0;
+                t->indexes.push_back(std::move(i));
+            }
+            t->indexes.back().columns.push_back(text(indexes, 5));
+        }
+    }
+
+    pt = nullptr;
+    query foreign_keys(db, in_schema(foreign_keys_sql, schema).c_str());
+    foreign_keys.bind(1, schema);
+    while (foreign_keys.step()) {
+        if (table_info* t = find(foreign_keys)) {
+            int id = sqlite3_column_int(foreign_keys, 1);
+            if (t->foreign_keys.empty() || t->foreign_keys.back().id != id) {
+                foreign_key f;
+                f.id = id;
+                f.table = text(foreign_keys, 2);
+                f.on_update = text(foreign_keys, 5);
+                f.on_delete = text(foreign_keys, 6);
+                t->foreign_keys.push_back(std::move(f));
+            }
+            t->foreign_keys.back().from.push_back(text(foreign_keys, 3));
+            t->foreign_keys.back().to.push_back(text(foreign_keys, 4));
+        }
+    }
+}
+
+void schema_cache::refresh(open& db)
+{
+    // ATTACH and DETACH change the list but no schema_version
+    std::vector<std::pair<std::string, int>> v;
+    {
+        cached list(db, "SELECT name FROM pragma_database_list ORDER BY name <> 'temp', seq");
+        int rc;
+        while (SQLITE_ROW == (rc = sqlite3_step(list)))
+            v.emplace_back(text(list, 0), 0);
+        if (rc != SQLITE_DONE)
+            throw std::runtime_error(errmsg(list));
+    }
+    for (auto& [schema, version] : v) {
+        cached stmt(db, "PRAGMA " + quote_identifier(schema) + ".schema_version");
+        if (SQLITE_ROW != sqlite3_step(stmt))
+            throw std::runtime_error(errmsg(stmt));
+        version = sqlite3_column_int(stmt, 0);
+    }
+
+    if (v != versions) {
+        versions.clear();
+        tables_.clear();
+        for (const auto& s : v)
+            load(db, s.first);
+        versions = std::move(v);
+        ++loads;
+    }
+}
+
+const table_info* schema_cache::table(open& db, std::string_view name)
+{
+    refresh(db);
+    if (name.find('.') == std::string_view::npos) {
+        for (const auto& s : versions) {
+            auto i = tables_.find(sqlite3_stricmp(s.first.c_str(), "main") ? s.first + "." + std::string(name) : std::string(name));
+            if (i != tables_.end())
+                return &i->second;
+        }
+
+        return nullptr;
+    }
+    // main is not part of the key
+    if (name.size() > 5 && 0 == sqlite3_strnicmp(name.data(), "main.", 5))
+        name.remove_prefix(5);
+    auto i = tables_.find(name);
+
+    return i == tables_.end() ? nullptr : &i->second;
+}
+
+std::map<std::string, sqlite_int64, std::less<>> sqlite::object_bytes(open& db)
+{
+    std::map<std::string, sqlite_int64, std::less<>> bytes;
+
+    // https://www.sqlite.org/dbstat.html
+    sqlite3_stmt* pstmt = nullptr;
+    if (SQLITE_OK != sqlite3_prepare_v2(db, "SELECT name, sum(pgsize) FROM dbstat GROUP BY name", -1, &pstmt, nullptr))
+        return bytes;
+
+    while (SQLITE_ROW == sqlite3_step(pstmt))
+        bytes.emplace(text(pstmt, 0), sqlite3_column_int64(pstmt, 1));
+    sqlite3_finalize(pstmt);
+
+    return bytes;
+}
@@ -0,0 +1,104 @@
+// schema.h - per-connection cache of schema metadata
+#pragma once
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "sqlite.h"
+
+namespace sqlite {
+
+    // https://www.sqlite.org/pragma.html#pragma_table_info
+    struct column_info {
+        int cid;
+        std::string name;
+        std::string type;       // declared type
+        bool notnull;
+        std::string dflt_value; // SQL text of the default or empty
+        bool has_default;
+        int pk;                 // 1-based position in the primary key or 0
+    };
+
+    // https://www.sqlite.org/pragma.html#pragma_index_list
+    struct index_info {
+        std::string name;
+        bool unique;
+        std::string origin;     // c, u or pk
+        bool partial;
+        std::vector<std::string> columns; // empty name for expressions
+    };
+
+    // https://www.sqlite.org/pragma.html#pragma_foreign_key_list
+    struct foreign_key {
+        int id;
+        std::string table;      // parent table
+        std::vector<std::string> from;
+        std::vector<std::string> to; // empty names refer to the parent primary key
+        std::string on_update;
+        std::string on_delete;
+    };
+
+    struct table_info {
+        std::string schema;     // main, temp, or the name of an attached database
+        std::string name;
+        std::string type;       // table or view
+        std::string error;      // why columns could not be read, e.g. a view of a dropped table
+        std::vector<column_info> columns;
+        std::vector<index_info> indexes;
+        std::vector<foreign_key> foreign_keys;
+
+        const column_info* column(std::string_view name) const;
+        // name qualified by schema unless it is main
+        std::string qualified_name() const;
+    };
+
+    // Tables, columns, indexes and foreign keys of the main, temp, and attached schemas.
+    // Everything is loaded in a few queries per schema when the list of schemas
+    // or the PRAGMA schema_version of one changes, so lookups only cost one
+    // pragma step per schema.
+    class schema_cache {
+        struct nocase {
+            using is_transparent = void;
+            bool operator()(std::string_view a, std::string_view b) const;
+        };
+        // schema names with temp first, as unqualified names resolve, and their versions
+        std::vector<std::pair<std::string, int>> versions;
+        std::map<std::string, table_info, nocase> tables_;
+        void load(open& db, const std::string& schema);
+    public:
+        size_t loads = 0;
+
+        // Reload if the schema changed.
+        void refresh(open& db);
+        void clear()
+        {
+            versions.clear();
+            tables_.clear();
+        }
+
+        // Table or view named name or nullptr if it does not exist.
+        // Unqualified names are found in temp, main, then attached schemas.
+        const table_info* table(open& db, std::string_view name);
+        // All tables and views ordered by qualified name.
+        const std::map<std::string, table_info, nocase>& tables(open& db)
+        {
+            refresh(db);
+
+            return tables_;
+        }
+    };
+
+    // Bytes used by each table and index from one scan of the dbstat virtual table.
+    // Empty if the library was built without SQLITE_ENABLE_DBSTAT_VTAB.
+    std::map<std::string, sqlite_int64, std::less<>> object_bytes(open& db);
+
+    // Schema cache of a connection.
+    inline schema_cache& schema(open& db)
+    {
+        if (!db.schema)
+            db.schema = std::make_shared<schema_cache>();
+
+        return *db.schema;
+    }
+
+}
@@ -0,0 +1,803 @@
+// sqlite.h - portable sqlite3 wrapper
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <memory>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+#include <vector>
+#include "sqlite3.h"
+
+namespace sqlite {
+
+    enum class Type {
+        Integer = SQLITE_INTEGER,
+        Float = SQLITE_FLOAT,
+        Text = SQLITE_TEXT,
+        Blob = SQLITE_BLOB,
+        Null = SQLITE_NULL,
+    };
+
+    // Bump allocator for text and blobs referenced by values.
+    // Memory is released all at once by clear or the destructor.
+    class arena {
+        std::vector<std::unique_ptr<char[]>> blocks;
+        size_t block_size, used, total;
+    public:
+        arena(size_t block_size = 64 * 1024)
+            : block_size(block_size), used(block_size), total(0)
+        { }
+        arena(const arena&) = delete;
+        arena& operator=(const arena&) = delete;
+        arena(arena&&) = default;
+        arena& operator=(arena&&) = default;
+
+        // Copy n bytes into the arena.
+        const char* copy(const void* p, size_t n)
+        {
+            char* q;
+            if (n > block_size / 4) {
+                // large items get their own block before the current one
+                auto pos = blocks.empty() ? blocks.end() : blocks.end() - 1;
+                q = blocks.emplace(pos, new char[n])->get();
+            }
+            else {
+                if (used + n > block_size) {
+                    blocks.emplace_back(new char[block_size]);
+                    used = 0;
+                }
+                q = blocks.back().get() + used;
+                used += n;
+            }
+            if (n)
+                memcpy(q, p, n);
+            total += n;
+
+            return q;
+        }
+        // Bytes copied into the arena.
+        size_t bytes() const
+        {
+            return total;
+        }
+        void clear()
+        {
+            blocks.clear();
+            used = block_size;
+            total = 0;
+        }
+    };
+
+    // Sqlite value in 16 bytes that never allocates.
+    // Text and blobs up to 14 bytes are stored inline. Longer ones refer to
+    // memory owned by the caller or copied into an arena, so copies are
+    // memcpy and the referenced memory must outlive the value.
+    // The length of text or blobs is at most max_size.
+    class value {
+        static constexpr unsigned char ref = 0xFF; // len of text or blob not stored inline
+        alignas(8) char buf[14];
+        unsigned char len;
+        unsigned char type_;
+
+        static size_t checked(size_t n)
+        {
+            if (n > max_size)
+                throw std::runtime_error("sqlite::value: text or blob longer than 4 GiB");
+
+            return n;
+        }
+        value(int type, const void* p, size_t n)
+            : len(0), type_(static_cast<unsigned char>(type))
+        {
+            checked(n);
+            if (n <= sizeof(buf)) {
+                if (n)
+                    memcpy(buf, p, n);
+                len = static_cast<unsigned char>(n);
+            }
+            else {
+                uint32_t n_ = static_cast<uint32_t>(n);
+                memcpy(buf, &p, sizeof(p));
+                memcpy(buf + sizeof(p), &n_, sizeof(n_));
+                len = ref;
+            }
+        }
+        value(int type, const void* p, size_t n, arena& a)
+            : value(type, n <= sizeof(buf) ? p : a.copy(p, checked(n)), n)
+        { }
+    public:
+        // maximum length of inline text or blob
+        static constexpr size_t inline_size = sizeof(buf);
+        // maximum length of text or blob since it is stored in 32 bits
+        static constexpr size_t max_size = UINT32_MAX;
+
+        value()
+            : len(0), type_(SQLITE_NULL)
+        { }
+        value(std::nullptr_t)
+            : value()
+        { }
+        template<class I, std::enable_if_t<std::is_integral_v<I>, int> = 0>
+        value(I i)
+            : len(0), type_(SQLITE_INTEGER)
+        {
+            sqlite_int64 i_ = static_cast<sqlite_int64>(i);
+            memcpy(buf, &i_, sizeof(i_));
+        }
+        value(double d)
+            : len(0), type_(SQLITE_FLOAT)
+        {
+            memcpy(buf, &d, sizeof(d));
+        }
+        // Copy long text into a.
+        value(std::string_view t, arena& a)
+            : value(SQLITE_TEXT, t.data(), t.size(), a)
+        { }
+        // Text that refers to t if it is not stored inline.
+        static value text(std::string_view t)
+        {
+            return value(SQLITE_TEXT, t.data(), t.size());
+        }
+        // Blob that refers to p if it is not stored inline.
+        static value blob(const void* p, size_t n)
+        {
+            return value(SQLITE_BLOB, p, n);
+        }
+        static value blob(const void* p, size_t n, arena& a)
+        {
+            return value(SQLITE_BLOB, p, n, a);
+        }
+        // Copy of v with long text or blobs copied into a.
+        value(sqlite3_value* v, arena& a)
+            : value()
+        {
+            switch (sqlite3_value_type(v)) {
+            case SQLITE_INTEGER:
+                *this = value(sqlite3_value_int64(v));
+                break;
+            case SQLITE_FLOAT:
+                *this = value(sqlite3_value_double(v));
+                break;
+            case SQLITE_TEXT: {
+                const unsigned char* t = sqlite3_value_text(v);
+                *this = value(SQLITE_TEXT, t, static_cast<size_t>(sqlite3_value_bytes(v)), a);
+                break;
+            }
+            case SQLITE_BLOB: {
+                const void* b = sqlite3_value_blob(v);
+                *this = value(SQLITE_BLOB, b, static_cast<size_t>(sqlite3_value_bytes(v)), a);
+                break;
+            }
+            }
+        }
+        // Column i of the current row of pstmt with long text or blobs copied into a.
+        static value column(sqlite3_stmt* pstmt, int i, arena& a)
+        {
+            switch (sqlite3_column_type(pstmt, i)) {
+            case SQLITE_INTEGER:
+                return value(sqlite3_column_int64(pstmt, i));
+            case SQLITE_FLOAT:
+                return value(sqlite3_column_double(pstmt, i));
+            case SQLITE_TEXT: {
+                const unsigned char* t = sqlite3_column_text(pstmt, i);
+                return value(SQLITE_TEXT, t, static_cast<size_t>(sqlite3_column_bytes(pstmt, i)), a);
+            }
+            case SQLITE_BLOB: {
+                const void* b = sqlite3_column_blob(pstmt, i);
+                return value(SQLITE_BLOB, b, static_cast<size_t>(sqlite3_column_bytes(pstmt, i)), a);
+            }
+            }
+
+            return value();
+        }
+
+        int type() const
+        {
+            return type_;
+        }
+        int bytes() const
+        {
+            return static_cast<int>(size());
+        }
+        // Bytes of text or blob.
+        size_t size() const
+        {
+            if (type_ != SQLITE_TEXT && type_ != SQLITE_BLOB)
+                return 0;
+            if (len != ref)
+                return len;
+            uint32_t n;
+            memcpy(&n, buf + sizeof(const char*), sizeof(n));
+
+            return n;
+        }
+        const char* data() const
+        {
+            if (len != ref)
+                return buf;
+            const char* p;
+            memcpy(&p, buf, sizeof(p));
+
+            return p;
+        }
+        // Whether text or blob bytes are stored in the value itself
+        // rather than in an arena, so data() moves with the value.
+        bool is_inline() const
+        {
+            return len != ref;
+        }
+
+        sqlite_int64 as_int64() const
+        {
+            sqlite_int64 i = 0;
+            if (type_ == SQLITE_INTEGER)
+                memcpy(&i, buf, sizeof(i));
+            else if (type_ == SQLITE_FLOAT)
+                i = static_cast<sqlite_int64>(as_double());
+
+            return i;
+        }
+        double as_double() const
+        {
+            double d = 0;
+            if (type_ == SQLITE_FLOAT)
+                memcpy(&d, buf, sizeof(d));
+            else if (type_ == SQLITE_INTEGER)
+                d = static_cast<double>(as_int64());
+
+            return d;
+        }
+        // Text or blob bytes.
+        std::string_view as_text() const
+        {
+            return std::string_view(data(), size());
+        }
+
+        bool operator==(const value& v) const
+        {
+            if (type_ != v.type_)
+                return false;
+            if (type_ == SQLITE_TEXT || type_ == SQLITE_BLOB)
+                return as_text() == v.as_text();
+            if (type_ == SQLITE_NULL)
+                return true;
+
+            return memcmp(buf, v.buf, 8) == 0;
+        }
+
+        // Set the result of a function. Text and blobs are copied.
+        void result(sqlite3_context* ctx) const
+        {
+            switch (type_) {
+            case SQLITE_INTEGER:
+                return sqlite3_result_int64(ctx, as_int64());
+            case SQLITE_FLOAT:
+                return sqlite3_result_double(ctx, as_double());
+            case SQLITE_TEXT:
+                return sqlite3_result_text64(ctx, data(), size(), SQLITE_TRANSIENT, SQLITE_UTF8);
+            case SQLITE_BLOB:
+                return sqlite3_result_blob64(ctx, data(), size(), SQLITE_TRANSIENT);
+            }
+            sqlite3_result_null(ctx);
+        }
+    };
+    static_assert(sizeof(value) == 16);
+
+    // Value bound to a ? placeholder.
+    using param = std::variant<std::monostate, sqlite_int64, double, std::string>;
+
+    // Bind p to parameter col of pstmt without copying text.
+    inline int bind(sqlite3_stmt* pstmt, int col, const param& p)
+    {
+        switch (p.index()) {
+        case 1:
+            return sqlite3_bind_int64(pstmt, col, std::get<1>(p));
+        case 2:
+            return sqlite3_bind_double(pstmt, col, std::get<2>(p));
+        case 3: {
+            const std::string& t = std::get<3>(p);
+            return sqlite3_bind_text(pstmt, col, t.data(), static_cast<int>(t.size()), SQLITE_STATIC);
+        }
+        }
+
+        return sqlite3_bind_null(pstmt, col);
+    }
+
+    // Bind v to parameter col of pstmt. Short payloads stored in v are copied
+    // so v may be a temporary. Longer ones are not copied and the arena
+    // or buffer holding them must outlive the step.
+    inline int bind(sqlite3_stmt* pstmt, int col, const value& v)
+    {
+        auto del = v.is_inline() ? SQLITE_TRANSIENT : SQLITE_STATIC;
+        switch (v.type()) {
+        case SQLITE_INTEGER:
+            return sqlite3_bind_int64(pstmt, col, v.as_int64());
+        case SQLITE_FLOAT:
+            return sqlite3_bind_double(pstmt, col, v.as_double());
+        case SQLITE_TEXT:
+            return sqlite3_bind_text64(pstmt, col, v.data(), v.size(), del, SQLITE_UTF8);
+        case SQLITE_BLOB:
+            return sqlite3_bind_blob64(pstmt, col, v.data(), v.size(), del);
+        }
+
+        return sqlite3_bind_null(pstmt, col);
+    }
+
+    template<class T>
+    struct is_optional : std::false_type { };
+    template<class T>
+    struct is_optional<std::optional<T>> : std::true_type { };
+
+    // Bind a C++ value to parameter col. Text and blobs are not copied
+    // unless del is SQLITE_TRANSIENT or they are stored inline in a value.
+    template<class T>
+    inline int bind_value(sqlite3_stmt* pstmt, int col, const T& t, sqlite3_destructor_type del = SQLITE_STATIC)
+    {
+        if constexpr (is_optional<T>::value) {
+            return t ? bind_value(pstmt, col, *t, del) : sqlite3_bind_null(pstmt, col);
+        }
+        else if constexpr (std::is_same_v<T, std::nullptr_t>) {
+            return sqlite3_bind_null(pstmt, col);
+        }
+        else if constexpr (std::is_same_v<T, param>) {
+            if (const std::string* s = std::get_if<std::string>(&t))
+                return sqlite3_bind_text64(pstmt, col, s->data(), s->size(), del, SQLITE_UTF8);
+
+            return bind(pstmt, col, t);
+        }
+        else if constexpr (std::is_same_v<T, value>) {
+            // inline payloads live in t, which may be a temporary
+            if (t.is_inline())
+                del = SQLITE_TRANSIENT;
+            if (t.type() == SQLITE_TEXT)
+                return sqlite3_bind_text64(pstmt, col, t.data(), t.size(), del, SQLITE_UTF8);
+            if (t.type() == SQLITE_BLOB)
+                return sqlite3_bind_blob64(pstmt, col, t.data(), t.size(), del);
+
+            return bind(pstmt, col, t);
+        }
+        else if constexpr (std::is_integral_v<T> && sizeof(T) <= sizeof(int)) {
+            return sqlite3_bind_int(pstmt, col, static_cast<int>(t));
+        }
+        else if constexpr (std::is_integral_v<T>) {
+            return sqlite3_bind_int64(pstmt, col, static_cast<sqlite_int64>(t));
+        }
+        else if constexpr (std::is_floating_point_v<T>) {
+            return sqlite3_bind_double(pstmt, col, static_cast<double>(t));
+        }
+        else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+            std::string_view s(t);
+
+            return sqlite3_bind_text64(pstmt, col, s.data(), s.size(), del, SQLITE_UTF8);
+        }
+        else if constexpr (std::is_same_v<T, std::span<const std::byte>>) {
+            return sqlite3_bind_blob64(pstmt, col, t.data(), t.size(), del);
+        }
+        else {
+            static_assert(!sizeof(T), "sqlite::bind_value: unsupported type");
+        }
+    }
+
+    inline const char* errmsg(sqlite3_stmt* pstmt)
+    {
+        return sqlite3_errmsg(sqlite3_db_handle(pstmt));
+    }
+
+    // Prepared statements of a connection keyed by SQL.
+    // Statements are taken out of the cache while in use and put back after a reset.
+    class stmt_cache {
+        using entry = std::pair<std::string, sqlite3_stmt*>;
+        std::list<entry> lru; // most recently used first
+        std::unordered_map<std::string_view, std::list<entry>::iterator> index;
+        size_t capacity;
+    public:
+        size_t hits = 0, misses = 0;
+
+        stmt_cache(size_t capacity = 64)
+            : capacity(capacity)
+        { }
+        stmt_cache(const stmt_cache&) = delete;
+        stmt_cache& operator=(const stmt_cache&) = delete;
+        ~stmt_cache()
+        {
+            clear();
+        }
+
+        size_t size() const
+        {
+            return lru.size();
+        }
+        // Heap memory used by the cached statements.
+        sqlite_int64 bytes() const
+        {
+            sqlite_int64 n = 0;
+            for (const auto& e : lru)
+                n += sqlite3_stmt_status(e.second, SQLITE_STMTSTATUS_MEMUSED, 0);
+
+            return n;
+        }
+
+        // Remove and return the statement for sql or nullptr if not cached.
+        sqlite3_stmt* take(std::string_view sql)
+        {
+            auto i = index.find(sql);
+            if (i == index.end()) {
+                ++misses;
+
+                return nullptr;
+            }
+            ++hits;
+            sqlite3_stmt* pstmt = i->second->second;
+            auto e = i->second;
+            index.erase(i);
+            lru.erase(e);
+
+            return pstmt;
+        }
+
+        // Reset pstmt and make it available for sql.
+        void put(std::string sql, sqlite3_stmt* pstmt)
+        {
+            sqlite3_reset(pstmt);
+            sqlite3_clear_bindings(pstmt);
+            if (capacity == 0 || index.count(sql)) {
+                sqlite3_finalize(pstmt);
+
+                return;
+            }
+
+            lru.emplace_front(std::move(sql), pstmt);
+            index.emplace(lru.front().first, lru.begin());
+            if (lru.size() > capacity) {
+                index.erase(lru.back().first);
+                sqlite3_finalize(lru.back().second);
+                lru.pop_back();
+            }
+        }
+
+        // Finalize all statements.
+        void clear()
+        {
+            index.clear();
+            for (auto& e : lru)
+                sqlite3_finalize(e.second);
+            lru.clear();
+        }
+    };
+
+    class schema_cache;
+    class index_advisor;
+    class maintenance_scheduler;
+    class write_queue;
+    class transaction;
+
+    // Sqlite converts wide strings to UTF-8 so we avoid *16* functions.
+    class open {
+        sqlite3* pdb;
+    public:
+        stmt_cache cache;
+        std::shared_ptr<schema_cache> schema; // see schema.h
+        std::shared_ptr<index_advisor> advisor; // see advisor.h
+        std::shared_ptr<maintenance_scheduler> maintenance; // see maintenance.h
+        std::shared_ptr<write_queue> writer; // see writer.h
+        // Transaction object that owns the open transaction, if any.
+        // Transactions hold a weak_ptr so they know when the connection is gone.
+        std::shared_ptr<transaction*> owner = std::make_shared<transaction*>(nullptr); // see transaction.h
+        std::atomic<size_t> activity{ 0 }; // statements started
+
+        open(const char* file, int flags = SQLITE_OPEN_READONLY)
+        {
+            if (SQLITE_OK != sqlite3_open_v2(file, &pdb, flags, 0))
+                throw std::runtime_error(sqlite3_errmsg(pdb));
+        }
+        open(const open&) = delete;
+        open& operator=(const open&) = delete;
+        ~open()
+        {
+            writer.reset();
+            maintenance.reset();
+            cache.clear();
+            sqlite3_close(pdb);
+        }
+        // Record use of the connection for idle detection.
+        void touch()
+        {
+            activity.fetch_add(1, std::memory_order_relaxed);
+        }
+        // for use in sqlite3_* functions
+        operator sqlite3*() {
+            return pdb;
+        }
+        class stmt {
+            sqlite::open& db;
+            sqlite3_stmt* pstmt;
+            const char* tail_;
+        public:
+            stmt(sqlite::open& db)
+                : db(db), pstmt(nullptr), tail_(nullptr)
+            { }
+            stmt(const stmt&) = delete;
+            stmt& operator=(const stmt&) = delete;
+            ~stmt()
+            {
+                sqlite3_finalize(pstmt);
+            }
+            // for use in sqlite3_* functions
+            operator sqlite3_stmt*()
+            {
+                return pstmt;
+            }
+            const char* errmsg() const
+            {
+                return sqlite3_errmsg(db);
+            }
+            int prepare(const char* sql, int nsql = -1)
+            {
+                db.touch();
+
+                return sqlite3_prepare_v2(db, sql, nsql, &pstmt, &tail_);
+            }
+            const char* tail() const
+            {
+                return tail_;
+            }
+            int bind(int col, int i)
+            {
+                return sqlite3_bind_int(pstmt, col, i);
+            }
+            int bind(int col, sqlite_int64 i)
+            {
+                return sqlite3_bind_int64(pstmt, col, i);
+            }
+            int bind(int col, double d)
+            {
+                return sqlite3_bind_double(pstmt, col, d);
+            }
+            // Do not make a copy of text by default.
+            int bind(int col, const char* t, int n = -1, void(*dealloc)(void*) = SQLITE_STATIC)
+            {
+                return sqlite3_bind_text(pstmt, col, t, n, dealloc);
+            }
+            // Use SQLITE_TRANSIENT to have sqlite copy text or blobs
+            // that do not outlive the statement execution.
+            int bind(int col, std::string_view t, void(*dealloc)(void*) = SQLITE_STATIC)
+            {
+                return sqlite3_bind_text64(pstmt, col, t.data(), t.size(), dealloc, SQLITE_UTF8);
+            }
+            int bind(int col, const std::string& t, void(*dealloc)(void*) = SQLITE_STATIC)
+            {
+                return sqlite3_bind_text64(pstmt, col, t.data(), t.size(), dealloc, SQLITE_UTF8);
+            }
+            int bind_text64(int col, const char* t, sqlite_uint64 n, void(*dealloc)(void*) = SQLITE_STATIC, unsigned char encoding = SQLITE_UTF8)
+            {
+                return sqlite3_bind_text64(pstmt, col, t, n, dealloc, encoding);
+            }
+            int bind(int col, std::nullptr_t)
+            {
+                return sqlite3_bind_null(pstmt, col);
+            }
+            int bind_null(int col)
+            {
+                return sqlite3_bind_null(pstmt, col);
+            }
+            int bind_blob(int col, const void* b, sqlite_uint64 n, void(*dealloc)(void*) = SQLITE_STATIC)
+            {
+                return sqlite3_bind_blob64(pstmt, col, b, n, dealloc);
+            }
+            // Blob of n zeros for incremental I/O with sqlite3_blob_open.
+            int bind_zeroblob(int col, sqlite_uint64 n)
+            {
+                return sqlite3_bind_zeroblob64(pstmt, col, n);
+            }
+            int bind(int col, const param& p)
+            {
+                return sqlite::bind(pstmt, col, p);
+            }
+            int bind(int col, const value& v)
+            {
+                return sqlite::bind(pstmt, col, v);
+            }
+
+            // Index of a named parameter such as :name, @name, or $name.
+            int index(const char* name) const
+            {
+                int col = sqlite3_bind_parameter_index(pstmt, name);
+                if (col == 0)
+                    throw std::runtime_error(std::string("sqlite::open::stmt: no parameter named ") + name);
+
+                return col;
+            }
+            template<class T>
+            int bind(const char* name, const T& t, void(*dealloc)(void*) = SQLITE_STATIC)
+            {
+                return bind_value(pstmt, index(name), t, dealloc);
+            }
+            int parameters() const
+            {
+                return sqlite3_bind_parameter_count(pstmt);
+            }
+
+            // Bind args to ?1, ?2, ... and return the first error.
+            // Text and blobs are copied so args may be temporaries.
+            template<class... Args>
+            int bind_row(const Args&... args)
+            {
+                int col = 0;
+                int rc = SQLITE_OK;
+                ((rc == SQLITE_OK ? rc = bind_value(pstmt, ++col, args, SQLITE_TRANSIENT) : rc), ...);
+
+                return rc;
+            }
+            // Bind values of a range such as std::vector<param> to ?first, ?first+1, ...
+            template<class R>
+            int bind_range(const R& r, int first = 1, void(*dealloc)(void*) = SQLITE_STATIC)
+            {
+                int rc = SQLITE_OK;
+                for (const auto& v : r) {
+                    if (SQLITE_OK != (rc = bind_value(pstmt, first++, v, dealloc)))
+                        break;
+                }
+
+                return rc;
+            }
+            int clear_bindings()
+            {
+                return sqlite3_clear_bindings(pstmt);
+            }
+            int reset()
+            {
+                return sqlite3_reset(pstmt);
+            }
+        };
+    };
+
+    // Statement from the connection cache that is put back when it goes out of scope.
+    class cached {
+        open& db;
+        std::string sql;
+        sqlite3_stmt* pstmt;
+    public:
+        cached(open& db, std::string_view sql)
+            : db(db), sql(sql), pstmt(db.cache.take(sql))
+        {
+            db.touch();
+            if (!pstmt) {
+                int rc = sqlite3_prepare_v3(db, sql.data(), static_cast<int>(sql.size()), SQLITE_PREPARE_PERSISTENT, &pstmt, nullptr);
+                if (SQLITE_OK != rc)
+                    throw std::runtime_error(sqlite3_errmsg(db));
+                if (!pstmt)
+                    throw std::runtime_error("sqlite::cached: no statement in SQL");
+            }
+        }
+        cached(const cached&) = delete;
+        cached& operator=(const cached&) = delete;
+        ~cached()
+        {
+            db.cache.put(std::move(sql), pstmt);
+        }
+
+        // for use in sqlite3_* functions
+        operator sqlite3_stmt*()
+        {
+            return pstmt;
+        }
+    };
+
+    // Execute SQL that does not return rows.
+    inline void exec(open& db, const char* sql)
+    {
+        db.touch();
+        char* err = nullptr;
+        if (SQLITE_OK != sqlite3_exec(db, sql, nullptr, nullptr, &err)) {
+            std::string msg(err ? err : sqlite3_errmsg(db));
+            sqlite3_free(err);
+
+            throw std::runtime_error(msg);
+        }
+    }
+
+    // column-def in CREATE TABLE
+    struct column_def {
+        std::string_view name;
+        std::string_view type;
+        std::string_view constraint;
+    };
+
+    // name as a double quoted SQL identifier
+    inline std::string quote_identifier(std::string_view name)
+    {
+        std::string id("\"");
+        for (char c : name) {
+            id.push_back(c);
+            if (c == '"')
+                id.push_back(c);
+        }
+        id.push_back('"');
+
+        return id;
+    }
+
+    // Table and column names are SQL as given, e.g. temp.t or IF NOT EXISTS t.
+    // Use quote_identifier for names that are not valid identifiers.
+    inline std::string create_table_sql(std::string_view table, const std::vector<column_def>& columns)
+    {
+        std::string ct("CREATE TABLE ");
+        ct.append(table);
+        ct.append(" (");
+
+        std::string comma = "";
+        for (const auto& col : columns) {
+            ct.append(comma);
+            ct.append(col.name);
+            ct.append(" ");
+            ct.append(col.type);
+            if (!col.constraint.empty()) {
+                ct.append(" ");
+                ct.append(col.constraint);
+            }
+
+            comma = ", ";
+        }
+        ct.append(")");
+
+        return ct;
+    }
+
+    inline void create_table(open& db, std::string_view table, const std::vector<column_def>& columns)
+    {
+        exec(db, create_table_sql(table, columns).c_str());
+    }
+
+    // https://www.sqlite.org/lang_createindex.html
+    // Columns are names or expressions optionally followed by COLLATE, ASC or DESC.
+    // A where expression makes a partial index. Index and table names are SQL
+    // as given, as in create_table_sql, e.g. IF NOT EXISTS aux.i or a name
+    // from quote_identifier.
+    inline std::string create_index_sql(std::string_view index, std::string_view table,
+        const std::vector<std::string_view>& columns, bool unique = false, std::string_view where = {})
+    {
+        std::string ci(unique ? "CREATE UNIQUE INDEX " : "CREATE INDEX ");
+        ci.append(index);
+        ci.append(" ON ");
+        ci.append(table);
+        ci.append(" (");
+
+        std::string comma = "";
+        for (const auto& col : columns) {
+            ci.append(comma);
+            ci.append(col);
+
+            comma = ", ";
+        }
+        ci.append(")");
+        if (!where.empty()) {
+            ci.append(" WHERE ");
+            ci.append(where);
+        }
+
+        return ci;
+    }
+
+    inline void create_index(open& db, std::string_view index, std::string_view table,
+        const std::vector<std::string_view>& columns, bool unique = false, std::string_view where = {})
+    {
+        exec(db, create_index_sql(index, table, columns, unique, where).c_str());
+    }
+
+    inline void drop_index(open& db, std::string_view index)
+    {
+        std::string di("DROP INDEX ");
+        di.append(index);
+
+        exec(db, di.c_str());
+    }
+}
@@ -0,0 +1,108 @@
+// status.cpp - memory and cache counters of SQLite and the add-in
+#include "status.h"
+#include "pool.h"
+#include "pcache.h"
+#include "schema.h"
+#include "writer.h"
+
+using namespace sqlite;
+
+#define STATUS(op) { "SQLITE_STATUS_" #op, SQLITE_STATUS_##op }
+#define DBSTATUS(op) { "SQLITE_DBSTATUS_" #op, SQLITE_DBSTATUS_##op }
+
+namespace {
+
+    struct op {
+        const char* name;
+        int op;
+    };
+
+    const op global_ops[] = {
+        STATUS(MEMORY_USED),
+        STATUS(MALLOC_SIZE),
+        STATUS(MALLOC_COUNT),
+        STATUS(PAGECACHE_USED),
+        STATUS(PAGECACHE_OVERFLOW),
+        STATUS(PAGECACHE_SIZE),
+        STATUS(PARSER_STACK),
+    };
+
+    const op db_ops[] = {
+        DBSTATUS(CACHE_USED),
+        DBSTATUS(CACHE_USED_SHARED),
+        DBSTATUS(CACHE_HIT),
+        DBSTATUS(CACHE_MISS),
+        DBSTATUS(CACHE_WRITE),
+#ifdef SQLITE_DBSTATUS_CACHE_SPILL
+        DBSTATUS(CACHE_SPILL),
+#endif
+        DBSTATUS(LOOKASIDE_USED),
+        DBSTATUS(LOOKASIDE_HIT),
+        DBSTATUS(LOOKASIDE_MISS_SIZE),
+        DBSTATUS(LOOKASIDE_MISS_FULL),
+        DBSTATUS(SCHEMA_USED),
+        DBSTATUS(STMT_USED),
+        DBSTATUS(DEFERRED_FKS),
+    };
+
+}
+
+std::vector<status_counter> sqlite::status(bool reset)
+{
+    std::vector<status_counter> counters;
+
+    for (const auto& [name, op] : global_ops) {
+        sqlite_int64 current = 0, highwater = 0;
+        if (SQLITE_OK == sqlite3_status64(op, &current, &highwater, reset))
+            counters.push_back({ name, current, highwater });
+    }
+
+    pool_stats pool = pool_status();
+    if (pool.installed) {
+        counters.push_back({ "pool.allocations", static_cast<sqlite_int64>(pool.allocations) });
+        counters.push_back({ "pool.cached", static_cast<sqlite_int64>(pool.cached) });
+        counters.push_back({ "pool.large", static_cast<sqlite_int64>(pool.large) });
+        counters.push_back({ "pool.used", pool.used, pool.peak });
+        counters.push_back({ "pool.reserved", pool.reserved });
+        if (reset)
+            pool_reset_peak();
+    }
+
+    if (pcache_installed()) {
+        pcache_stats pc = pcache_total();
+        counters.push_back({ "pcache.budget", pcache_budget() });
+        counters.push_back({ "pcache.bytes", pc.bytes });
+        counters.push_back({ "pcache.pages", static_cast<sqlite_int64>(pc.pages) });
+        counters.push_back({ "pcache.hits", static_cast<sqlite_int64>(pc.hits) });
+        counters.push_back({ "pcache.misses", static_cast<sqlite_int64>(pc.misses) });
+        counters.push_back({ "pcache.evictions", static_cast<sqlite_int64>(pc.evictions) });
+    }
+
+    return counters;
+}
+
+std::vector<status_counter> sqlite::status(open& db, bool reset)
+{
+    std::vector<status_counter> counters;
+
+    for (const auto& [name, op] : db_ops) {
+        int current = 0, highwater = 0;
+        if (SQLITE_OK == sqlite3_db_status(db, op, &current, &highwater, reset))
+            counters.push_back({ name, current, highwater });
+    }
+
+    counters.push_back({ "stmt_cache.size", static_cast<sqlite_int64>(db.cache.size()) });
+    counters.push_back({ "stmt_cache.bytes", db.cache.bytes() });
+    counters.push_back({ "stmt_cache.hits", static_cast<sqlite_int64>(db.cache.hits) });
+    counters.push_back({ "stmt_cache.misses", static_cast<sqlite_int64>(db.cache.misses) });
+    if (db.schema)
+        counters.push_back({ "schema_cache.loads", static_cast<sqlite_int64>(db.schema->loads) });
+    if (db.writer) {
+        write_stats ws = db.writer->stats();
+        counters.push_back({ "write_queue.pending", static_cast<sqlite_int64>(ws.pending) });
+        counters.push_back({ "write_queue.writes", static_cast<sqlite_int64>(ws.writes) });
+        counters.push_back({ "write_queue.batches", static_cast<sqlite_int64>(ws.batches) });
+    }
+
+    return counters;
+}
@@ -0,0 +1,26 @@
+// status.h - memory and cache counters of SQLite and the add-in
+#pragma once
+#include <string>
+#include <vector>
+#include "sqlite.h"
+
+namespace sqlite {
+
+    struct status_counter {
+        std::string name;
+        sqlite_int64 current = 0;
+        sqlite_int64 highwater = 0; // 0 if the counter has none
+    };
+
+    // https://www.sqlite.org/c3ref/c_status_malloc_count.html
+    // Process wide counters from sqlite3_status64 followed by those of
+    // the pool allocator and shared page cache if they are installed.
+    // Reset sets highwater marks to their current value.
+    std::vector<status_counter> status(bool reset = false);
+
+    // https://www.sqlite.org/c3ref/c_dbstatus_options.html
+    // Counters of a connection from sqlite3_db_status followed by those
+    // of its statement cache, schema cache, and write queue.
+    std::vector<status_counter> status(open& db, bool reset = false);
+
+}
@@ -0,0 +1,44 @@
+// advisor_test.cpp - index recommendations from executed statements
+#include "test.h"
+#include "../advisor.h"
+
+using namespace sqlite;
+
+TEST(advisor)
+{
+    open db(":memory:", test::rw);
+    exec(db, "CREATE TABLE t(id INTEGER PRIMARY KEY, a INTEGER, b TEXT)");
+    exec(db, "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 5000) "
+        "INSERT INTO t SELECT i, i % 100, 'b' || i FROM n");
+
+    index_advisor& adv = advisor(db);
+    adv.enabled = true;
+    open::stmt stmt(db);
+    check(SQLITE_OK == stmt.prepare("SELECT count(*) FROM t WHERE a = ?1"));
+    for (int i = 0; i < 3; ++i) {
+        stmt.bind(1, i);
+        check(SQLITE_ROW == sqlite3_step(stmt));
+        adv.observe(stmt);
+        sqlite3_reset(stmt);
+    }
+    // a lookup by primary key is not worth a look
+    open::stmt pk(db);
+    check(SQLITE_OK == pk.prepare("SELECT b FROM t WHERE id = 7"));
+    check(SQLITE_ROW == sqlite3_step(pk));
+    adv.observe(pk);
+    check(adv.size() == 1);
+
+    auto recs = adv.recommend(db);
+    check(recs.size() == 1);
+    if (!recs.empty()) {
+        check(recs[0].table == "t");
+        check(recs[0].columns == std::vector<std::string>{ "a" });
+        check(recs[0].executions == 3);
+        check(recs[0].savings >= 3 * 4999); // steps after the first row
+    }
+
+    // applying the index makes the planner use it
+    auto bench = adv.apply(db, 1, 1);
+    check(bench.size() == 1);
+    check(test::scalar(db, "SELECT count(*) FROM sqlite_master WHERE type = 'index' AND tbl_name = 't'") == "1");
+}
@@ -0,0 +1,48 @@
+// bind_test.cpp - binding C++ values to statement parameters
+#include <cstddef>
+#include <optional>
+#include "test.h"
+
+using namespace sqlite;
+
+TEST(bind)
+{
+    open db(":memory:", test::rw);
+    open::stmt stmt(db);
+    check(SQLITE_OK == stmt.prepare("SELECT typeof(?1), typeof(?2), typeof(?3), typeof(?4), typeof(?5), typeof(?6), typeof(?7), "
+        "?2, hex(?6), length(?8)"));
+    check(stmt.parameters() == 8);
+
+    // each C++ type binds as its SQLite type
+    const std::byte bytes[] = { std::byte{ 0xAB }, std::byte{ 0x01 } };
+    check(SQLITE_OK == stmt.bind_row(1, sqlite_int64(1) << 40, 2.5, std::string("text"), nullptr,
+        std::span<const std::byte>(bytes), std::optional<int>{}));
+    check(SQLITE_OK == stmt.bind_zeroblob(8, 100));
+    check(SQLITE_ROW == sqlite3_step(stmt));
+    const char* types[] = { "integer", "integer", "real", "text", "null", "blob", "null" };
+    for (int i = 0; i < 7; ++i)
+        check(std::string(reinterpret_cast<const char*>(sqlite3_column_text(stmt, i))) == types[i]);
+    check(sqlite3_column_int64(stmt, 7) == sqlite_int64(1) << 40);
+    check(std::string(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 8))) == "AB01");
+    check(sqlite3_column_int(stmt, 9) == 100);
+    stmt.reset();
+
+    // params and blobs by position
+    check(SQLITE_OK == stmt.clear_bindings());
+    check(SQLITE_OK == stmt.bind(1, param(std::string("p"))));
+    check(SQLITE_OK == stmt.bind(2, param(3.)));
+    check(SQLITE_OK == stmt.bind_blob(6, "\x01\x02", 2));
+    check(SQLITE_OK == stmt.bind_null(8));
+    check(SQLITE_ROW == sqlite3_step(stmt));
+    check(std::string(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0))) == "text");
+    check(std::string(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1))) == "real");
+    check(std::string(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 8))) == "0102");
+    check(sqlite3_column_type(stmt, 9) == SQLITE_NULL);
+    stmt.reset();
+
+    // named parameters must exist
+    open::stmt named(db);
+    check(SQLITE_OK == named.prepare("SELECT :a"));
+    check(SQLITE_OK == named.bind(":a", std::string_view("x")));
+    check(test::throws([&] { named.bind(":b", 1); }));
+}
@@ -0,0 +1,60 @@
+// builder_test.cpp - SQL SELECT statements built from clauses
+#include <memory>
+#include "test.h"
+#include "../builder.h"
+
+using namespace sqlite;
+
+TEST(builder)
+{
+    open db(":memory:", test::rw);
+    exec(db, "CREATE TABLE t(id INTEGER PRIMARY KEY, x, y); CREATE TABLE u(id, v); CREATE TABLE w(id)");
+    exec(db, "INSERT INTO t VALUES (1, 1, 1), (2, 3, 1), (3, 4, 9); INSERT INTO u VALUES (2, 'two'); INSERT INTO w VALUES (7)");
+
+    auto big = std::make_shared<builder>();
+    big->columns = { "id" };
+    big->from = "t";
+    big->where = "x > ?";
+    big->params[builder::WHERE] = { param(sqlite_int64(2)) };
+    auto other = std::make_shared<builder>();
+    other->columns = { "id", "NULL" };
+    other->from = "w";
+
+    builder b;
+    b.with.push_back({ "big", big });
+    b.distinct = true;
+    b.columns = { "t.id", "u.v" };
+    b.from = "t";
+    b.joins.push_back({ "LEFT JOIN", "u", "u.id = t.id", {} });
+    b.where = "t.id IN (SELECT id FROM big) AND t.y < ?";
+    b.params[builder::WHERE] = { param(sqlite_int64(5)) };
+    b.compounds.push_back({ "UNION ALL", other });
+    b.order_by = { "1" };
+    b.limit = "?";
+    b.params[builder::LIMIT] = { param(sqlite_int64(10)) };
+
+    // clauses render in SQL order
+    check(b.sql() == "WITH big AS (SELECT id FROM t WHERE x > ?) SELECT DISTINCT t.id, u.v FROM t "
+        "LEFT JOIN u ON u.id = t.id WHERE t.id IN (SELECT id FROM big) AND t.y < ? "
+        "UNION ALL SELECT id, NULL FROM w ORDER BY 1 LIMIT ?");
+
+    // placeholder values bind in the order they occur
+    open::stmt stmt(db);
+    check(SQLITE_OK == stmt.prepare(b.sql().c_str()));
+    check(b.bind(stmt) == 3);
+    std::string rows;
+    while (SQLITE_ROW == sqlite3_step(stmt)) {
+        rows.append(std::to_string(sqlite3_column_int(stmt, 0)));
+        if (sqlite3_column_type(stmt, 1) == SQLITE_TEXT)
+            rows.append(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)));
+        rows.append(";");
+    }
+    check(rows == "2two;7;");
+
+    // a copy renders again after a clause changes
+    builder c(b);
+    c.limit = "1";
+    c.params[builder::LIMIT].clear();
+    check(c.sql().substr(c.sql().size() - 7) == "LIMIT 1");
+    check(b.sql().substr(b.sql().size() - 7) == "LIMIT ?");
+}
@@ -0,0 +1,39 @@
+// carray_test.cpp - table-valued function over arrays bound as pointers
+#include "test.h"
+#include "../carray.h"
+
+using namespace sqlite;
+
+TEST(carray)
+{
+    open db(":memory:", test::rw);
+    check(SQLITE_OK == carray_init(db));
+    exec(db, "CREATE TABLE t(id INTEGER PRIMARY KEY, name TEXT)");
+    exec(db, "INSERT INTO t VALUES (1, 'a'), (2, 'b'), (3, 'c'), (4, 'd')");
+
+    open::stmt stmt(db);
+    check(SQLITE_OK == stmt.prepare("SELECT group_concat(name, '') FROM t WHERE id IN carray(?1)"));
+    auto names = [&stmt](const carray& a) {
+        sqlite3_reset(stmt);
+        check(SQLITE_OK == a.bind(stmt, 1));
+        check(SQLITE_ROW == sqlite3_step(stmt));
+        const unsigned char* t = sqlite3_column_text(stmt, 0);
+
+        return std::string(t ? reinterpret_cast<const char*>(t) : "");
+    };
+    check(names(carray(std::vector<sqlite_int64>{ 4, 2, 9 })) == "bd");
+    check(names(carray(std::vector<double>{ 1, 3 })) == "ac");
+    check(names(carray()) == "");
+
+    // text arrays and a plain value as a one element array
+    open::stmt text(db);
+    check(SQLITE_OK == text.prepare("SELECT count(*) FROM t WHERE name IN carray(?1)"));
+    carray abc(std::vector<std::string>{ "a", "b", "z" });
+    check(SQLITE_OK == abc.bind(text, 1));
+    check(SQLITE_ROW == sqlite3_step(text));
+    check(sqlite3_column_int(text, 0) == 2);
+    sqlite3_reset(text);
+    check(SQLITE_OK == text.bind(1, "c"));
+    check(SQLITE_ROW == sqlite3_step(text));
+    check(sqlite3_column_int(text, 0) == 1);
+}
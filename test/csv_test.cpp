@@ -0,0 +1,76 @@
+// csv_test.cpp - bulk import and export of delimited files
+#include "test.h"
+#include "../csv.h"
+
+using namespace sqlite;
+
+TEST(csv)
+{
+    open db(":memory:", test::rw);
+    std::string file = test::temp_file("import.csv");
+
+    // quoted delimiters, doubled quotes, CRLF records and a field over two lines
+    test::write_file(file,
+        "id,name,note\r\n"
+        "1,\"a, b\",\"say \"\"hi\"\"\"\r\n"
+        "2,plain,\"two\r\nlines\"\r\n"
+        "3,,last");
+    csv_stats stats = import_csv(db, "my table", file.c_str());
+    check(stats.rows == 3);
+    check(test::scalar(db, "SELECT typeof(id) FROM \"my table\" WHERE id = 1") == "integer");
+    check(test::scalar(db, "SELECT name FROM \"my table\" WHERE id = 1") == "a, b");
+    check(test::scalar(db, "SELECT note FROM \"my table\" WHERE id = 1") == "say \"hi\"");
+    check(test::scalar(db, "SELECT note FROM \"my table\" WHERE id = 2") == "two\r\nlines");
+    check(test::scalar(db, "SELECT note FROM \"my table\" WHERE id = 3") == "last");
+
+    // export quotes the same fields so the file round trips
+    std::string out = test::temp_file("export.csv");
+    export_csv(db, "SELECT id, name, note FROM \"my table\" ORDER BY id", out.c_str());
+    std::string text = test::read_file(out);
+    check(text.find("\"a, b\",\"say \"\"hi\"\"\"") != std::string::npos);
+    check(text.find("\"two\r\nlines\"") != std::string::npos);
+
+    // a second statement is an error instead of being ignored
+    check(test::throws([&] { export_csv(db, "SELECT 1; DELETE FROM \"my table\"", out.c_str()); }));
+    check(test::scalar(db, "SELECT count(*) FROM \"my table\"") == "3");
+    export_csv(db, "SELECT 1; -- done\n ;", out.c_str());
+    check(test::read_file(out) == "1\n1\n");
+    export_csv(db, "SELECT id, name, note FROM \"my table\" ORDER BY id", out.c_str());
+
+    open db2(":memory:", test::rw);
+    stats = import_csv(db2, "t", out.c_str());
+    check(stats.rows == 3);
+    check(test::scalar(db2, "SELECT note FROM t WHERE id = 2") == "two\r\nlines");
+
+    // a failed import leaves nothing behind, including rows before the error
+    exec(db, "CREATE TABLE u(id INTEGER PRIMARY KEY, name TEXT)");
+    exec(db, "INSERT INTO u VALUES (3, 'taken')");
+    test::write_file(file, "id,name\n1,a\n2,b\n3,c\n");
+    csv_options options;
+    options.chunk = 1;
+    check(test::throws([&] { import_csv(db, "u", file.c_str(), options); }));
+    check(test::scalar(db, "SELECT count(*) FROM u") == "1");
+    check(sqlite3_get_autocommit(db));
+
+    // tab delimited files round trip through backslash escapes, and quotes are text
+    csv_options tsv;
+    tsv.delimiter = '\t';
+    exec(db, "CREATE TABLE v(id INTEGER, note TEXT)");
+    exec(db, "INSERT INTO v VALUES (1, 'tab\there'), (2, 'two' || char(13, 10) || 'lines'), (3, '\\n is not a newline'), (4, '\"quoted\" text')");
+    export_csv(db, "SELECT * FROM v ORDER BY id", out.c_str(), tsv);
+    check(test::read_file(out).find("tab\\there") != std::string::npos);
+    tsv.chunk = 8;
+    stats = import_csv(db2, "v", out.c_str(), tsv);
+    check(stats.rows == 4);
+    check(test::scalar(db2, "SELECT note FROM v WHERE id = 1") == "tab\there");
+    check(test::scalar(db2, "SELECT note FROM v WHERE id = 2") == "two\r\nlines");
+    check(test::scalar(db2, "SELECT note FROM v WHERE id = 4") == "\"quoted\" text");
+    check(test::scalar(db2, "SELECT note FROM v WHERE id = 3") == "\\n is not a newline");
+
+    remove(file.c_str());
+    remove(out.c_str());
+
+    // create_table_sql uses names as given so they can be schema qualified
+    check(create_table_sql("temp.t", { { "a", "INTEGER", "" }, { "\"b c\"", "TEXT", "NOT NULL" } })
+        == "CREATE TABLE temp.t (a INTEGER, \"b c\" TEXT NOT NULL)");
+}
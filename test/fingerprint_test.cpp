@@ -0,0 +1,57 @@
+// fingerprint_test.cpp - SQL fingerprints and literal extraction
+#include "test.h"
+#include "../fingerprint.h"
+
+using namespace sqlite;
+
+TEST(fingerprint)
+{
+    fingerprint fp("select  Name from tracks -- comment\n where GenreId = 7 and Composer = 'Jobim'");
+    check(fp.sql == "SELECT Name FROM tracks WHERE GenreId = ? AND Composer = ?");
+    check(fp.params.size() == 2);
+    check(fp.params.size() == 2 && std::get<1>(fp.params[0]) == 7);
+    check(fp.params.size() == 2 && std::get<3>(fp.params[1]) == "Jobim");
+
+    // literals, case and whitespace do not change the fingerprint
+    fingerprint fp2("SELECT Name FROM tracks WHERE GenreId=8 AND Composer='x'");
+    check(fp2.sql == fp.sql);
+    check(fp2.hash() == fp.hash());
+
+    // SQL with parameters is only normalized
+    fingerprint fp3("select * from t where a = ?1 and b = 2");
+    check(fp3.params.empty());
+    check(fp3.sql == "SELECT * FROM t WHERE a = ?1 AND b = 2");
+
+    // result columns and DDL are kept
+    fingerprint fp4("select 'x' as y from t where a = 1");
+    check(fp4.sql == "SELECT 'x' as y FROM t WHERE a = ?");
+    check(fingerprint("create table t(a default 1)").params.empty());
+
+    // call arguments are kept so the normalized SQL still uses an expression index
+    open db(":memory:", test::rw);
+    exec(db, "CREATE TABLE t(name TEXT); CREATE INDEX ie ON t(substr(name, 1, 3))");
+    fingerprint fp5("select * from t where substr(name, 1, 3) = 'abc'");
+    check(fp5.sql == "SELECT * FROM t WHERE substr(name, 1, 3) = ?");
+    check(fp5.params.size() == 1);
+
+    open::stmt plan(db);
+    check(SQLITE_OK == plan.prepare(("EXPLAIN QUERY PLAN " + fp5.sql).c_str()));
+    fp5.bind(plan);
+    std::string detail;
+    while (SQLITE_ROW == sqlite3_step(plan))
+        detail.append(reinterpret_cast<const char*>(sqlite3_column_text(plan, 3)));
+    check(detail.find("USING INDEX ie") != std::string::npos);
+
+    // string literals read as table names are kept
+    fingerprint fp6("select * from 'tracks' where x = 1");
+    check(fp6.sql == "SELECT * FROM 'tracks' WHERE x = ?");
+    check(fp6.params.size() == 1);
+    fingerprint fp7("insert into 't'('name') values('abc')");
+    check(fp7.sql == "INSERT INTO 't'('name') VALUES (?)");
+    exec(db, fp7.sql.c_str());
+
+    // RETURNING columns are kept like result columns
+    fingerprint fp8("update t set name = 'x' returning name, 1");
+    check(fp8.sql == "UPDATE t SET name = ? RETURNING name, 1");
+    check(fp8.params.size() == 1);
+}
@@ -0,0 +1,47 @@
+// pcache_test.cpp - page cache shared by all connections under one memory budget
+#include <cstdio>
+#include "test.h"
+#include "../pcache.h"
+
+using namespace sqlite;
+
+TEST(pcache)
+{
+    // install between shutdowns and put the default page cache back for the other tests
+    static sqlite3_pcache_methods2 methods;
+    check(SQLITE_OK == sqlite3_shutdown());
+    check(SQLITE_OK == sqlite3_config(SQLITE_CONFIG_GETPCACHE2, &methods));
+    check(SQLITE_OK == pcache_install(256 << 10));
+    check(pcache_installed());
+    struct restore {
+        ~restore()
+        {
+            sqlite3_shutdown();
+            sqlite3_config(SQLITE_CONFIG_PCACHE2, &methods);
+        }
+    } restore_;
+
+    std::string file = test::temp_file("pcache.db");
+    remove(file.c_str());
+    {
+        open db(file.c_str(), test::rw);
+        exec(db, "CREATE TABLE t(x); WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 500) "
+            "INSERT INTO t SELECT randomblob(2000) FROM n");
+        check(test::scalar(db, "SELECT count(*) FROM t") == "500");
+
+        // pages of a file are recycled to stay within the budget
+        pcache_stats total = pcache_total();
+        check(total.caches >= 1);
+        check(total.evictions > 0);
+        check(total.bytes <= pcache_budget());
+
+        auto connection = pcache_connection(db);
+        check(!connection.empty() && connection[0].schema == "main");
+
+        // a smaller budget evicts unpinned pages now
+        pcache_budget(64 << 10);
+        check(pcache_total().bytes <= 64 << 10);
+        check(test::scalar(db, "SELECT sum(length(x)) FROM t") == "1000000");
+    }
+    remove(file.c_str());
+}
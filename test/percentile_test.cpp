@@ -0,0 +1,53 @@
+// percentile_test.cpp - percentile, median, and t-digest aggregate functions
+#include <cmath>
+#include <cstring>
+#include "test.h"
+#include "../percentile.h"
+
+using namespace sqlite;
+
+namespace {
+
+    double number(open& db, const char* sql)
+    {
+        return std::stod(test::scalar(db, sql));
+    }
+
+}
+
+TEST(percentile)
+{
+    open db(":memory:", test::rw);
+    check(SQLITE_OK == percentile_init(db));
+    exec(db, "CREATE TABLE t(x)");
+    exec(db, "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 20000) "
+        "INSERT INTO t SELECT i FROM n");
+
+    // exact percentiles interpolate like PERCENTILE.INC
+    check(number(db, "SELECT percentile(x, 25) FROM t WHERE x <= 5") == 2);
+    check(number(db, "SELECT median(x) FROM t WHERE x <= 4") == 2.5);
+    // a t-digest past the exact limit is close
+    check(std::fabs(number(db, "SELECT percentile(x, 90) FROM t") - 18000) < 100);
+
+    // merged digests keep their compression
+    exec(db, "CREATE TABLE d AS SELECT x % 4 AS g, tdigest(x, 200) AS td FROM t GROUP BY g");
+    open::stmt stmt(db);
+    check(SQLITE_OK == stmt.prepare("SELECT tdigest_merge(td) FROM d"));
+    check(SQLITE_ROW == sqlite3_step(stmt));
+    tdigest td = tdigest::deserialize(sqlite3_column_blob(stmt, 0), sqlite3_column_bytes(stmt, 0));
+    check(td.compression() == 200);
+    check(td.count() == 20000);
+    check(std::fabs(td.quantile(0.5) - 10000) < 50);
+    check(std::fabs(number(db, "SELECT tdigest_percentile(tdigest_merge(td), 50) FROM d") - 10000) < 50);
+
+    // centroids must have positive weights
+    tdigest one;
+    one.add(1);
+    std::string blob = one.serialize();
+    double weight = 0;
+    memcpy(blob.data() + blob.size() - sizeof(double), &weight, sizeof(double));
+    check(test::throws([&] { tdigest::deserialize(blob.data(), static_cast<int>(blob.size())); }));
+    weight = NAN;
+    memcpy(blob.data() + blob.size() - sizeof(double), &weight, sizeof(double));
+    check(test::throws([&] { tdigest::deserialize(blob.data(), static_cast<int>(blob.size())); }));
+}
@@ -0,0 +1,53 @@
+// pool_test.cpp - size-class pool allocator
+#include <cstring>
+#include "test.h"
+#include "../pool.h"
+
+using namespace sqlite;
+
+TEST(pool)
+{
+    // install between shutdowns and put the default allocator back for the other tests
+    static sqlite3_mem_methods methods;
+    check(SQLITE_OK == sqlite3_shutdown());
+    check(SQLITE_OK == sqlite3_config(SQLITE_CONFIG_GETMALLOC, &methods));
+    check(SQLITE_OK == pool_install());
+    check(pool_status().installed);
+    struct restore {
+        ~restore()
+        {
+            sqlite3_shutdown();
+            sqlite3_config(SQLITE_CONFIG_MALLOC, &methods);
+        }
+    } restore_;
+
+    {
+        // blocks are rounded up to their size class
+        void* p = sqlite3_malloc(20);
+        check(sqlite3_msize(p) == 32);
+        // reallocating within the class keeps the block
+        check(sqlite3_realloc(p, 30) == p);
+        p = sqlite3_realloc(p, 100);
+        check(sqlite3_msize(p) == 128);
+        sqlite3_free(p);
+
+        // every byte xSize reports can be written, SQLite may round up before calling xMalloc
+        sqlite3_mem_methods pool;
+        check(SQLITE_OK == sqlite3_shutdown());
+        check(SQLITE_OK == sqlite3_config(SQLITE_CONFIG_GETMALLOC, &pool));
+        size_t large = pool_status().large;
+        void* q = pool.xMalloc(4097);
+        check(pool_status().large == large + 1);
+        check(pool.xSize(q) >= 4097);
+        memset(q, 0, static_cast<size_t>(pool.xSize(q)));
+        pool.xFree(q);
+
+        open db(":memory:", test::rw);
+        exec(db, "CREATE TABLE t(x); WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 10) INSERT INTO t SELECT randomblob(5000) FROM n");
+        check(test::scalar(db, "SELECT count(*) FROM t") == "10");
+        pool_stats s = pool_status();
+        check(s.allocations > s.frees);
+        check(s.used > 0 && s.peak >= s.used);
+    }
+
+}
@@ -0,0 +1,58 @@
+// range_test.cpp - rows of a statement as a two dimensional range
+// bench/grid.h stands in for xll::OPER.
+#include "test.h"
+#include "../bench/grid.h"
+
+using namespace sqlite;
+
+namespace {
+
+    using cell4 = bench::cell<std::string>;
+
+    bench::grid4 exec_many(open& db, const char* sql, const std::vector<std::vector<sqlite_int64>>& params,
+        bool header = false, size_t max_rows = 65536)
+    {
+        open::stmt stmt(db);
+        if (SQLITE_OK != stmt.prepare(sql))
+            throw std::runtime_error(stmt.errmsg());
+        auto bind = [&params](sqlite3_stmt* stmt, unsigned i) {
+            for (size_t j = 0; j < params[i].size(); ++j)
+                sqlite3_bind_int64(stmt, static_cast<int>(j + 1), params[i][j]);
+        };
+
+        return sqlite::exec_many<bench::grid4, cell4>(db, stmt, static_cast<unsigned>(params.size()), bind, header,
+            cell4::error(SQLITE_NULL), cell4::error(SQLITE_BLOB), max_rows);
+    }
+
+}
+
+TEST(exec_many)
+{
+    open db(":memory:", test::rw);
+    exec(db, "CREATE TABLE t(id INTEGER PRIMARY KEY, x INTEGER)");
+    exec(db, "INSERT INTO t VALUES (1, 10), (2, 20), (3, 30)");
+
+    // query results are stacked after the parameter row number
+    auto o = exec_many(db, "SELECT id, x FROM t WHERE x >= ?1 ORDER BY id", { { 30 }, { 40 }, { 20 } }, true);
+    check(o.rows() == 4 && o.columns() == 3);
+    check(o(0, 0).text == "row" && o(0, 1).text == "id" && o(0, 2).text == "x");
+    check(o(1, 0).val == 1 && o(1, 1).val == 3);
+    check(o(2, 0).val == 3 && o(2, 1).val == 2);
+    check(o(3, 0).val == 3 && o(3, 2).val == 30);
+
+    // other statements return the changes of each row
+    o = exec_many(db, "UPDATE t SET x = x + ?2 WHERE id <= ?1", { { 1, 1 }, { 3, 1 }, { 0, 1 } });
+    check(o.rows() == 3 && o.columns() == 1);
+    check(o[0].val == 1 && o[1].val == 3 && o[2].val == 0);
+    check(test::scalar(db, "SELECT sum(x) FROM t") == "64");
+
+    // a failed row undoes the rows before it
+    check(test::throws([&] { exec_many(db, "INSERT INTO t VALUES (?1, 0)", { { 4 }, { 5 }, { 1 } }); }));
+    check(test::scalar(db, "SELECT count(*) FROM t") == "3");
+    check(sqlite3_get_autocommit(db));
+
+    // rows past max_rows are an error
+    check(exec_many(db, "SELECT id FROM t", { { 0 } }, false, 3).rows() == 3);
+    check(test::throws([&] { exec_many(db, "SELECT id FROM t", { { 0 }, { 0 } }, false, 5); }));
+    check(exec_many(db, "SELECT id FROM t WHERE id > 3", { { 0 } }).rows() == 0);
+}
@@ -0,0 +1,61 @@
+// schema_test.cpp - schema cache and index builders
+#include "test.h"
+#include "../schema.h"
+
+using namespace sqlite;
+
+TEST(indexes)
+{
+    open db(":memory:", test::rw);
+    exec(db, "CREATE TABLE t(a, b)");
+
+    // names are SQL as given, like create_table_sql
+    check(create_index_sql("IF NOT EXISTS ia", "t", { "a", "b DESC" }, true, "a > 0")
+        == "CREATE UNIQUE INDEX IF NOT EXISTS ia ON t (a, b DESC) WHERE a > 0");
+    create_index(db, "main." + quote_identifier("my index"), "t", { "lower(b)" });
+    check(test::scalar(db, "SELECT name FROM sqlite_master WHERE type = 'index'") == "my index");
+
+    // one dbstat scan sizes every table and index, empty without SQLITE_ENABLE_DBSTAT_VTAB
+    auto bytes = object_bytes(db);
+    check(bytes.empty() || (bytes.count("t") && bytes["my index"] > 0));
+
+    drop_index(db, quote_identifier("my index"));
+    check(test::scalar(db, "SELECT count(*) FROM sqlite_master WHERE type = 'index'") == "0");
+}
+
+TEST(schema_cache)
+{
+    open db(":memory:", test::rw);
+    exec(db, "CREATE TABLE t(a INTEGER PRIMARY KEY, b TEXT NOT NULL DEFAULT 'x')");
+    exec(db, "CREATE INDEX tb ON t(b)");
+    schema_cache& cache = schema(db);
+
+    const table_info* t = cache.table(db, "T");
+    check(t && t->schema == "main" && t->columns.size() == 2);
+    check(t && t->column("B") && t->column("b")->has_default && t->column("b")->notnull);
+    check(t && t->indexes.size() == 1 && t->indexes[0].columns == std::vector<std::string>{ "b" });
+    size_t loads = cache.loads;
+    cache.table(db, "t");
+    check(cache.loads == loads);
+
+    // temp and attached schemas are loaded, and ATTACH reloads
+    exec(db, "ATTACH ':memory:' AS aux");
+    exec(db, "CREATE TABLE aux.u(c, d REFERENCES t)");
+    exec(db, "CREATE TEMP TABLE t(e)");
+    check(cache.table(db, "aux.u") && cache.table(db, "U")->schema == "aux");
+    check(cache.table(db, "u") && cache.table(db, "u")->foreign_keys.size() == 1);
+    check(cache.loads > loads);
+    // unqualified names resolve to temp first
+    check(cache.table(db, "t") && cache.table(db, "t")->schema == "temp");
+    check(cache.table(db, "main.t") && cache.table(db, "main.t")->columns.size() == 2);
+    check(cache.tables(db).count("temp.t") && cache.tables(db).count("aux.u"));
+
+    // a broken view is kept with its error
+    exec(db, "CREATE TABLE w(x); CREATE VIEW v AS SELECT x FROM w; DROP TABLE w");
+    const table_info* v = cache.table(db, "v");
+    check(v && v->columns.empty() && !v->error.empty());
+    check(cache.table(db, "main.t") && cache.table(db, "main.t")->columns.size() == 2);
+
+    exec(db, "DETACH aux");
+    check(!cache.table(db, "u"));
+}
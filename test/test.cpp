@@ -0,0 +1,23 @@
+// test.cpp - checks of the portable core on Linux
+// Build and run from the repository root:
+//   g++ -std=c++20 -o xllsqlite_test test/*.cpp fingerprint.cpp csv.cpp utf.cpp transaction.cpp pool.cpp schema.cpp writer.cpp percentile.cpp carray.cpp builder.cpp advisor.cpp pcache.cpp -lsqlite3 -lpthread
+//   ./xllsqlite_test
+// Prints each failed check and exits with the number of failures.
+#include "test.h"
+
+int main()
+{
+    for (const auto& t : test::cases()) {
+        int before = test::failures;
+        try {
+            t.run();
+        }
+        catch (const std::exception& ex) {
+            ++test::failures;
+            fprintf(stderr, "%s: %s\n", t.name, ex.what());
+        }
+        printf("%s: %s\n", t.name, test::failures == before ? "ok" : "FAILED");
+    }
+
+    return test::failures;
+}
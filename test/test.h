@@ -0,0 +1,96 @@
+// test.h - checks of the portable core on Linux
+// Each test/*_test.cpp registers its tests with TEST and test.cpp runs them.
+#pragma once
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "../sqlite.h"
+
+namespace test {
+
+    inline int failures = 0;
+
+    struct test_case {
+        const char* name;
+        void (*run)();
+    };
+
+    inline std::vector<test_case>& cases()
+    {
+        static std::vector<test_case> cases_;
+
+        return cases_;
+    }
+
+    // Register a test when the program starts.
+    struct add {
+        add(const char* name, void (*run)())
+        {
+            cases().push_back({ name, run });
+        }
+    };
+
+    // Whether f throws.
+    template<class F>
+    inline bool throws(F f)
+    {
+        try {
+            f();
+        }
+        catch (const std::exception&) {
+            return true;
+        }
+
+        return false;
+    }
+
+    // First column of the first row of sql as text.
+    inline std::string scalar(sqlite::open& db, const char* sql)
+    {
+        sqlite::open::stmt stmt(db);
+        if (SQLITE_OK != stmt.prepare(sql))
+            throw std::runtime_error(stmt.errmsg());
+        if (SQLITE_ROW != sqlite3_step(stmt))
+            return {};
+        const unsigned char* t = sqlite3_column_text(stmt, 0);
+
+        return t ? reinterpret_cast<const char*>(t) : "";
+    }
+
+    // Flags of a database that can be written.
+    constexpr int rw = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE;
+
+    inline std::string temp_file(const char* name)
+    {
+        const char* dir = getenv("TMPDIR");
+
+        return std::string(dir ? dir : "/tmp") + "/xllsqlite_test_" + name;
+    }
+
+    inline void write_file(const std::string& file, const std::string& text)
+    {
+        std::ofstream(file, std::ios::binary) << text;
+    }
+
+    inline std::string read_file(const std::string& file)
+    {
+        std::ostringstream s;
+        s << std::ifstream(file, std::ios::binary).rdbuf();
+
+        return s.str();
+    }
+
+}
+
+// Record a failure and continue if e is false.
+#define check(e) do { if (!(e)) { ++test::failures; fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #e); } } while (0)
+
+// Define and register a test.
+#define TEST(name) \
+    static void test_##name(); \
+    static test::add test_##name##_add(#name, test_##name); \
+    static void test_##name()
@@ -0,0 +1,78 @@
+// transaction_test.cpp - transactions and savepoints
+#include <memory>
+#include "test.h"
+#include "../transaction.h"
+
+using namespace sqlite;
+
+TEST(transaction)
+{
+    open db(":memory:", test::rw);
+    exec(db, "CREATE TABLE t(x)");
+
+    // destroying an active transaction rolls it back
+    {
+        transaction txn(db);
+        exec(db, "INSERT INTO t VALUES (1)");
+        check(txn.active());
+    }
+    check(test::scalar(db, "SELECT count(*) FROM t") == "0");
+    check(sqlite3_get_autocommit(db));
+
+    {
+        transaction txn(db);
+        exec(db, "INSERT INTO t VALUES (1)");
+        txn.commit();
+        check(!txn.active());
+        check(test::throws([&] { txn.commit(); }));
+    }
+    check(test::scalar(db, "SELECT count(*) FROM t") == "1");
+
+    // a savepoint rolls back only its own changes and ending one ends those nested in it
+    {
+        transaction txn(db);
+        savepoint outer(txn);
+        exec(db, "INSERT INTO t VALUES (2)");
+        savepoint inner(txn, "inner");
+        exec(db, "INSERT INTO t VALUES (3)");
+        check(test::throws([&] { savepoint dup(txn, "inner"); }));
+        outer.rollback();
+        check(!outer.active());
+        check(!inner.active());
+        check(test::scalar(db, "SELECT count(*) FROM t") == "1");
+
+        savepoint kept(txn);
+        exec(db, "INSERT INTO t VALUES (4)");
+        kept.release();
+        txn.commit();
+        check(!kept.active());
+    }
+    check(test::scalar(db, "SELECT count(*) FROM t") == "2");
+
+    // a transaction ended by SQL is inactive and is not rolled back again
+    {
+        transaction txn(db);
+        savepoint sp(txn);
+        exec(db, "COMMIT");
+        check(!txn.active());
+        check(!sp.active());
+        check(test::throws([&] { savepoint late(txn); }));
+
+        // a new transaction replaces one that ended without its object knowing
+        exec(db, "BEGIN");
+        check(!txn.active());
+        exec(db, "ROLLBACK");
+        transaction txn2(db);
+        check(txn2.active());
+        check(!txn.active());
+    }
+    check(sqlite3_get_autocommit(db));
+
+    // a transaction outliving its connection does nothing when destroyed
+    auto pdb = std::make_unique<open>(":memory:", test::rw);
+    auto txn = std::make_unique<transaction>(*pdb);
+    check(txn->active());
+    pdb.reset();
+    check(!txn->active());
+    txn.reset();
+}
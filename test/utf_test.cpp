@@ -0,0 +1,25 @@
+// utf_test.cpp - UTF-16 and UTF-8 transcoding
+#include "test.h"
+#include "../utf.h"
+
+using namespace sqlite;
+
+TEST(utf)
+{
+    // ASCII longer than a vector block, two and three byte sequences, and a surrogate pair
+    std::u16string ws = u"plain ascii text over sixteen units, \u00E9t\u00E9, \u20AC and \U0001F600";
+    std::string s(utf::narrow_size(ws.size()), 0);
+    s.resize(utf::narrow(ws.data(), ws.size(), s.data()));
+    check(s == "plain ascii text over sixteen units, \xC3\xA9t\xC3\xA9, \xE2\x82\xAC and \xF0\x9F\x98\x80");
+
+    std::u16string ws2(utf::widen_size(s.size()), 0);
+    ws2.resize(utf::widen(s.data(), s.size(), ws2.data()));
+    check(ws2 == ws);
+
+    // unpaired surrogates and invalid bytes become U+FFFD
+    char16_t lone[] = { u'a', 0xD800, u'b' };
+    char buf[utf::narrow_size(3)];
+    check(std::string(buf, utf::narrow(lone, 3, buf)) == "a\xEF\xBF\xBD" "b");
+    char16_t wbuf[3];
+    check(std::u16string(wbuf, utf::widen("a\xFF" "b", 3, wbuf)) == u"a\uFFFDb");
+}
@@ -0,0 +1,58 @@
+// value_test.cpp - 16-byte values and their binding
+#include <vector>
+#include "test.h"
+
+using namespace sqlite;
+
+TEST(value)
+{
+    static_assert(sizeof(value) == 16);
+
+    open db(":memory:", test::rw);
+    arena a;
+
+    // short text is stored inline and long text is copied into the arena
+    std::string long_text(100, 'x');
+    value s(std::string_view("abc"), a);
+    value l(std::string_view(long_text), a);
+    check(s.is_inline());
+    check(!l.is_inline());
+    check(s.as_text() == "abc");
+    check(l.as_text() == long_text);
+    check(l.data() != long_text.data());
+    check(value(42).as_int64() == 42);
+    check(value(2.5).as_double() == 2.5);
+    check(value().type() == SQLITE_NULL);
+    check(value::text("abc") == s);
+
+    // the length of text or blobs not stored inline is 32 bits
+    static const char big[1] = {};
+    check(test::throws([] { value::blob(big, value::max_size + 1); }));
+
+    // values read from a row keep their type
+    open::stmt row(db);
+    check(SQLITE_OK == row.prepare("SELECT 1, 1.5, 'abc', x'0102', NULL"));
+    check(SQLITE_ROW == sqlite3_step(row));
+    check(value::column(row, 0, a).type() == SQLITE_INTEGER);
+    check(value::column(row, 1, a).as_double() == 1.5);
+    check(value::column(row, 2, a).as_text() == "abc");
+    check(value::column(row, 3, a).type() == SQLITE_BLOB && value::column(row, 3, a).size() == 2);
+    check(value::column(row, 4, a).type() == SQLITE_NULL);
+
+    // inline payloads of temporaries are copied by every bind path
+    open::stmt stmt(db);
+    check(SQLITE_OK == stmt.prepare("SELECT :x, ?2, ?3, ?4"));
+    check(SQLITE_OK == stmt.bind(":x", value::text("named")));
+    check(SQLITE_OK == stmt.bind(2, value::text("positional")));
+    check(SQLITE_OK == bind_value(stmt, 3, value::blob("blob", 4)));
+    check(SQLITE_OK == stmt.bind_range(std::vector<value>{ value::text("range") }, 4));
+    // overwrite the stack the temporaries used
+    volatile char junk[256];
+    for (auto& c : junk)
+        c = '#';
+    check(SQLITE_ROW == sqlite3_step(stmt));
+    check(std::string(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0))) == "named");
+    check(std::string(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1))) == "positional");
+    check(std::string(static_cast<const char*>(sqlite3_column_blob(stmt, 2)), 4) == "blob");
+    check(std::string(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3))) == "range");
+}
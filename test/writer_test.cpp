@@ -0,0 +1,54 @@
+// writer_test.cpp - group commit of writes from many callers
+#include <cstdio>
+#include "test.h"
+#include "../writer.h"
+
+using namespace sqlite;
+
+TEST(writer)
+{
+    std::string file = test::temp_file("writer.db");
+    remove(file.c_str());
+    {
+        open db(file.c_str(), test::rw);
+        exec(db, "CREATE TABLE t(id INTEGER PRIMARY KEY, x TEXT)");
+        // a trigger that rolls back the whole transaction
+        exec(db, "CREATE TRIGGER t_no AFTER INSERT ON t WHEN new.x = 'no' BEGIN SELECT RAISE(ROLLBACK, 'no'); END");
+
+        write_options options;
+        options.delay = std::chrono::milliseconds(1000);
+        write_queue queue(db, options);
+
+        // writes of a batch commit together and fail one at a time
+        write_ticket a = queue.push("INSERT INTO t VALUES (?1, ?2)", { param(sqlite_int64(1)), param(std::string("a")) });
+        write_ticket b = queue.push("INSERT INTO t VALUES (1, 'duplicate')");
+        write_ticket c = queue.push("UPDATE t SET x = 'c' WHERE id = 1");
+        queue.flush();
+        check(a->state == write_result::committed);
+        check(b->state == write_result::failed && !b->error.empty());
+        check(c->state == write_result::committed && c->rows == 1);
+        check(test::scalar(db, "SELECT x FROM t WHERE id = 1") == "c");
+
+        // an error that rolls back the transaction fails the writes before it
+        write_ticket d = queue.push("INSERT INTO t VALUES (2, 'd')");
+        write_ticket e = queue.push("INSERT INTO t VALUES (3, 'no')");
+        write_ticket f = queue.push("INSERT INTO t VALUES (4, 'f')");
+        queue.flush();
+        check(d->state == write_result::failed && d->error == "transaction rolled back: no");
+        check(e->state == write_result::failed && e->error == "no");
+        check(f->state == write_result::committed);
+        check(test::scalar(db, "SELECT group_concat(id) FROM t") == "1,4");
+
+        // the queue owns the transaction
+        check(test::throws([&] { queue.push("COMMIT"); }));
+        check(test::throws([&] { queue.push(" -- done\n end transaction"); }));
+        check(test::throws([&] { queue.push("/* undo */ rollback"); }));
+        check(test::throws([&] { queue.push("SAVEPOINT s"); }));
+
+        write_stats stats = queue.stats();
+        check(stats.writes == 6);
+        check(stats.errors == 3);
+        check(stats.pending == 0);
+    }
+    remove(file.c_str());
+}
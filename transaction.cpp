@@ -0,0 +1,150 @@
+// transaction.cpp - transactions and savepoints that roll back when abandoned
+#include <algorithm>
+#include "transaction.h"
+
+using namespace sqlite;
+
+namespace {
+
+    // "name" with embedded quotes doubled
+    std::string quote(const std::string& name)
+    {
+        std::string q("\"");
+        for (char c : name) {
+            if (c == '"')
+                q.push_back(c);
+            q.push_back(c);
+        }
+        q.push_back('"');
+
+        return q;
+    }
+
+}
+
+transaction::transaction(open& db, mode m)
+    : db(db), owner(db.owner), savepoints(std::make_shared<std::vector<savepoint*>>())
+{
+    static const char* begin[] = { "BEGIN DEFERRED", "BEGIN IMMEDIATE", "BEGIN EXCLUSIVE" };
+    exec(db, begin[static_cast<int>(m)]);
+    // a transaction that ended without its object knowing is replaced
+    *db.owner = this;
+}
+
+transaction::~transaction()
+{
+    if (active())
+        sqlite3_exec(db, "ROLLBACK", nullptr, nullptr, nullptr);
+    if (auto p = owner.lock(); p && *p == this)
+        *p = nullptr;
+}
+
+bool transaction::active() const
+{
+    auto p = owner.lock();
+    if (!p || *p != this)
+        return false;
+    // ended by SQL, so a later BEGIN does not make it active again
+    if (sqlite3_get_autocommit(db)) {
+        *p = nullptr;
+        return false;
+    }
+
+    return true;
+}
+
+void transaction::end(const char* sql)
+{
+    if (!active())
+        throw std::runtime_error("sqlite::transaction: not active");
+
+    std::string error;
+    try {
+        exec(db, sql);
+    }
+    catch (const std::exception& ex) {
+        // still open so it can be retried
+        if (!sqlite3_get_autocommit(db))
+            throw;
+        error = ex.what();
+    }
+    savepoints->clear();
+    *owner.lock() = nullptr;
+    if (!error.empty())
+        throw std::runtime_error(error);
+}
+
+void transaction::commit()
+{
+    end("COMMIT");
+}
+
+void transaction::rollback()
+{
+    end("ROLLBACK");
+}
+
+savepoint::savepoint(transaction& txn, std::string_view name)
+    : txn(txn), savepoints(txn.savepoints), name_(name)
+{
+    if (!txn.active())
+        throw std::runtime_error("sqlite::savepoint: transaction not active");
+    if (name_.empty())
+        name_ = "sp" + std::to_string(++txn.names);
+    for (const savepoint* sp : *txn.savepoints) {
+        if (sp->name_ == name_)
+            throw std::runtime_error("sqlite::savepoint: duplicate name " + name_);
+    }
+
+    exec(txn.db, ("SAVEPOINT " + quote(name_)).c_str());
+    txn.savepoints->push_back(this);
+}
+
+savepoint::~savepoint()
+{
+    if (active()) {
+        try {
+            rollback();
+        }
+        catch (...) {
+            // the connection reports the error to its next caller
+        }
+    }
+    if (auto p = savepoints.lock()) {
+        auto i = std::find(p->begin(), p->end(), this);
+        if (i != p->end())
+            p->erase(i, p->end());
+    }
+}
+
+bool savepoint::active() const
+{
+    auto p = savepoints.lock();
+
+    return p && std::find(p->begin(), p->end(), this) != p->end() && txn.active();
+}
+
+void savepoint::end(const char* sql)
+{
+    if (!active())
+        throw std::runtime_error("sqlite::savepoint: not active");
+
+    exec(txn.db, (sql + quote(name_)).c_str());
+    auto p = savepoints.lock();
+    p->erase(std::find(p->begin(), p->end(), this), p->end());
+}
+
+void savepoint::release()
+{
+    end("RELEASE ");
+}
+
+void savepoint::rollback()
+{
+    if (!active())
+        throw std::runtime_error("sqlite::savepoint: not active");
+
+    // ROLLBACK TO leaves the savepoint open
+    exec(txn.db, ("ROLLBACK TO " + quote(name_)).c_str());
+    end("RELEASE ");
+}
@@ -0,0 +1,70 @@
+// transaction.h - transactions and savepoints that roll back when abandoned
+#pragma once
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "sqlite.h"
+
+namespace sqlite {
+
+    class savepoint;
+
+    // https://www.sqlite.org/lang_transaction.html
+    // BEGIN when constructed and ROLLBACK when destroyed unless committed
+    // or rolled back first. A transaction is inactive once it ends, once
+    // its connection closes, or once SQL ends it some other way, and
+    // destroying an inactive transaction does nothing.
+    class transaction {
+        friend class savepoint;
+        open& db;
+        std::weak_ptr<transaction*> owner; // open::owner
+        // active savepoints, innermost last
+        std::shared_ptr<std::vector<savepoint*>> savepoints;
+        size_t names = 0; // for default savepoint names
+
+        void end(const char* sql);
+    public:
+        enum class mode { deferred, immediate, exclusive };
+
+        transaction(open& db, mode m = mode::deferred);
+        transaction(const transaction&) = delete;
+        transaction& operator=(const transaction&) = delete;
+        ~transaction();
+
+        bool active() const;
+        // Throws if the commit fails. The transaction stays active if it
+        // can be retried, e.g. on SQLITE_BUSY.
+        void commit();
+        void rollback();
+    };
+
+    // https://www.sqlite.org/lang_savepoint.html
+    // SAVEPOINT when constructed and ROLLBACK TO when destroyed unless
+    // released or rolled back first. Ending a savepoint also ends the
+    // savepoints nested in it and ending the transaction ends them all.
+    class savepoint {
+        transaction& txn;
+        std::weak_ptr<std::vector<savepoint*>> savepoints; // transaction::savepoints
+        std::string name_;
+
+        void end(const char* sql);
+    public:
+        // Default name is sp1, sp2, ...
+        savepoint(transaction& txn, std::string_view name = {});
+        savepoint(const savepoint&) = delete;
+        savepoint& operator=(const savepoint&) = delete;
+        ~savepoint();
+
+        bool active() const;
+        const std::string& name() const
+        {
+            return name_;
+        }
+        // Keep the changes made since the savepoint.
+        void release();
+        // Undo the changes made since the savepoint.
+        void rollback();
+    };
+
+}
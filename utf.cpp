@@ -0,0 +1,164 @@
+// utf.cpp - UTF-16 and UTF-8 transcoding into caller provided buffers
+#include <cstdint>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define UTF_SSE2
+#include <emmintrin.h>
+#endif
+#include "utf.h"
+
+namespace {
+
+    constexpr char16_t replacement = 0xFFFD;
+
+    // Copy ASCII 16 units at a time and return the number of units copied.
+    size_t narrow_ascii(const char16_t* ws, size_t n, char* buf)
+    {
+        size_t i = 0;
+#ifdef UTF_SSE2
+        const __m128i mask = _mm_set1_epi16(static_cast<short>(0xFF80));
+        const __m128i zero = _mm_setzero_si128();
+        for (; i + 16 <= n; i += 16) {
+            __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ws + i));
+            __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ws + i + 8));
+            __m128i non_ascii = _mm_and_si128(_mm_or_si128(lo, hi), mask);
+            if (_mm_movemask_epi8(_mm_cmpeq_epi16(non_ascii, zero)) != 0xFFFF)
+                break;
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(buf + i), _mm_packus_epi16(lo, hi));
+        }
+#else
+        for (; i + 4 <= n; i += 4) {
+            uint64_t u = uint64_t(ws[i]) | uint64_t(ws[i + 1]) << 16 | uint64_t(ws[i + 2]) << 32 | uint64_t(ws[i + 3]) << 48;
+            if (u & 0xFF80FF80FF80FF80ull)
+                break;
+            buf[i] = static_cast<char>(ws[i]);
+            buf[i + 1] = static_cast<char>(ws[i + 1]);
+            buf[i + 2] = static_cast<char>(ws[i + 2]);
+            buf[i + 3] = static_cast<char>(ws[i + 3]);
+        }
+#endif
+
+        return i;
+    }
+
+    // Copy ASCII 16 bytes at a time and return the number of bytes copied.
+    size_t widen_ascii(const char* s, size_t n, char16_t* buf)
+    {
+        size_t i = 0;
+#ifdef UTF_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        for (; i + 16 <= n; i += 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+            if (_mm_movemask_epi8(v) != 0)
+                break;
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(buf + i), _mm_unpacklo_epi8(v, zero));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(buf + i + 8), _mm_unpackhi_epi8(v, zero));
+        }
+#else
+        for (; i < n && static_cast<unsigned char>(s[i]) < 0x80; ++i)
+            buf[i] = s[i];
+#endif
+
+        return i;
+    }
+
+    bool continuation(unsigned char c)
+    {
+        return (c & 0xC0) == 0x80;
+    }
+
+}
+
+size_t utf::narrow(const char16_t* ws, size_t n, char* buf)
+{
+    char* out = buf;
+    size_t i = 0;
+
+    while (i < n) {
+        size_t m = narrow_ascii(ws + i, n - i, out);
+        i += m;
+        out += m;
+        if (i == n)
+            break;
+
+        // scalar until the next ASCII character
+        do {
+            uint32_t c = ws[i++];
+            if (c < 0x80) {
+                *out++ = static_cast<char>(c);
+                break;
+            }
+            if (c < 0x800) {
+                *out++ = static_cast<char>(0xC0 | (c >> 6));
+                *out++ = static_cast<char>(0x80 | (c & 0x3F));
+                continue;
+            }
+            if (c >= 0xD800 && c <= 0xDFFF) {
+                if (c <= 0xDBFF && i < n && ws[i] >= 0xDC00 && ws[i] <= 0xDFFF) {
+                    c = 0x10000 + ((c - 0xD800) << 10) + (ws[i++] - 0xDC00);
+                    *out++ = static_cast<char>(0xF0 | (c >> 18));
+                    *out++ = static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+                    *out++ = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+                    *out++ = static_cast<char>(0x80 | (c & 0x3F));
+                    continue;
+                }
+                c = replacement;
+            }
+            *out++ = static_cast<char>(0xE0 | (c >> 12));
+            *out++ = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+            *out++ = static_cast<char>(0x80 | (c & 0x3F));
+        } while (i < n);
+    }
+
+    return out - buf;
+}
+
+size_t utf::widen(const char* s, size_t n, char16_t* buf)
+{
+    const unsigned char* u = reinterpret_cast<const unsigned char*>(s);
+    char16_t* out = buf;
+    size_t i = 0;
+
+    while (i < n) {
+        size_t m = widen_ascii(s + i, n - i, out);
+        i += m;
+        out += m;
+        if (i == n)
+            break;
+
+        do {
+            uint32_t c = u[i];
+            if (c < 0x80) {
+                *out++ = static_cast<char16_t>(c);
+                ++i;
+                break;
+            }
+            if (c >= 0xC2 && c <= 0xDF && i + 1 < n && continuation(u[i + 1])) {
+                *out++ = static_cast<char16_t>(((c & 0x1F) << 6) | (u[i + 1] & 0x3F));
+                i += 2;
+                continue;
+            }
+            if ((c & 0xF0) == 0xE0 && i + 2 < n && continuation(u[i + 1]) && continuation(u[i + 2])) {
+                uint32_t cp = ((c & 0x0F) << 12) | ((u[i + 1] & 0x3F) << 6) | (u[i + 2] & 0x3F);
+                if (cp >= 0x800 && (cp < 0xD800 || cp > 0xDFFF)) {
+                    *out++ = static_cast<char16_t>(cp);
+                    i += 3;
+                    continue;
+                }
+            }
+            if (c >= 0xF0 && c <= 0xF4 && i + 3 < n && continuation(u[i + 1]) && continuation(u[i + 2]) && continuation(u[i + 3])) {
+                uint32_t cp = ((c & 0x07) << 18) | ((u[i + 1] & 0x3F) << 12) | ((u[i + 2] & 0x3F) << 6) | (u[i + 3] & 0x3F);
+                if (cp >= 0x10000 && cp <= 0x10FFFF) {
+                    cp -= 0x10000;
+                    *out++ = static_cast<char16_t>(0xD800 + (cp >> 10));
+                    *out++ = static_cast<char16_t>(0xDC00 + (cp & 0x3FF));
+                    i += 4;
+                    continue;
+                }
+            }
+            *out++ = replacement;
+            ++i;
+        } while (i < n);
+    }
+
+    return out - buf;
+}
@@ -0,0 +1,106 @@
+// utf.h - UTF-16 and UTF-8 transcoding into caller provided buffers
+#pragma once
+#include <cstddef>
+#include <memory>
+
+namespace utf {
+
+    // Maximum UTF-8 bytes for n UTF-16 code units.
+    constexpr size_t narrow_size(size_t n)
+    {
+        return 3 * n;
+    }
+    // Maximum UTF-16 code units for n UTF-8 bytes.
+    constexpr size_t widen_size(size_t n)
+    {
+        return n;
+    }
+
+    // Convert n UTF-16 code units to UTF-8 in buf having at least narrow_size(n) bytes.
+    // Unpaired surrogates become U+FFFD. Return the number of bytes written.
+    size_t narrow(const char16_t* ws, size_t n, char* buf);
+
+    // Convert n UTF-8 bytes to UTF-16 in buf having at least widen_size(n) code units.
+    // Invalid sequences become U+FFFD. Return the number of code units written.
+    size_t widen(const char* s, size_t n, char16_t* buf);
+
+#ifdef _WIN32
+    static_assert(sizeof(wchar_t) == sizeof(char16_t));
+
+    inline size_t narrow(const wchar_t* ws, size_t n, char* buf)
+    {
+        return narrow(reinterpret_cast<const char16_t*>(ws), n, buf);
+    }
+    inline size_t widen(const char* s, size_t n, wchar_t* buf)
+    {
+        return widen(s, n, reinterpret_cast<char16_t*>(buf));
+    }
+#endif
+
+    // Converted text in a stack buffer of N elements, or on the heap if it does not fit.
+    template<class T, size_t N>
+    class buffer {
+        T stack[N];
+        std::unique_ptr<T[]> heap;
+        T* data_;
+        size_t size_ = 0;
+    protected:
+        T* reserve(size_t n)
+        {
+            if (n < N) {
+                data_ = stack;
+            }
+            else {
+                heap.reset(new T[n + 1]);
+                data_ = heap.get();
+            }
+
+            return data_;
+        }
+        void set_size(size_t n)
+        {
+            size_ = n;
+            data_[n] = 0;
+        }
+    public:
+        buffer()
+            : data_(stack)
+        {
+            stack[0] = 0;
+        }
+        buffer(const buffer&) = delete;
+        buffer& operator=(const buffer&) = delete;
+
+        // null terminated
+        const T* data() const
+        {
+            return data_;
+        }
+        size_t size() const
+        {
+            return size_;
+        }
+    };
+
+    // UTF-8 copy of UTF-16 text for passing to sqlite3_* functions.
+    template<size_t N = 1024>
+    class to_utf8 : public buffer<char, N> {
+    public:
+        template<class C>
+        to_utf8(const C* ws, size_t n)
+        {
+            this->set_size(narrow(ws, n, this->reserve(narrow_size(n))));
+        }
+    };
+
+    // UTF-16 copy of UTF-8 text.
+    template<class C = char16_t, size_t N = 512>
+    class to_utf16 : public buffer<C, N> {
+    public:
+        to_utf16(const char* s, size_t n)
+        {
+            this->set_size(widen(s, n, this->reserve(widen_size(n))));
+        }
+    };
+
+}
@@ -1,3 +1,4 @@
+#include <charconv>
 #include "xll12/xll/xll.h"
 #include <commdlg.h>
 
@@ -63,39 +64,114 @@ const wchar_t* WINAPI xll_open_file()
     return buf;
 }
 
+// Excel error as text.
+static const wchar_t* error_text(int err)
+{
+    switch (err) {
+    case xlerrNull: return L"#NULL!";
+    case xlerrDiv0: return L"#DIV/0!";
+    case xlerrValue: return L"#VALUE!";
+    case xlerrRef: return L"#REF!";
+    case xlerrName: return L"#NAME?";
+    case xlerrNum: return L"#NUM!";
+    case xlerrNA: return L"#N/A";
+    }
+
+    return L"#GETTING_DATA";
+}
+
+// Upper bound on the length of a cell as text.
+static size_t cell_size(const OPER& x, bool sql)
+{
+    if (x.xltype == xltypeStr) {
+        // quotes may double in SQL literals
+        return sql ? 2 + 2 * x.val.str[0] : x.val.str[0];
+    }
+
+    return 24;
+}
+
+// Append cell as text without calling back into Excel.
+// Numbers have 15 significant digits like the General format,
+// e.g. 1000000, 0.0001, and 1E+15.
+static void append_cell(wstring& s, const OPER& x, bool sql)
+{
+    switch (x.xltype) {
+    case xltypeNum: {
+        char buf[32];
+        double num = x.val.num == 0 ? 0 : x.val.num; // no -0
+        auto [p, ec] = std::to_chars(buf, buf + sizeof(buf), num, std::chars_format::general, 15);
+        for (const char* c = buf; c != p; ++c)
+            s.append(1, *c == 'e' ? L'E' : static_cast<wchar_t>(*c));
+        break;
+    }
+    case xltypeStr:
+        if (sql) {
+            s.append(1, L'\'');
+            for (int i = 1; i <= x.val.str[0]; ++i) {
+                if (x.val.str[i] == L'\'')
+                    s.append(1, L'\'');
+                s.append(1, x.val.str[i]);
+            }
+            s.append(1, L'\'');
+        }
+        else {
+            s.append(x.val.str + 1, x.val.str[0]);
+        }
+        break;
+    case xltypeBool:
+        s.append(sql ? (x.val.xbool ? L"1" : L"0") : (x.val.xbool ? L"TRUE" : L"FALSE"));
+        break;
+    case xltypeErr:
+        s.append(sql ? L"NULL" : error_text(x.val.err));
+        break;
+    default:
+        if (sql)
+            s.append(L"NULL");
+    }
+}
+
 AddIn xai_join(
     Function(XLL_CSTRING, L"?xll_join", L"JOIN")
     .Arg(XLL_LPOPER, L"range", L"is a two-dimensional range.")
     .Arg(XLL_CSTRING, L"fs", L"is the field seperator for rows.")
     .Arg(XLL_CSTRING, L"rs", L"is the record seperator for columns.")
     .Arg(XLL_CSTRING, L"bracket", L"is an optional two character string for the first and last characters.")
+    .Arg(XLL_BOOL, L"sql", L"is an optional boolean to quote and escape cells as SQL literals.")
     .FunctionHelp(L"Join cells in range using separators and return a string.")
     .Category(L"XLL")
     .Documentation(L"")
 );
-const wchar_t* WINAPI xll_join(LPOPER range, xcstr fs, xcstr rs, xcstr bracket)
+const wchar_t* WINAPI xll_join(LPOPER range, xcstr fs, xcstr rs, xcstr bracket, BOOL sql)
 {
 #pragma XLLEXPORT
     static wstring join;
 
     try {
-        join = L"";
+        const auto& r = *range;
+        size_t nfs = wcslen(fs);
+        size_t nrs = wcslen(rs);
+
+        size_t n = 2 + r.rows() * (nrs + r.columns() * nfs);
+        for (int i = 0; i < r.rows(); ++i) {
+            for (int j = 0; j < r.columns(); ++j) {
+                n += cell_size(r(i, j), sql != FALSE);
+            }
+        }
+        join.clear();
+        join.reserve(n);
+
         if (bracket && bracket[0]) {
             join.append(1, bracket[0]);
         }
-        wstring FS = L"";
-        wstring RS = L"";
-        const auto& r = *range;
         for (int i = 0; i < r.rows(); ++i) {
-            join.append(RS);
+            if (i > 0)
+                join.append(rs, nrs);
             for (int j = 0; j < r.columns(); ++j) {
-                join.append(FS);
-                OPER rij = Excel(xlfText, r(i, j), OPER(L"General"));
-                ensure(rij.isStr());
-                join.append(rij.val.str + 1, rij.val.str[0]);
-                FS = fs;
+                if (j > 0)
+                    join.append(fs, nfs);
+                append_cell(join, r(i, j), sql != FALSE);
             }
-            RS = rs;
         }
         if (bracket && bracket[0] && bracket[1]) {
             join.append(1, bracket[1]);
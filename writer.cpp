@@ -0,0 +1,232 @@
+// writer.cpp - group commit of writes from many callers
+#include <cctype>
+#include "writer.h"
+
+using namespace sqlite;
+using std::chrono::steady_clock;
+
+namespace {
+
+    const char* database_file(open& db)
+    {
+        const char* file = sqlite3_db_filename(db, "main");
+        if (!file || !*file)
+            throw std::runtime_error("write_queue: database must be a file");
+        if (sqlite3_db_readonly(db, "main"))
+            throw std::runtime_error("write_queue: database must be writable");
+
+        return file;
+    }
+
+    // Run one statement and return its result code.
+    int step(open& conn, const std::string& sql, const std::vector<param>& params, int& rows)
+    {
+        cached stmt(conn, sql);
+        int rc = SQLITE_OK;
+        for (int i = 0; rc == SQLITE_OK && i < static_cast<int>(params.size()); ++i)
+            rc = bind(stmt, i + 1, params[i]);
+        if (rc == SQLITE_OK) {
+            while (SQLITE_ROW == (rc = sqlite3_step(stmt)))
+                ;
+            rows = sqlite3_changes(conn);
+        }
+        // reset returns the error of the last step
+        rc = sqlite3_reset(stmt) == SQLITE_OK && rc == SQLITE_DONE ? SQLITE_OK : rc;
+        // parameters do not outlive the request
+        sqlite3_clear_bindings(stmt);
+
+        return rc;
+    }
+
+    // Whether sql starts with BEGIN, COMMIT, END, ROLLBACK, SAVEPOINT, or RELEASE.
+    bool transaction_control(std::string_view sql)
+    {
+        size_t i = 0;
+        while (i < sql.size()) {
+            if (isspace(static_cast<unsigned char>(sql[i])) || sql[i] == ';') {
+                ++i;
+            }
+            else if (sql.substr(i, 2) == "--") {
+                i = sql.find('\n', i);
+            }
+            else if (sql.substr(i, 2) == "/*") {
+                i = sql.find("*/", i + 2);
+                if (i != std::string_view::npos)
+                    i += 2;
+            }
+            else {
+                break;
+            }
+        }
+        if (i >= sql.size())
+            return false;
+
+        size_t n = 0;
+        while (i + n < sql.size() && isalpha(static_cast<unsigned char>(sql[i + n])))
+            ++n;
+        std::string word(sql.substr(i, n));
+        for (char& c : word)
+            c = static_cast<char>(toupper(static_cast<unsigned char>(c)));
+
+        return word == "BEGIN" || word == "COMMIT" || word == "END" || word == "ROLLBACK"
+            || word == "SAVEPOINT" || word == "RELEASE";
+    }
+
+    void fail(write_result& r, const std::string& error)
+    {
+        r.error = error;
+        r.state.store(write_result::failed, std::memory_order_release);
+    }
+
+}
+
+write_queue::write_queue(open& db, const write_options& options)
+    : conn(database_file(db), SQLITE_OPEN_READWRITE), options(options)
+{
+    sqlite3_busy_timeout(conn, options.busy_timeout);
+
+    thread = std::thread(&write_queue::run, this);
+}
+
+write_queue::~write_queue()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    cv.notify_all();
+    if (thread.joinable())
+        thread.join();
+}
+
+write_ticket write_queue::push(std::string sql, std::vector<param> params)
+{
+    // the queue owns the transaction of each batch
+    if (transaction_control(sql))
+        throw std::runtime_error("write_queue: transaction control statements cannot be queued");
+
+    auto result = std::make_shared<write_result>();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (pending.empty())
+            oldest = steady_clock::now();
+        pending.push_back(request{ std::move(sql), std::move(params), result });
+        if (pending.size() != 1 && pending.size() < options.batch)
+            return result;
+    }
+    cv.notify_all();
+
+    return result;
+}
+
+void write_queue::flush()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    ++flushing;
+    cv.notify_all();
+    flushed.wait(lock, [this] { return pending.empty() && running == 0; });
+    --flushing;
+}
+
+write_stats write_queue::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    write_stats s = stats_;
+    s.pending = pending.size() + running;
+
+    return s;
+}
+
+void write_queue::run()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        cv.wait(lock, [this] { return stop || !pending.empty(); });
+        if (pending.empty())
+            break;
+        cv.wait_until(lock, oldest + options.delay, [this] {
+            return stop || flushing || pending.size() >= options.batch;
+        });
+
+        std::vector<request> batch;
+        batch.swap(pending);
+        running = batch.size();
+        lock.unlock();
+
+        auto t0 = steady_clock::now();
+        commit(batch);
+        double seconds = std::chrono::duration<double>(steady_clock::now() - t0).count();
+
+        lock.lock();
+        running = 0;
+        stats_.seconds += seconds;
+        for (const auto& r : batch) {
+            ++stats_.writes;
+            if (r.result->state == write_result::failed)
+                ++stats_.errors;
+            else
+                stats_.rows += r.result->rows;
+        }
+        flushed.notify_all();
+    }
+}
+
+// Complete every request of the batch.
+void write_queue::commit(std::vector<request>& batch)
+{
+    size_t begin = 0; // first request of the open transaction
+    bool active = false;
+
+    // Fail requests of the open transaction that have not failed on their own.
+    auto rollback = [&batch, &begin](size_t end, const std::string& error) {
+        for (size_t j = begin; j < end; ++j) {
+            if (batch[j].result->state != write_result::failed)
+                fail(*batch[j].result, error);
+        }
+    };
+
+    for (size_t i = 0; i < batch.size(); ++i) {
+        if (!active) {
+            if (SQLITE_OK != sqlite3_exec(conn, "BEGIN IMMEDIATE", nullptr, nullptr, nullptr)) {
+                fail(*batch[i].result, sqlite3_errmsg(conn));
+                continue;
+            }
+            begin = i;
+            active = true;
+        }
+
+        write_result& r = *batch[i].result;
+        try {
+            if (SQLITE_OK != step(conn, batch[i].sql, batch[i].params, r.rows))
+                fail(r, sqlite3_errmsg(conn));
+        }
+        catch (const std::exception& ex) {
+            fail(r, ex.what());
+        }
+        // https://www.sqlite.org/lang_transaction.html#response_to_errors_within_a_transaction
+        if (sqlite3_get_autocommit(conn)) {
+            if (r.state != write_result::failed)
+                fail(r, "write_queue: statement ended the transaction");
+            rollback(i, "transaction rolled back: " + r.error);
+            active = false;
+        }
+    }
+
+    if (active) {
+        if (SQLITE_OK == sqlite3_exec(conn, "COMMIT", nullptr, nullptr, nullptr)) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                ++stats_.batches;
+            }
+            for (size_t j = begin; j < batch.size(); ++j) {
+                if (batch[j].result->state != write_result::failed)
+                    batch[j].result->state.store(write_result::committed, std::memory_order_release);
+            }
+        }
+        else {
+            std::string error = sqlite3_errmsg(conn);
+            sqlite3_exec(conn, "ROLLBACK", nullptr, nullptr, nullptr);
+            rollback(batch.size(), error);
+        }
+    }
+}
@@ -0,0 +1,109 @@
+// writer.h - group commit of writes from many callers
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "sqlite.h"
+
+namespace sqlite {
+
+    // Outcome of a queued write. Fields other than state are set before
+    // state leaves pending and do not change after that.
+    struct write_result {
+        enum { pending, committed, failed };
+        std::atomic<int> state{ pending };
+        int rows = 0;           // sqlite3_changes of the statement
+        std::string error;
+
+        bool done() const
+        {
+            return state.load(std::memory_order_acquire) != pending;
+        }
+    };
+
+    // Completion handle shared by the queue and the caller.
+    using write_ticket = std::shared_ptr<const write_result>;
+
+    // A batch is committed when it has batch writes or its oldest
+    // write has waited delay.
+    struct write_options {
+        size_t batch = 1000;
+        std::chrono::milliseconds delay{ 50 };
+        int busy_timeout = 5000; // milliseconds to wait for the write lock
+    };
+
+    struct write_stats {
+        size_t writes = 0;      // completed
+        size_t errors = 0;
+        size_t batches = 0;     // transactions committed
+        size_t pending = 0;
+        sqlite_int64 rows = 0;
+        double seconds = 0;     // spent in transactions
+    };
+
+    // Statements queued by many callers run on a background thread in
+    // one BEGIN IMMEDIATE ... COMMIT per batch instead of one autocommit
+    // transaction, and one fsync, each. The thread has its own connection
+    // to the database file so writes become visible to the caller's
+    // connection when their batch commits.
+    // A failed statement only undoes its own changes unless the error
+    // rolls back the transaction, in which case every write of the batch
+    // before it fails too.
+    class write_queue {
+        struct request {
+            std::string sql;
+            std::vector<param> params;
+            std::shared_ptr<write_result> result;
+        };
+        open conn;
+        write_options options;
+        mutable std::mutex mutex;
+        std::condition_variable cv, flushed;
+        std::vector<request> pending;
+        std::chrono::steady_clock::time_point oldest;
+        size_t flushing = 0;    // callers waiting in flush()
+        size_t running = 0;     // writes in the current transaction
+        bool stop = false;
+        write_stats stats_;
+        std::thread thread;
+
+        void run();
+        void commit(std::vector<request>& batch);
+    public:
+        // The database must be a writable file.
+        write_queue(open& db, const write_options& options = write_options{});
+        write_queue(const write_queue&) = delete;
+        write_queue& operator=(const write_queue&) = delete;
+        // Commits pending writes.
+        ~write_queue();
+
+        // Queue a single statement with parameters bound to ?1, ?2, ...
+        // Throws for BEGIN, COMMIT, and other transaction control statements.
+        write_ticket push(std::string sql, std::vector<param> params = {});
+        // Commit everything queued so far and wait for it.
+        void flush();
+
+        write_stats stats() const;
+    };
+
+    // Write queue of a connection.
+    inline write_queue& writer(open& db)
+    {
+        if (!db.writer)
+            db.writer = std::make_shared<write_queue>(db);
+
+        return *db.writer;
+    }
+
+    // Queue a write on a connection.
+    inline write_ticket write(open& db, std::string sql, std::vector<param> params = {})
+    {
+        db.touch();
+
+        return writer(db).push(std::move(sql), std::move(params));
+    }
+
+}
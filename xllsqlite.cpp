@@ -1,6 +1,19 @@
 // xllsqlite.cpp - sqlite wrapper
+#include <cstdlib>
 #include <locale>
 #include "xllsqlite.h"
+#include "percentile.h"
+#include "csv.h"
+#include "builder.h"
+#include "fingerprint.h"
+#include "schema.h"
+#include "advisor.h"
+#include "maintenance.h"
+#include "writer.h"
+#include "transaction.h"
+#include "pool.h"
+#include "pcache.h"
+#include "status.h"
 
 using namespace xll;
 using xcstr = traits<XLOPERX>::xcstr;
@@ -21,6 +34,22 @@ XLL_CONST(LONG, SQLITE_OPEN_MEMORY, SQLITE_OPEN_MEMORY, "Open data base in memor
 XLL_CONST(LONG, SQLITE_OPEN_NOMUTEX, SQLITE_OPEN_NOMUTEX, "Do not use mutal exclusing when accessing database.", CATEGORY, SQLITE_OPEN_URL);
 XLL_CONST(LONG, SQLITE_OPEN_FULLMUTEX, SQLITE_OPEN_FULLMUTEX, "Use mutal exclusing when accessing database.", CATEGORY, SQLITE_OPEN_URL);
 
+// Set the environment variable XLLSQLITE_MALLOC=pool before starting Excel
+// to use the pool allocator and XLLSQLITE_PCACHE=megabytes to use the shared
+// page cache. They must be installed before any connection opens.
+int xll_sqlite_config()
+{
+    const char* malloc = std::getenv("XLLSQLITE_MALLOC");
+    if (malloc && 0 == sqlite3_stricmp(malloc, "pool"))
+        sqlite::pool_install();
+    const char* pcache = std::getenv("XLLSQLITE_PCACHE");
+    if (pcache && std::atof(pcache) > 0)
+        sqlite::pcache_install(static_cast<sqlite_int64>(std::atof(pcache) * 1024 * 1024));
+
+    return TRUE;
+}
+Auto<Open> xao_sqlite_config(xll_sqlite_config);
+
 AddIn xai_sqlite_open(
     Function(XLL_HANDLE, "xll_sqlite_open", "\\SQLITE.OPEN")
     .Arguments({
@@ -43,6 +72,11 @@ HANDLEX WINAPI xll_sqlite_open(const char* file, LONG flags)
             flags = SQLITE_OPEN_READONLY;
 
         handle<sqlite::open> h_(new sqlite::open(file, flags));
+        ensure(SQLITE_OK == sqlite::percentile_init(*h_));
+        ensure(SQLITE_OK == sqlite::carray_init(*h_));
+        // label the page caches of the connection for SQLITE.PCACHE
+        if (sqlite::pcache_installed())
+            sqlite::pcache_connection(*h_);
         h = h_.get();
     }
     catch (const std::exception& ex) {
@@ -64,9 +98,6 @@ PRIMARY_KEY[.ASC|.DESC](clause)[.AUTOINCREMENT]
     ON_CONFLICT_ABORT
     ...
 
-HAVING(expr, GROUP_BY({expr,...}, WHERE(expr, FROM(table, SELECT({column,...})))))
-SELECT.ALL
-SELECT.DISTINCT
 */
 
 /*
@@ -82,185 +113,343 @@ AddIn xai_range(
 //struct SELECT : public OPER4 {};
 
 AddIn xai_sql_select(
-    Function(XLL_LPOPER4, "xll_sql_select", "SQL.SELECT") // .ALL, .DISTINCT
+    Function(XLL_HANDLE, "xll_sql_select", "SQL.SELECT")
     .Arguments({
         Arg(XLL_LPOPER4, "columns", "is a range of the columns to return."),
+        Arg(XLL_BOOL, "_distinct", "is an optional boolean indicating duplicate rows are removed. Default is false."),
         })
+    .Uncalced()
     .Category(CATEGORY)
-    .FunctionHelp("Return SQL SELECT statement.")
+    .FunctionHelp("Return a handle to a SQL SELECT statement.")
     .HelpTopic("https://www.sqlite.org/syntax/select-core.html")
 );
-LPOPER4 WINAPI xll_sql_select(const LPOPER4 pcols)
+HANDLEX WINAPI xll_sql_select(const LPOPER4 pcols, BOOL distinct)
 {
 #pragma XLLEXPORT
-    static OPER4 result;
-    result = ErrValue4;
+    HANDLEX h = INVALID_HANDLEX;
 
     try {
-        OPER4 sel("SELECT ");
-        OPER4 comma("");
+        handle<sqlite::builder> h_(new sqlite::builder);
+        h_->distinct = distinct != FALSE;
         for (const auto& col : *pcols) {
-            ensure(col.is_str());
-            sel &= comma;
-            sel &= col;
-            comma = ", ";
+            h_->columns.emplace_back(view(col));
         }
-        result.swap(sel);
+        h = h_.get();
     }
     catch (const std::exception& ex) {
         XLL_ERROR(ex.what());
     }
 
-    return &result;
+    return h;
+}
+
+// Copy of the statement having handle h.
+static sqlite::builder* sql_builder(HANDLEX h)
+{
+    handle<sqlite::builder> h_(h);
+    ensure(h_.ptr() or !"SQL.*: not a handle to a SQL statement");
+
+    return new sqlite::builder(*h_);
 }
 
 AddIn xai_sql_from(
-    Function(XLL_LPOPER4, "xll_sql_from", "SQL.FROM")
+    Function(XLL_HANDLE, "xll_sql_from", "SQL.FROM")
     .Arguments({
         Arg(XLL_CSTRING4, "table", "is the table to select from."),
-        Arg(XLL_LPOPER4, "select", "is a SELECT statement."),
+        Arg(XLL_HANDLE, "select", "is a handle to a SELECT statement."),
         })
-        .Category(CATEGORY)
-    .FunctionHelp("Return SQL from statement.")
+    .Uncalced()
+    .Category(CATEGORY)
+    .FunctionHelp("Return a handle to a SQL statement with a FROM clause.")
     .HelpTopic("https://www.sqlite.org/syntax/select-core.html")
 );
-LPOPER4 WINAPI xll_sql_from(const char* table, const LPOPER4 psel)
+HANDLEX WINAPI xll_sql_from(const char* table, HANDLEX sel)
+{
+#pragma XLLEXPORT
+    HANDLEX h = INVALID_HANDLEX;
+
+    try {
+        handle<sqlite::builder> h_(sql_builder(sel));
+        h_->from = table;
+        h = h_.get();
+    }
+    catch (const std::exception& ex) {
+        XLL_ERROR(ex.what());
+    }
+
+    return h;
+}
+
+// Add a join to a copy of the statement having handle sel.
+static HANDLEX sql_join(const char* op, const char* table, const char* on, const OPER4* pcols, HANDLEX sel, const OPER4* pparams)
+{
+    handle<sqlite::builder> h_(sql_builder(sel));
+    ensure(!h_->from.empty() or !"SQL.JOIN: statement must have a FROM clause");
+
+    sqlite::builder::join j;
+    j.op = op;
+    j.table = table;
+    if (on)
+        j.on = on;
+    if (pcols) {
+        for (const auto& col : *pcols)
+            j.using_.emplace_back(view(col));
+    }
+    h_->joins.push_back(std::move(j));
+    // ON expressions occur before WHERE in the rendered SQL
+    if (pparams) {
+        for (auto& p : sqlite_params(*pparams))
+            h_->params[sqlite::builder::FROM].push_back(std::move(p));
+    }
+
+    return h_.get();
+}
+
+AddIn xai_sql_join(
+    Function(XLL_HANDLE, "xll_sql_join", "SQL.JOIN")
+    .Arguments({
+        Arg(XLL_CSTRING4, "table", "is the table to join."),
+        Arg(XLL_CSTRING4, "on", "is the join constraint expression."),
+        Arg(XLL_HANDLE, "from", "is a handle to a statement with a FROM clause."),
+        Arg(XLL_LPOPER4, "_params", "is an optional range of values for the ? placeholders in on."),
+        })
+    .Uncalced()
+    .Category(CATEGORY)
+    .FunctionHelp("Return a handle to a SQL statement with an inner JOIN ... ON clause.")
+    .HelpTopic("https://www.sqlite.org/syntax/join-clause.html")
+);
+HANDLEX WINAPI xll_sql_join(const char* table, const char* on, HANDLEX sel, const LPOPER4 pparams)
+{
+#pragma XLLEXPORT
+    HANDLEX h = INVALID_HANDLEX;
+
+    try {
+        h = sql_join("JOIN", table, on, nullptr, sel, pparams);
+    }
+    catch (const std::exception& ex) {
+        XLL_ERROR(ex.what());
+    }
+
+    return h;
+}
+
+AddIn xai_sql_left_join(
+    Function(XLL_HANDLE, "xll_sql_left_join", "SQL.LEFT_JOIN")
+    .Arguments({
+        Arg(XLL_CSTRING4, "table", "is the table to join."),
+        Arg(XLL_CSTRING4, "on", "is the join constraint expression."),
+        Arg(XLL_HANDLE, "from", "is a handle to a statement with a FROM clause."),
+        Arg(XLL_LPOPER4, "_params", "is an optional range of values for the ? placeholders in on."),
+        })
+    .Uncalced()
+    .Category(CATEGORY)
+    .FunctionHelp("Return a handle to a SQL statement with a LEFT JOIN ... ON clause.")
+    .HelpTopic("https://www.sqlite.org/syntax/join-clause.html")
+);
+HANDLEX WINAPI xll_sql_left_join(const char* table, const char* on, HANDLEX sel, const LPOPER4 pparams)
+{
+#pragma XLLEXPORT
+    HANDLEX h = INVALID_HANDLEX;
+
+    try {
+        h = sql_join("LEFT JOIN", table, on, nullptr, sel, pparams);
+    }
+    catch (const std::exception& ex) {
+        XLL_ERROR(ex.what());
+    }
+
+    return h;
+}
+
+AddIn xai_sql_join_using(
+    Function(XLL_HANDLE, "xll_sql_join_using", "SQL.JOIN.USING")
+    .Arguments({
+        Arg(XLL_CSTRING4, "table", "is the table to join."),
+        Arg(XLL_LPOPER4, "columns", "is a range of column names common to both tables."),
+        Arg(XLL_HANDLE, "from", "is a handle to a statement with a FROM clause."),
+        Arg(XLL_BOOL, "_left", "is an optional boolean indicating a LEFT JOIN. Default is false."),
+        })
+    .Uncalced()
+    .Category(CATEGORY)
+    .FunctionHelp("Return a handle to a SQL statement with a JOIN ... USING clause.")
+    .HelpTopic("https://www.sqlite.org/syntax/join-clause.html")
+);
+HANDLEX WINAPI xll_sql_join_using(const char* table, const LPOPER4 pcols, HANDLEX sel, BOOL left)
 {
 #pragma XLLEXPORT
-    static OPER4 result;
-    result = ErrNA4;
+    HANDLEX h = INVALID_HANDLEX;
 
     try {
-        result = *psel;
-        result.resize(result.size(), 1);
-        result.push_bottom(OPER4("FROM ").append(table));
+        ensure(!pcols->is_missing() or !"SQL.JOIN.USING: columns must not be empty");
+        h = sql_join(left ? "LEFT JOIN" : "JOIN", table, nullptr, pcols, sel, nullptr);
     }
     catch (const std::exception& ex) {
         XLL_ERROR(ex.what());
     }
 
-    return &result;
+    return h;
 }
 
 AddIn xai_sql_where(
-    Function(XLL_LPOPER4, "xll_sql_where", "SQL.WHERE")
+    Function(XLL_HANDLE, "xll_sql_where", "SQL.WHERE")
     .Arguments({
         Arg(XLL_CSTRING4, "expr", "is an expresion."),
-        Arg(XLL_LPOPER4, "from", "is a FROM statement."),
+        Arg(XLL_HANDLE, "from", "is a handle to a statement with a FROM clause."),
+        Arg(XLL_LPOPER4, "_params", "is an optional range of values for the ? placeholders in expr."),
         })
-        .Category(CATEGORY)
-    .FunctionHelp("Return SQL where statement.")
+    .Uncalced()
+    .Category(CATEGORY)
+    .FunctionHelp("Return a handle to a SQL statement with a WHERE clause.")
     .HelpTopic("https://www.sqlite.org/syntax/select-core.html")
 );
-LPOPER4 WINAPI xll_sql_where(const char* expr, const LPOPER4 psel)
+HANDLEX WINAPI xll_sql_where(const char* expr, HANDLEX sel, const LPOPER4 pparams)
 {
 #pragma XLLEXPORT
-    static OPER4 result;
-    result = ErrNA4;
+    HANDLEX h = INVALID_HANDLEX;
 
     try {
-        result = *psel;
-        result.resize(result.size(), 1);
-        result.push_bottom(OPER4("WHERE ").append(expr));
+        handle<sqlite::builder> h_(sql_builder(sel));
+        h_->where = expr;
+        h_->params[sqlite::builder::WHERE] = sqlite_params(*pparams);
+        h = h_.get();
     }
     catch (const std::exception& ex) {
         XLL_ERROR(ex.what());
     }
 
-    return &result;
+    return h;
 }
 
 AddIn xai_sql_group_by(
-    Function(XLL_LPOPER4, "xll_sql_group_by", "SQL.GROUP_BY")
+    Function(XLL_HANDLE, "xll_sql_group_by", "SQL.GROUP_BY")
     .Arguments({
         Arg(XLL_LPOPER4, "exprs", "is a range of expresions."),
-        Arg(XLL_LPOPER4, "where", "is a WHERE statement."),
+        Arg(XLL_HANDLE, "where", "is a handle to a statement with a WHERE clause."),
         })
-        .Category(CATEGORY)
-    .FunctionHelp("Return SQL GROUP BY statement.")
+    .Uncalced()
+    .Category(CATEGORY)
+    .FunctionHelp("Return a handle to a SQL statement with a GROUP BY clause.")
     .HelpTopic("https://www.sqlite.org/syntax/select-core.html")
 );
-LPOPER4 WINAPI xll_sql_group_by(const LPOPER4 pexprs, const LPOPER4 psel)
+HANDLEX WINAPI xll_sql_group_by(const LPOPER4 pexprs, HANDLEX sel)
 {
 #pragma XLLEXPORT
-    static OPER4 result;
-    result = ErrNA4;
+    HANDLEX h = INVALID_HANDLEX;
 
     try {
-        OPER4 gb("GROUP BY ");
-        OPER4 comma("");
+        handle<sqlite::builder> h_(sql_builder(sel));
         for (const auto& expr : *pexprs) {
-            ensure(expr.is_str());
-            gb &= comma;
-            gb &= expr;
-            comma = ", ";
+            h_->group_by.emplace_back(view(expr));
         }
-        result = *psel;
-        result.resize(result.size(), 1);
-        result.push_bottom(gb);
+        h = h_.get();
     }
     catch (const std::exception& ex) {
         XLL_ERROR(ex.what());
     }
 
-    return &result;
+    return h;
 }
 
-// HAVING(expr)
-// ORDER_BY(exprs)
-// LIMIT(expr,...
-
-AddIn xai_create_table(
-    Function(XLL_HANDLE, "xll_create_table", "SQLITE.CREATE_TABLE")
+AddIn xai_sql_having(
+    Function(XLL_HANDLE, "xll_sql_having", "SQL.HAVING")
     .Arguments({
-        Arg(XLL_HANDLE, "handle", "is a handle to a database."),
-        Arg(XLL_CSTRING4, "table", "is the name of the table."),
-        Arg(XLL_LPOPER4, "names", "is an array of column names."),
-        Arg(XLL_LPOPER4, "types", "is an array of SQL types."),
-        Arg(XLL_LPOPER4, "_contraints", "is an optional array of contraints."),
+        Arg(XLL_CSTRING4, "expr", "is an expresion."),
+        Arg(XLL_HANDLE, "group_by", "is a handle to a statement with a GROUP BY clause."),
+        Arg(XLL_LPOPER4, "_params", "is an optional range of values for the ? placeholders in expr."),
         })
+    .Uncalced()
     .Category(CATEGORY)
-    .FunctionHelp("Create a table in a database and return handle.")
+    .FunctionHelp("Return a handle to a SQL statement with a HAVING clause.")
+    .HelpTopic("https://www.sqlite.org/syntax/select-core.html")
 );
-HANDLEX WINAPI xll_create_table(HANDLEX h, const char* table, 
-    const LPOPER4 pnames, const LPOPER4 ptypes, const LPOPER4 pconstraints)
+HANDLEX WINAPI xll_sql_having(const char* expr, HANDLEX sel, const LPOPER4 pparams)
 {
 #pragma XLLEXPORT
+    HANDLEX h = INVALID_HANDLEX;
+
     try {
-        ensure(pnames->size() == ptypes->size());
-        ensure(pconstraints->is_missing() or pnames->size() == pconstraints->size());
+        handle<sqlite::builder> h_(sql_builder(sel));
+        ensure(!h_->group_by.empty() or !"SQL.HAVING: statement must have a GROUP BY clause");
+        h_->having = expr;
+        h_->params[sqlite::builder::HAVING] = sqlite_params(*pparams);
+        h = h_.get();
+    }
+    catch (const std::exception& ex) {
+        XLL_ERROR(ex.what());
+    }
 
-        handle<sqlite::open> h_(h);
-        ensure(h_.ptr());
+    return h;
+}
 
-        std::string ct("CREATE TABLE ");
-        ct.append(table);
-        ct.append(" (");
-  
-        std::string comma = "";
-        const OPER4& name(*pnames);
-        const OPER4& type(*ptypes);
-		for (unsigned i = 0; i < pnames->size(); ++i) {
-			ensure(name[i].is_str());
-			ensure(type[i].is_str());
-			ct.append(comma);
-            ct.append(name[i].val.str + 1, name[i].val.str[0]);
-            ct.append(" ");
-            ct.append(type[i].val.str + 1, type[i].val.str[0]);
-            if (!pconstraints->is_missing()) {
-                const auto& ci = index(*pconstraints, i);
-                ensure(ci.is_str());
-                if (ci) {
-                    ct.append(" ");
-                    ct.append(ci.val.str + 1, ci.val.str[0]);
-                }
-            }
+AddIn xai_sql_order_by(
+    Function(XLL_HANDLE, "xll_sql_order_by", "SQL.ORDER_BY")
+    .Arguments({
+        Arg(XLL_LPOPER4, "exprs", "is a range of expresions optionally followed by ASC or DESC."),
+        Arg(XLL_HANDLE, "select", "is a handle to a SELECT statement."),
+        })
+    .Uncalced()
+    .Category(CATEGORY)
+    .FunctionHelp("Return a handle to a SQL statement with an ORDER BY clause.")
+    .HelpTopic("https://www.sqlite.org/lang_select.html#the_order_by_clause")
+);
+HANDLEX WINAPI xll_sql_order_by(const LPOPER4 pexprs, HANDLEX sel)
+{
+#pragma XLLEXPORT
+    HANDLEX h = INVALID_HANDLEX;
 
-            comma = ", ";
+    try {
+        handle<sqlite::builder> h_(sql_builder(sel));
+        h_->order_by.clear();
+        for (const auto& expr : *pexprs) {
+            h_->order_by.emplace_back(view(expr));
         }
-        ct.append(")");
+        h = h_.get();
+    }
+    catch (const std::exception& ex) {
+        XLL_ERROR(ex.what());
+    }
+
+    return h;
+}
+
+// Numbers are bound to a placeholder so statements differing only in
+// the limit share a prepared statement.
+static std::string sql_limit(const OPER4& o, std::vector<sqlite::param>& ps)
+{
+    if (o.is_num()) {
+        ps.push_back(sqlite_param(o));
+
+        return "?";
+    }
+    ensure(o.is_str() or !"SQL.LIMIT: limit and offset must be numbers or expressions");
+
+    return std::string(view(o));
+}
+
+AddIn xai_sql_limit(
+    Function(XLL_HANDLE, "xll_sql_limit", "SQL.LIMIT")
+    .Arguments({
+        Arg(XLL_LPOPER4, "limit", "is the maximum number of rows to return."),
+        Arg(XLL_HANDLE, "select", "is a handle to a SELECT statement."),
+        Arg(XLL_LPOPER4, "_offset", "is an optional number of rows to skip."),
+        })
+    .Uncalced()
+    .Category(CATEGORY)
+    .FunctionHelp("Return a handle to a SQL statement with a LIMIT clause.")
+    .HelpTopic("https://www.sqlite.org/lang_select.html#the_limit_clause")
+);
+HANDLEX WINAPI xll_sql_limit(const LPOPER4 plimit, HANDLEX sel, const LPOPER4 poffset)
+{
+#pragma XLLEXPORT
+    HANDLEX h = INVALID_HANDLEX;
 
-        sqlite_exec(*h_, ct.c_str());
+    try {
+        handle<sqlite::builder> h_(sql_builder(sel));
+        auto& ps = h_->params[sqlite::builder::LIMIT];
+        ps.clear();
+        h_->limit = sql_limit(*plimit, ps);
+        h_->offset = poffset->is_missing() ? "" : sql_limit(*poffset, ps);
+        h = h_.get();
     }
     catch (const std::exception& ex) {
         XLL_ERROR(ex.what());
@@ -269,88 +458,1687 @@ HANDLEX WINAPI xll_create_table(HANDLEX h, const char* table,
     return h;
 }
 
-AddIn xai_sqlite_exec(
-    Function(XLL_LPOPER4, "xll_sqlite_exec", "SQLITE.EXEC")
+// Append select2 to a copy of select using a compound operator.
+static HANDLEX sql_compound(const char* op, HANDLEX sel, HANDLEX sel2)
+{
+    handle<sqlite::builder> h_(sql_builder(sel));
+    auto b = std::shared_ptr<const sqlite::builder>(sql_builder(sel2));
+    ensure((h_->order_by.empty() and h_->limit.empty())
+        or !"SQL.UNION: ORDER BY and LIMIT must be applied after compound operators");
+    ensure((b->with.empty() and b->compounds.empty() and b->order_by.empty() and b->limit.empty())
+        or !"SQL.UNION: second statement must be a simple SELECT");
+    h_->compounds.push_back({op, b});
+
+    return h_.get();
+}
+
+AddIn xai_sql_union(
+    Function(XLL_HANDLE, "xll_sql_union", "SQL.UNION")
     .Arguments({
-        Arg(XLL_HANDLE, "handle", "is the sqlite3 database handle returned by SQLITE.OPEN."),
-        Arg(XLL_LPOPER4, "sql", "is the SQL query to execute on the database."),
-        Arg(XLL_BOOL, "_headers", "is an optional argument to specify if headers should be included. Default is false."),
+        Arg(XLL_HANDLE, "select", "is a handle to a SELECT statement."),
+        Arg(XLL_HANDLE, "select2", "is a handle to a SELECT statement with the same number of columns."),
+        Arg(XLL_BOOL, "_all", "is an optional boolean indicating duplicate rows are kept. Default is false."),
         })
-    .FunctionHelp("Return the result of executing a SQL command on a database.")
+    .Uncalced()
     .Category(CATEGORY)
-    .HelpTopic("https://www.sqlite.org/c3ref/exec.html")
-    .Documentation("")
+    .FunctionHelp("Return a handle to the UNION of two SELECT statements.")
+    .HelpTopic("https://www.sqlite.org/syntax/compound-operator.html")
 );
-LPOPER4 WINAPI xll_sqlite_exec(HANDLEX h, const LPOPER4 psql, BOOL headers)
+HANDLEX WINAPI xll_sql_union(HANDLEX sel, HANDLEX sel2, BOOL all)
 {
 #pragma XLLEXPORT
-    static OPER4 o;
-    o = ErrNA4;
+    HANDLEX h = INVALID_HANDLEX;
 
     try {
-        std::string sql;
-        for (const auto& s : *psql) {
-            ensure(s.is_str());
-            sql.append(s.val.str + 1, s.val.str[0]);
-            sql.append(" ");
-        }
+        h = sql_compound(all ? "UNION ALL" : "UNION", sel, sel2);
+    }
+    catch (const std::exception& ex) {
+        XLL_ERROR(ex.what());
+    }
 
-        handle<sqlite::open> h_(h);
-        ensure (h_.ptr());
-        
-        o = sqlite_exec(*h_, sql.c_str(), headers);
+    return h;
+}
+
+AddIn xai_sql_intersect(
+    Function(XLL_HANDLE, "xll_sql_intersect", "SQL.INTERSECT")
+    .Arguments({
+        Arg(XLL_HANDLE, "select", "is a handle to a SELECT statement."),
+        Arg(XLL_HANDLE, "select2", "is a handle to a SELECT statement with the same number of columns."),
+        })
+    .Uncalced()
+    .Category(CATEGORY)
+    .FunctionHelp("Return a handle to the rows common to two SELECT statements.")
+    .HelpTopic("https://www.sqlite.org/syntax/compound-operator.html")
+);
+HANDLEX WINAPI xll_sql_intersect(HANDLEX sel, HANDLEX sel2)
+{
+#pragma XLLEXPORT
+    HANDLEX h = INVALID_HANDLEX;
+
+    try {
+        h = sql_compound("INTERSECT", sel, sel2);
     }
     catch (const std::exception& ex) {
         XLL_ERROR(ex.what());
     }
 
-    return &o;
+    return h;
 }
 
-#if 0
-AddIn xai_sqlite_table_info(
-    Function(XLL_LPOPER, "?xll_sqlite_table_info", "SQLITE.TABLE.INFO")
-    .Arg(XLL_HANDLE, "handle", "is the sqlite3 database handle returned by SQLITE.DB.")
-    .Arg(XLL_CSTRING4, "table", "is the name of a table in the database.")
-    .Arg(XLL_BOOL, "?headers", "is an optional argument to specify if headers should be included. Default is false.")
-    .FunctionHelp("Return the cid, name, type, default value, and whether it is a primary key.")
-    .Category("SQLITE")
-    .Documentation("")
+AddIn xai_sql_except(
+    Function(XLL_HANDLE, "xll_sql_except", "SQL.EXCEPT")
+    .Arguments({
+        Arg(XLL_HANDLE, "select", "is a handle to a SELECT statement."),
+        Arg(XLL_HANDLE, "select2", "is a handle to a SELECT statement with the same number of columns."),
+        })
+    .Uncalced()
+    .Category(CATEGORY)
+    .FunctionHelp("Return a handle to the rows of select that are not in select2.")
+    .HelpTopic("https://www.sqlite.org/syntax/compound-operator.html")
 );
-LPOPER WINAPI xll_sqlite_table_info(handlex h, const char* table, BOOL headers)
+HANDLEX WINAPI xll_sql_except(HANDLEX sel, HANDLEX sel2)
 {
 #pragma XLLEXPORT
-    static OPER o;
+    HANDLEX h = INVALID_HANDLEX;
 
     try {
-        std::string sql = "PRAGMA table_info(";
-        sql.append(table);
-        sql.append(")");
-        handle<sqlite::db> h_(h);
-        ensure(h_.ptr());
-        o = sqlite_range(*h_, sql.c_str(), headers);
+        h = sql_compound("EXCEPT", sel, sel2);
     }
     catch (const std::exception& ex) {
         XLL_ERROR(ex.what());
     }
 
-    return &o;
+    return h;
+}
+
+AddIn xai_sql_with(
+    Function(XLL_HANDLE, "xll_sql_with", "SQL.WITH")
+    .Arguments({
+        Arg(XLL_CSTRING4, "name", "is the name of the common table expression, optionally followed by column names in parentheses."),
+        Arg(XLL_HANDLE, "cte", "is a handle to the SELECT statement defining name."),
+        Arg(XLL_HANDLE, "select", "is a handle to a SELECT statement that can refer to name."),
+        Arg(XLL_BOOL, "_recursive", "is an optional boolean indicating WITH RECURSIVE. Default is false."),
+        })
+    .Uncalced()
+    .Category(CATEGORY)
+    .FunctionHelp("Return a handle to a SQL statement with a common table expression.")
+    .HelpTopic("https://www.sqlite.org/lang_with.html")
+);
+HANDLEX WINAPI xll_sql_with(const char* name, HANDLEX cte, HANDLEX sel, BOOL recursive)
+{
+#pragma XLLEXPORT
+    HANDLEX h = INVALID_HANDLEX;
+
+    try {
+        handle<sqlite::builder> h_(sql_builder(sel));
+        h_->with.push_back({name, std::shared_ptr<const sqlite::builder>(sql_builder(cte))});
+        h_->recursive = h_->recursive or recursive;
+        h = h_.get();
+    }
+    catch (const std::exception& ex) {
+        XLL_ERROR(ex.what());
+    }
+
+    return h;
 }
 
-#ifdef _DEBUG
+AddIn xai_sql_text(
+    Function(XLL_LPOPER, "xll_sql_text", "SQL.TEXT")
+    .Arguments({
+        Arg(XLL_HANDLE, "handle", "is a handle to a SQL statement."),
+        })
+    .Category(CATEGORY)
+    .FunctionHelp("Return the SQL text of a statement handle.")
+);
+LPOPER WINAPI xll_sql_text(HANDLEX h)
+{
+#pragma XLLEXPORT
+    static OPER o;
+    o = ErrNA;
+
+    try {
+        handle<sqlite::builder> h_(h);
+        ensure(h_.ptr());
 
-xll::test test_sqlite_range([]{
-    char dir[1024];
-    GetCurrentDirectoryA(1023, dir);
-    const char* file = "C:/Users/kal/Source/Repos/keithalewis/xllsqlite/chinook.db";
-    const char* sql = "PRAGMA table_info(artists);";
-    sqlite::db db(file);
-    sqlite::db::stmt stmt(db);
-    OPER o;
-    o = sqlite_range(db, sql, true);
-    o = o;
+        std::wstring sql = widen(h_->sql().c_str(), static_cast<int>(h_->sql().size()));
+        o = OPER(sql.c_str(), sql.size());
+    }
+    catch (const std::exception& ex) {
+        XLL_ERROR(ex.what());
+    }
 
-});
+    return &o;
+}
 
-#endif // _DEBUG
-#endif // 0
+AddIn xai_create_table(
+    Function(XLL_HANDLE, "xll_create_table", "SQLITE.CREATE_TABLE")
+    .Arguments({
+        Arg(XLL_HANDLE, "handle", "is a handle to a database."),
+        Arg(XLL_CSTRING4, "table", "is the name of the table."),
+        Arg(XLL_LPOPER4, "names", "is an array of column names."),
+        Arg(XLL_LPOPER4, "types", "is an array of SQL types."),
+        Arg(XLL_LPOPER4, "_contraints", "is an optional array of contraints."),
+        })
+    .Category(CATEGORY)
+    .FunctionHelp("Create a table in a database and return handle.")
+);
+HANDLEX WINAPI xll_create_table(HANDLEX h, const char* table, 
+    const LPOPER4 pnames, const LPOPER4 ptypes, const LPOPER4 pconstraints)
+{
+#pragma XLLEXPORT
+    try {
+        ensure(pnames->size() == ptypes->size());
+        ensure(pconstraints->is_missing() or pnames->size() == pconstraints->size());
+
+        handle<sqlite::open> h_(h);
+        ensure(h_.ptr());
+
+        std::vector<sqlite::column_def> columns;
+        const OPER4& name(*pnames);
+        const OPER4& type(*ptypes);
+		for (unsigned i = 0; i < pnames->size(); ++i) {
+			ensure(name[i].is_str());
+			ensure(type[i].is_str());
+            sqlite::column_def col;
+            col.name = view(name[i]);
+            col.type = view(type[i]);
+            if (!pconstraints->is_missing()) {
+                col.constraint = view(index(*pconstraints, i));
+            }
+            columns.push_back(col);
+        }
+
+        sqlite::create_table(*h_, table, columns);
+    }
+    catch (const std::exception& ex) {
+        XLL_ERROR(ex.what());
+    }
+
+    return h;
+}
+
+AddIn xai_create_index(
+    Function(XLL_HANDLE, "xll_create_index", "SQLITE.CREATE_INDEX")
+    .Arguments({
+        Arg(XLL_HANDLE, "handle", "is a handle to a database."),
+        Arg(XLL_CSTRING4, "index", "is the name of the index."),
+        Arg(XLL_CSTRING4, "table", "is the name of the table."),
+        Arg(XLL_LPOPER4, "columns", "is an array of column names or expressions, optionally followed by ASC or DESC."),
+        Arg(XLL_BOOL, "_unique", "is an optional boolean indicating the indexed values must be unique. Default is false."),
+        Arg(XLL_CSTRING4, "_where", "is an optional expression limiting the rows indexed by a partial index."),
+        })
+    .Category(CATEGORY)
+    .FunctionHelp("Create an index on a table and return the database handle.")
+    .HelpTopic("https://www.sqlite.org/lang_createindex.html")
+    .Documentation("More than one column makes a covering index for queries using only those columns. "
+        "Expressions such as lower(Name) make an expression index. "
+        "Names are used as SQL, so put double quotes around names that are not identifiers.")
+);
+HANDLEX WINAPI xll_create_index(HANDLEX h, const char* index, const char* table,
+    const LPOPER4 pcolumns, BOOL unique, const char* where)
+{
+#pragma XLLEXPORT
+    try {
+        handle<sqlite::open> h_(h);
+        ensure(h_.ptr());
+
+        std::vector<std::string_view> columns;
+        for (const auto& col : *pcolumns) {
+            ensure(col.is_str() or !"SQLITE.CREATE_INDEX: columns must be strings");
+            columns.push_back(view(col));
+        }
+        ensure(!columns.empty() or !"SQLITE.CREATE_INDEX: no columns");
+
+        sqlite::create_index(*h_, index, table, columns, unique != FALSE, where);
+    }
+    catch (const std::exception& ex) {
+        XLL_ERROR(ex.what());
+    }
+
+    return h;
+}
+
+AddIn xai_drop_index(
+    Function(XLL_HANDLE, "xll_drop_index", "SQLITE.DROP_INDEX")
+    .Arguments({
+        Arg(XLL_HANDLE, "handle", "is a handle to a database."),
+        Arg(XLL_CSTRING4, "index", "is the name of the index."),
+        })
+    .Category(CATEGORY)
+    .FunctionHelp("Drop an index and return the database handle.")
+    .HelpTopic("https://www.sqlite.org/lang_dropindex.html")
+);
+HANDLEX WINAPI xll_drop_index(HANDLEX h, const char* index)
+{
+#pragma XLLEXPORT
+    try {
+        handle<sqlite::open> h_(h);
+        ensure(h_.ptr());
+
+        sqlite::drop_index(*h_, index);
+    }
+    catch (const std::exception& ex) {
+        XLL_ERROR(ex.what());
+    }
+
+    return h;
+}
+
+AddIn xai_sqlite_indexes(
+    Function(XLL_LPOPER4, "xll_sqlite_indexes", "SQLITE.INDEXES")
+    .Arguments({
+        Arg(XLL_HANDLE, "handle", "is a handle to a database."),
+        Arg(XLL_CSTRING4, "_table", "is an optional table name. Default is all tables."),
+        Arg(XLL_BOOL, "_headers", "is an optional argument to specify if headers should be included. Default is false."),
+        })
+    .Category(CATEGORY)
+    .FunctionHelp("Return the table, name, unique, partial, columns, and size in bytes of indexes.")
+    .HelpTopic("https://www.sqlite.org/dbstat.html")
+    .Documentation("Expression columns are shown as <expr>. Size is #N/A if the dbstat virtual table is not available.")
+);
+LPOPER4 WINAPI xll_sqlite_indexes(HANDLEX h, const char* table, BOOL headers)
+{
+#pragma XLLEXPORT
+    static OPER4 o;
+    o = ErrNA4;
+
+    try {
+        handle<sqlite::open> h_(h);
+        ensure(h_.ptr());
+
+        std::vector<std::pair<const sqlite::table_info*, const sqlite::index_info*>> indexes;
+        for (const auto& [name, t] : sqlite::schema(*h_).tables(*h_)) {
+            if (*table && sqlite3_stricmp(table, name.c_str()))
+                continue;
+            for (const auto& i : t.indexes)
+                indexes.emplace_back(&t, &i);
+        }
+
+        unsigned r = headers ? 1 : 0;
+        if (indexes.empty() && !headers) {
+            o = ErrNull4;
+        }
+        else {
+            auto bytes = sqlite::object_bytes(*h_);
+            o.resize(static_cast<unsigned>(indexes.size()) + r, 6);
+            if (headers) {
+                o(0, 0) = "table";
+                o(0, 1) = "index";
+                o(0, 2) = "unique";
+                o(0, 3) = "partial";
+                o(0, 4) = "columns";
+                o(0, 5) = "bytes";
+            }
+            for (const auto& [t, i] : indexes) {
+                std::string columns;
+                for (const auto& c : i->columns) {
+                    if (!columns.empty())
+                        columns.append(", ");
+                    columns.append(c.empty() ? "<expr>" : c);
+                }
+                // dbstat sizes objects of main
+                auto b = sqlite3_stricmp(t->schema.c_str(), "main") ? bytes.end() : bytes.find(i->name);
+
+                o(r, 0) = t->qualified_name().c_str();
+                o(r, 1) = i->name.c_str();
+                o(r, 2) = i->unique;
+                o(r, 3) = i->partial;
+                o(r, 4) = columns.c_str();
+                if (b != bytes.end())
+                    o(r, 5) = static_cast<double>(b->second);
+                else
+                    o(r, 5) = ErrNA4;
+                ++r;
+            }
+        }
+    }
+    catch (const std::exception& ex) {
+        XLL_ERROR(ex.what());
+    }
+
+    return &o;
+}
+
+// Two column range of import and export statistics.
+static OPER4 csv_stats(const sqlite::csv_stats& stats)
+{
+    OPER4 o(4, 2);
+
+    o(0, 0) = "rows";
+    o(0, 1) = static_cast<double>(stats.rows);
+    o(1, 0) = "bytes";
+    o(1, 1) = static_cast<double>(stats.bytes);
+    o(2, 0) = "seconds";
+    o(2, 1) = stats.seconds;
+    o(3, 0) = "MB/s";
+    o(3, 1) = stats.mb_per_sec();
+
+    return o;
+}
+
+AddIn xai_sqlite_import_csv(
+    Function(XLL_LPOPER4, "xll_sqlite_import_csv", "SQLITE.IMPORT_CSV")
+    .Arguments({
+        Arg(XLL_HANDLE, "handle", "is a handle to a database."),
+        Arg(XLL_CSTRING4, "table", "is the name of the table."),
+        Arg(XLL_CSTRING4, "file", "is the path of the delimited file."),
+        Arg(XLL_LPOPER4, "_options", "is an optional two column range of names and values for delimiter, header, create, sample, threads, and chunk."),
+        })
+    .Uncalced()
+    .Category(CATEGORY)
+    .FunctionHelp("Import a delimited file into a table and return rows, bytes, seconds, and MB/s.")
+);
+LPOPER4 WINAPI xll_sqlite_import_csv(HANDLEX h, const char* table, const char* file, const LPOPER4 poptions)
+{
+#pragma XLLEXPORT
+    static OPER4 o;
+    o = ErrNA4;
+
+    try {
+        handle<sqlite::open> h_(h);
+        ensure(h_.ptr());
+
+        sqlite::csv_options options;
+        if (!poptions->is_missing()) {
+            ensure(poptions->columns() == 2);
+            for (unsigned i = 0; i < poptions->rows(); ++i) {
+                std::string_view key = view((*poptions)(i, 0));
+                const OPER4& val = (*poptions)(i, 1);
+                if (key == "delimiter") {
+                    std::string_view d = view(val);
+                    ensure(d.size() == 1 or d == "\\t");
+                    options.delimiter = d.size() == 1 ? d[0] : '\t';
+                }
+                else if (key == "header") {
+                    ensure(val.type() == xltypeBool or val.is_num() or !"SQLITE.IMPORT_CSV: header must be a boolean");
+                    options.header = val.type() == xltypeBool ? val.val.xbool != 0 : val.val.num != 0;
+                }
+                else if (key == "create") {
+                    ensure(val.type() == xltypeBool or val.is_num() or !"SQLITE.IMPORT_CSV: create must be a boolean");
+                    options.create = val.type() == xltypeBool ? val.val.xbool != 0 : val.val.num != 0;
+                }
+                else if (key == "sample") {
+                    ensure((val.is_num() and val.val.num >= 0) or !"SQLITE.IMPORT_CSV: sample must be a non-negative number");
+                    options.sample = static_cast<size_t>(val.val.num);
+                }
+                else if (key == "threads") {
+                    ensure((val.is_num() and val.val.num >= 0) or !"SQLITE.IMPORT_CSV: threads must be a non-negative number");
+                    options.threads = static_cast<unsigned>(val.val.num);
+                }
+                else if (key == "chunk") {
+                    ensure((val.is_num() and val.val.num >= 1) or !"SQLITE.IMPORT_CSV: chunk must be a positive number");
+                    options.chunk = static_cast<size_t>(val.val.num);
+                }
+                else {
+                    ensure(!"SQLITE.IMPORT_CSV: unknown option");
+                }
+            }
+        }
+
+        o = csv_stats(sqlite::import_csv(*h_, table, file, options));
+    }
+    catch (const std::exception& ex) {
+        XLL_ERROR(ex.what());
+    }
+
+    return &o;
+}
+
+AddIn xai_sqlite_export(
+    Function(XLL_LPOPER4, "xll_sqlite_export", "SQLITE.EXPORT")
+    .Arguments({
+        Arg(XLL_HANDLE, "handle", "is a handle to a database."),
+        Arg(XLL_LPOPER4, "sql", "is the SQL query to export or a range of lines of SQL text."),
+        Arg(XLL_CSTRING4, "file", "is the path of the file to write."),
+        Arg(XLL_CSTRING4, "_format", "is an optional format of \"csv\" or \"tsv\". Default is \"csv\"."),
+        })
+    .Uncalced()
+    .Category(CATEGORY)
+    .FunctionHelp("Write the result of a query to a file and return rows, bytes, seconds, and MB/s.")
+);
+LPOPER4 WINAPI xll_sqlite_export(HANDLEX h, const LPOPER4 psql, const char* file, const char* format)
+{
+#pragma XLLEXPORT
+    static OPER4 o;
+    o = ErrNA4;
+
+    try {
+        handle<sqlite::open> h_(h);
+        ensure(h_.ptr());
+
+        sqlite::csv_options options;
+        std::string_view fmt(format);
+        ensure(fmt.empty() or fmt == "csv" or fmt == "tsv");
+        if (fmt == "tsv")
+            options.delimiter = '\t';
+
+        std::string sql;
+        for (const auto& s : *psql) {
+            ensure(s.is_str());
+            sql.append(s.val.str + 1, s.val.str[0]);
+            sql.append(" ");
+        }
+
+        o = csv_stats(sqlite::export_csv(*h_, sql.c_str(), file, options));
+    }
+    catch (const std::exception& ex) {
+        XLL_ERROR(ex.what());
+    }
+
+    return &o;
+}
+
+AddIn xai_sqlite_exec(
+    Function(XLL_LPOPER4, "xll_sqlite_exec", "SQLITE.EXEC")
+    .Arguments({
+        Arg(XLL_HANDLE, "handle", "is the sqlite3 database handle returned by SQLITE.OPEN."),
+        Arg(XLL_LPOPER4, "sql", "is the SQL query to execute on the database or a handle returned by the SQL.* functions."),
+        Arg(XLL_BOOL, "_headers", "is an optional argument to specify if headers should be included. Default is false."),
+        Arg(XLL_LPOPER4, "_params", "is an optional range of parameters to bind to ?1, ?2, .... A range with more than one row binds each column as an array for use in carray(?n)."),
+        })
+    .FunctionHelp("Return the result of executing a SQL command on a database.")
+    .Category(CATEGORY)
+    .HelpTopic("https://www.sqlite.org/c3ref/exec.html")
+    .Documentation("")
+);
+LPOPER4 WINAPI xll_sqlite_exec(HANDLEX h, const LPOPER4 psql, BOOL headers, const LPOPER4 pparams)
+{
+#pragma XLLEXPORT
+    static OPER4 o;
+    o = ErrNA4;
+
+    try {
+        handle<sqlite::open> h_(h);
+        ensure (h_.ptr());
+
+        // handle to a SQL statement or lines of SQL text
+        // with literals extracted so they share a prepared statement
+        const sqlite::builder* pb = nullptr;
+        sqlite::fingerprint fp;
+        if (psql->is_num()) {
+            handle<sqlite::builder> b_(psql->val.num);
+            ensure(b_.ptr());
+            pb = b_.ptr();
+        }
+        else {
+            std::string sql;
+            for (const auto& s : *psql) {
+                ensure(s.is_str());
+                sql.append(s.val.str + 1, s.val.str[0]);
+                sql.append(" ");
+            }
+            fp.normalize(sql);
+        }
+
+        sqlite::cached stmt(*h_, pb ? pb->sql() : fp.sql);
+
+        // builder placeholders or literals come before user parameters
+        int n = pb ? pb->bind(stmt) : fp.bind(stmt);
+        std::vector<sqlite::carray> arrays;
+        if (!pparams->is_missing())
+            arrays = sqlite_bind(stmt, *pparams, n + 1);
+
+        o = sqlite_exec(stmt, headers);
+        sqlite::observe(*h_, stmt);
+    }
+    catch (const std::exception& ex) {
+        XLL_ERROR(ex.what());
+    }
+
+    return &o;
+}
+
+AddIn xai_sqlite_exec_many(
+    Function(XLL_LPOPER4, "xll_sqlite_exec_many", "SQLITE.EXEC_MANY")
+    .Arguments({
+        Arg(XLL_HANDLE, "handle", "is the sqlite3 database handle returned by SQLITE.OPEN."),
+        Arg(XLL_LPOPER4, "sql", "is the SQL statement to execute or a handle returned by the SQL.* functions."),
+        Arg(XLL_LPOPER4, "params", "is a range with one row of parameters for ?1, ?2, ... per execution."),
+        Arg(XLL_BOOL, "_headers", "is an optional argument to specify if headers should be included. Default is false."),
+        })
+    .FunctionHelp("Execute a SQL statement once for each row of parameters.")
+    .Category(CATEGORY)
+    .HelpTopic("https://www.sqlite.org/c3ref/reset.html")
+    .Documentation("The statement is prepared once then reset, bound, and stepped for each row of params. "
+        "A query returns the rows of every execution stacked with the parameter row number, starting at 1, "
+        "in the first column. Other statements return the number of rows changed by each execution. "
+        "Statements that write run in a savepoint so either all rows are applied or none.")
+);
+LPOPER4 WINAPI xll_sqlite_exec_many(HANDLEX h, const LPOPER4 psql, const LPOPER4 pparams, BOOL headers)
+{
+#pragma XLLEXPORT
+    static OPER4 o;
+    o = ErrNA4;
+
+    try {
+        handle<sqlite::open> h_(h);
+        ensure(h_.ptr());
+        ensure(!pparams->is_missing() or !"SQLITE.EXEC_MANY: params is required");
+
+        const sqlite::builder* pb = nullptr;
+        sqlite::fingerprint fp;
+        if (psql->is_num()) {
+            handle<sqlite::builder> b_(psql->val.num);
+            ensure(b_.ptr());
+            pb = b_.ptr();
+        }
+        else {
+            std::string sql;
+            for (const auto& s : *psql) {
+                ensure(s.is_str());
+                sql.append(s.val.str + 1, s.val.str[0]);
+                sql.append(" ");
+            }
+            fp.normalize(sql);
+        }
+
+        sqlite::cached stmt(*h_, pb ? pb->sql() : fp.sql);
+        // placeholders before the user parameters keep their values across resets
+        int n = pb ? pb->bind(stmt) : fp.bind(stmt);
+        auto bind = [pparams, n](sqlite3_stmt* stmt, unsigned i) {
+            sqlite_bind_row(stmt, *pparams, i, n + 1);
+        };
+        OPER4 x = sqlite::exec_many<OPER4, OPER4>(*h_, stmt, pparams->rows(), bind, headers != FALSE,
+            ErrNull4, ErrNA4, sqlite_max_rows4);
+        sqlite::observe(*h_, stmt);
+        // no rows is #N/A
+        if (x.type() == xltypeMulti)
+            o = x;
+    }
+    catch (const std::exception& ex) {
+        XLL_ERROR(ex.what());
+    }
+
+    return &o;
+}
+
+AddIn xai_sqlite_fingerprint(
+    Function(XLL_LPOPER, "xll_sqlite_fingerprint", "SQLITE.FINGERPRINT")
+    .Arguments({
+        Arg(XLL_LPOPER4, "sql", "is the SQL text or a range of lines of SQL text."),
+        })
+    .FunctionHelp("Return the normalized SQL used as the statement cache key and its 64-bit hash in hexadecimal.")
+    .Category(CATEGORY)
+    .Documentation("Whitespace, comments and keyword case are normalized and literals are replaced by ?. "
+        "Statements differing only in literal values have the same fingerprint.")
+);
+LPOPER WINAPI xll_sqlite_fingerprint(const LPOPER4 psql)
+{
+#pragma XLLEXPORT
+    static OPER o;
+    o = ErrNA;
+
+    try {
+        std::string sql;
+        for (const auto& s : *psql) {
+            ensure(s.is_str());
+            sql.append(s.val.str + 1, s.val.str[0]);
+            sql.append(" ");
+        }
+        sqlite::fingerprint fp(sql);
+
+        wchar_t hash[17];
+        swprintf(hash, 17, L"%016llx", static_cast<unsigned long long>(fp.hash()));
+        std::wstring text = widen(fp.sql.c_str(), static_cast<int>(fp.sql.size()));
+        o.resize(1, 2);
+        o[0] = OPER(text.c_str(), text.size());
+        o[1] = OPER(hash);
+    }
+    catch (const std::exception& ex) {
+        XLL_ERROR(ex.what());
+    }
+
+    return &o;
+}
+
+AddIn xai_sqlite_exec12(
+    Function(XLL_LPOPER, "xll_sqlite_exec12", "SQLITE.EXEC12")
+    .Arguments({
+        Arg(XLL_HANDLE, "handle", "is the sqlite3 database handle returned by SQLITE.OPEN."),
+        Arg(XLL_LPOPER, "sql", "is the SQL query to execute on the database or a handle returned by the SQL.* functions."),
+        Arg(XLL_BOOL, "_headers", "is an optional argument to specify if headers should be included. Default is false."),
+        Arg(XLL_LPOPER, "_params", "is an optional range of parameters to bind to ?1, ?2, .... A range with more than one row binds each column as an array for use in carray(?n)."),
+        })
+    .FunctionHelp("Return the result of executing a SQL command on a database with up to 1048576 rows and long text.")
+    .Category(CATEGORY)
+    .HelpTopic("https://www.sqlite.org/c3ref/column_blob.html")
+    .Documentation("Like SQLITE.EXEC but returns Excel 2007 strings and ranges read with sqlite3_column_text16.")
+);
+LPOPER WINAPI xll_sqlite_exec12(HANDLEX h, const LPOPER psql, BOOL headers, const LPOPER pparams)
+{
+#pragma XLLEXPORT
+    static OPER o;
+    o = ErrNA;
+
+    try {
+        handle<sqlite::open> h_(h);
+        ensure(h_.ptr());
+
+        // handle to a SQL statement or lines of SQL text
+        const sqlite::builder* pb = nullptr;
+        sqlite::fingerprint fp;
+        if (psql->is_num()) {
+            handle<sqlite::builder> b_(psql->val.num);
+            ensure(b_.ptr());
+            pb = b_.ptr();
+        }
+        else {
+            std::wstring wsql;
+            for (const auto& s : *psql) {
+                wsql.append(view(s));
+                wsql.append(L" ");
+            }
+            utf::to_utf8<> sql(wsql.data(), wsql.size());
+            fp.normalize(std::string_view(sql.data(), sql.size()));
+        }
+
+        sqlite::cached stmt(*h_, pb ? pb->sql() : fp.sql);
+
+        int n = pb ? pb->bind(stmt) : fp.bind(stmt);
+        std::vector<sqlite::carray> arrays;
+        if (!pparams->is_missing())
+            arrays = sqlite_bind(stmt, *pparams, n + 1);
+
+        o = sqlite_exec12(stmt, headers);
+        sqlite::observe(*h_, stmt);
+    }
+    catch (const std::exception& ex) {
+        XLL_ERROR(ex.what());
+    }
+
+    return &o;
+}
+
+AddIn xai_sqlite_tables(
+    Function(XLL_LPOPER4, "xll_sqlite_tables", "SQLITE.TABLES")
+    .Arguments({
+        Arg(XLL_HANDLE, "handle", "is the sqlite3 database handle returned by SQLITE.OPEN."),
+        Arg(XLL_BOOL, "_headers", "is an optional argument to specify if headers should be included. Default is false."),
+        })
+    .FunctionHelp("Return the name and type of the tables and views in the database.")
+    .Category(CATEGORY)
+    .HelpTopic("https://www.sqlite.org/schematab.html")
+    .Documentation("Names in temp and attached databases are qualified by the schema name. "
+        "Metadata is cached with the connection and reloaded only when PRAGMA schema_version changes.")
+);
+LPOPER4 WINAPI xll_sqlite_tables(HANDLEX h, BOOL headers)
+{
+#pragma XLLEXPORT
+    static OPER4 o;
+    o = ErrNA4;
+
+    try {
+        handle<sqlite::open> h_(h);
+        ensure(h_.ptr());
+
+        const auto& tables = sqlite::schema(*h_).tables(*h_);
+        ensure(!tables.empty() or !"SQLITE.TABLES: no tables in database");
+
+        unsigned r = headers ? 1 : 0;
+        o.resize(static_cast<unsigned>(tables.size()) + r, 2);
+        if (headers) {
+            o(0, 0) = "name";
+            o(0, 1) = "type";
+        }
+        for (const auto& [name, t] : tables) {
+            o(r, 0) = name.c_str();
+            o(r, 1) = t.type.c_str();
+            ++r;
+        }
+    }
+    catch (const std::exception& ex) {
+        XLL_ERROR(ex.what());
+    }
+
+    return &o;
+}
+
+AddIn xai_sqlite_table_info(
+    Function(XLL_LPOPER4, "xll_sqlite_table_info", "SQLITE.TABLE.INFO")
+    .Arguments({
+        Arg(XLL_HANDLE, "handle", "is the sqlite3 database handle returned by SQLITE.OPEN."),
+        Arg(XLL_CSTRING4, "table", "is the name of a table or view in the database."),
+        Arg(XLL_BOOL, "_headers", "is an optional argument to specify if headers should be included. Default is false."),
+        })
+    .FunctionHelp("Return the cid, name, type, not null, default value, and primary key position of each column.")
+    .Category(CATEGORY)
+    .HelpTopic("https://www.sqlite.org/pragma.html#pragma_table_info")
+    .Documentation("Like PRAGMA table_info but read from metadata cached with the connection.")
+);
+LPOPER4 WINAPI xll_sqlite_table_info(HANDLEX h, const char* table, BOOL headers)
+{
+#pragma XLLEXPORT
+    static OPER4 o;
+    o = ErrNA4;
+
+    try {
+        handle<sqlite::open> h_(h);
+        ensure(h_.ptr());
+
+        const sqlite::table_info* t = sqlite::schema(*h_).table(*h_, table);
+        ensure(t or !"SQLITE.TABLE.INFO: no such table");
+
+        unsigned r = headers ? 1 : 0;
+        o.resize(static_cast<unsigned>(t->columns.size()) + r, 6);
+        if (headers) {
+            o(0, 0) = "cid";
+            o(0, 1) = "name";
+            o(0, 2) = "type";
+            o(0, 3) = "notnull";
+            o(0, 4) = "dflt_value";
+            o(0, 5) = "pk";
+        }
+        for (const auto& c : t->columns) {
+            o(r, 0) = c.cid;
+            o(r, 1) = c.name.c_str();
+            o(r, 2) = c.type.c_str();
+            o(r, 3) = c.notnull;
+            if (c.has_default)
+                o(r, 4) = c.dflt_value.c_str();
+            else
+                o(r, 4) = ErrNull4;
+            o(r, 5) = c.pk;
+            ++r;
+        }
+    }
+    catch (const std::exception& ex) {
+        XLL_ERROR(ex.what());
+    }
+
+    return &o;
+}
+
+AddIn xai_sqlite_advisor_watch(
+    Function(XLL_BOOL, "xll_sqlite_advisor_watch", "SQLITE.ADVISOR.WATCH")
+    .Arguments({
+        Arg(XLL_HANDLE, "handle", "is the sqlite3 database handle returned by SQLITE.OPEN."),
+        Arg(XLL_BOOL, "watch", "is a boolean indicating whether statements run by SQLITE.EXEC are watched."),
+        Arg(XLL_LONG, "_threshold", "is an optional number of full scan steps that make a statement worth a look. Default is 1000."),
+        })
+    .Uncalced()
+    .Category(CATEGORY)
+    .FunctionHelp("Start or stop collecting index recommendations for a database.")
+    .HelpTopic("https://www.sqlite.org/c3ref/c_stmtstatus_counter.html")
+);
+BOOL WINAPI xll_sqlite_advisor_watch(HANDLEX h, BOOL watch, LONG threshold)
+{
+#pragma XLLEXPORT
+    BOOL b = FALSE;
+
+    try {
+        handle<sqlite::open> h_(h);
+        ensure(h_.ptr());
+
+        auto& advisor = sqlite::advisor(*h_);
+        advisor.enabled = watch != FALSE;
+        if (threshold > 0)
+            advisor.threshold = threshold;
+        b = advisor.enabled;
+    }
+    catch (const std::exception& ex) {
+        XLL_ERROR(ex.what());
+    }
+
+    return b;
+}
+
+AddIn xai_sqlite_advisor(
+    Function(XLL_LPOPER, "xll_sqlite_advisor", "SQLITE.ADVISOR")
+    .Arguments({
+        Arg(XLL_HANDLE, "handle", "is the sqlite3 database handle returned by SQLITE.OPEN."),
+        Arg(XLL_BOOL, "_headers", "is an optional argument to specify if headers should be included. Default is false."),
+        })
+    .Category(CATEGORY)
+    .FunctionHelp("Return recommended CREATE INDEX statements ranked by rows visited without an index.")
+    .HelpTopic("https://www.sqlite.org/eqp.html")
+    .Documentation("Columns are savings, executions, the CREATE INDEX statement, and an example statement. "
+        "Use SQLITE.ADVISOR.WATCH to start collecting statements and recalculate to refresh.")
+);
+LPOPER WINAPI xll_sqlite_advisor(HANDLEX h, BOOL headers)
+{
+#pragma XLLEXPORT
+    static OPER o;
+    o = ErrNA;
+
+    try {
+        handle<sqlite::open> h_(h);
+        ensure(h_.ptr());
+
+        auto recs = sqlite::advisor(*h_).recommend(*h_);
+        unsigned r = headers ? 1 : 0;
+        if (recs.empty() && !headers) {
+            o = ErrNull;
+        }
+        else {
+            o.resize(static_cast<unsigned>(recs.size()) + r, 4);
+            if (headers) {
+                o(0, 0) = L"savings";
+                o(0, 1) = L"executions";
+                o(0, 2) = L"index";
+                o(0, 3) = L"statement";
+            }
+            for (const auto& rec : recs) {
+                o(r, 0) = static_cast<double>(rec.savings);
+                o(r, 1) = static_cast<double>(rec.executions);
+                std::wstring index = widen(rec.sql.c_str(), static_cast<int>(rec.sql.size()));
+                o(r, 2) = OPER(index.c_str(), index.size());
+                std::wstring stmt = widen(rec.statements[0].c_str(), static_cast<int>(rec.statements[0].size()));
+                o(r, 3) = OPER(stmt.c_str(), std::min<size_t>(stmt.size(), sqlite_max_chars12));
+                ++r;
+            }
+        }
+    }
+    catch (const std::exception& ex) {
+        XLL_ERROR(ex.what());
+    }
+
+    return &o;
+}
+
+AddIn xai_sqlite_advisor_apply(
+    Function(XLL_LPOPER, "xll_sqlite_advisor_apply", "SQLITE.ADVISOR.APPLY")
+    .Arguments({
+        Arg(XLL_HANDLE, "handle", "is the sqlite3 database handle returned by SQLITE.OPEN with SQLITE_OPEN_READWRITE."),
+        Arg(XLL_LONG, "_count", "is an optional number of recommendations to apply. Default is 1."),
+        Arg(XLL_LONG, "_repeat", "is an optional number of times each statement is timed. Default is 3."),
+        })
+    .Uncalced()
+    .Category(CATEGORY)
+    .FunctionHelp("Create the top recommended indexes and return a before and after timing report.")
+    .HelpTopic("https://www.sqlite.org/lang_createindex.html")
+    .Documentation("Columns are the CREATE INDEX statement, the statement timed, rows returned, "
+        "milliseconds before, milliseconds after, and speedup.")
+);
+LPOPER WINAPI xll_sqlite_advisor_apply(HANDLEX h, LONG count, LONG repeat)
+{
+#pragma XLLEXPORT
+    static OPER o;
+    o = ErrNA;
+
+    try {
+        handle<sqlite::open> h_(h);
+        ensure(h_.ptr());
+
+        auto report = sqlite::advisor(*h_).apply(*h_, count > 0 ? count : 1, repeat > 0 ? repeat : 3);
+        if (report.empty()) {
+            o = ErrNull;
+        }
+        else {
+            o.resize(static_cast<unsigned>(report.size()) + 1, 6);
+            o(0, 0) = L"index";
+            o(0, 1) = L"statement";
+            o(0, 2) = L"rows";
+            o(0, 3) = L"before_ms";
+            o(0, 4) = L"after_ms";
+            o(0, 5) = L"speedup";
+            unsigned r = 1;
+            for (const auto& b : report) {
+                std::wstring index = widen(b.index.c_str(), static_cast<int>(b.index.size()));
+                o(r, 0) = OPER(index.c_str(), index.size());
+                std::wstring stmt = widen(b.statement.c_str(), static_cast<int>(b.statement.size()));
+                o(r, 1) = OPER(stmt.c_str(), std::min<size_t>(stmt.size(), sqlite_max_chars12));
+                o(r, 2) = static_cast<double>(b.rows);
+                o(r, 3) = b.before * 1000;
+                o(r, 4) = b.after * 1000;
+                o(r, 5) = b.after > 0 ? b.before / b.after : 0;
+                ++r;
+            }
+        }
+    }
+    catch (const std::exception& ex) {
+        XLL_ERROR(ex.what());
+    }
+
+    return &o;
+}
+
+AddIn xai_sqlite_maintenance(
+    Function(XLL_BOOL, "xll_sqlite_maintenance", "SQLITE.MAINTENANCE")
+    .Arguments({
+        Arg(XLL_HANDLE, "handle", "is the sqlite3 database handle returned by SQLITE.OPEN with SQLITE_OPEN_READWRITE."),
+        Arg(XLL_BOOL, "enable", "is a boolean indicating whether maintenance runs in the background."),
+        Arg(XLL_LPOPER4, "_options", "is an optional two column range of names and values for idle, optimize, analyze, checkpoint, analysis_limit, mode, and busy_timeout."),
+        })
+    .Uncalced()
+    .Category(CATEGORY)
+    .FunctionHelp("Start or stop running PRAGMA optimize, ANALYZE, and WAL checkpoints when a database is idle.")
+    .HelpTopic("https://www.sqlite.org/pragma.html#pragma_optimize")
+    .Documentation("Maintenance uses a separate connection to the database file. "
+        "The idle, optimize, analyze, and checkpoint options are in seconds and 0 disables a task. "
+        "Defaults are 5, 3600, 86400, and 60. The checkpoint mode is passive, full, restart, or truncate. "
+        "Default is truncate. The analysis_limit option is the number of rows ANALYZE examines per index. Default is 400.")
+);
+BOOL WINAPI xll_sqlite_maintenance(HANDLEX h, BOOL enable, const LPOPER4 poptions)
+{
+#pragma XLLEXPORT
+    BOOL b = FALSE;
+
+    try {
+        handle<sqlite::open> h_(h);
+        ensure(h_.ptr());
+
+        if (!enable) {
+            sqlite::stop_maintenance(*h_);
+        }
+        else {
+            sqlite::maintenance_options options;
+            auto ms = [](const OPER4& val) {
+                ensure(val.is_num() or !"SQLITE.MAINTENANCE: intervals must be numbers of seconds");
+                return std::chrono::milliseconds(static_cast<long long>(val.val.num * 1000));
+            };
+            if (!poptions->is_missing()) {
+                ensure(poptions->columns() == 2);
+                for (unsigned i = 0; i < poptions->rows(); ++i) {
+                    std::string_view key = view((*poptions)(i, 0));
+                    const OPER4& val = (*poptions)(i, 1);
+                    if (key == "idle") {
+                        options.idle = ms(val);
+                    }
+                    else if (key == "optimize") {
+                        options.optimize = ms(val);
+                    }
+                    else if (key == "analyze") {
+                        options.analyze = ms(val);
+                    }
+                    else if (key == "checkpoint") {
+                        options.checkpoint = ms(val);
+                    }
+                    else if (key == "analysis_limit") {
+                        ensure(val.is_num() or !"SQLITE.MAINTENANCE: analysis_limit must be a number");
+                        options.analysis_limit = static_cast<int>(val.val.num);
+                    }
+                    else if (key == "mode") {
+                        std::string_view mode = view(val);
+                        if (mode == "passive")
+                            options.checkpoint_mode = SQLITE_CHECKPOINT_PASSIVE;
+                        else if (mode == "full")
+                            options.checkpoint_mode = SQLITE_CHECKPOINT_FULL;
+                        else if (mode == "restart")
+                            options.checkpoint_mode = SQLITE_CHECKPOINT_RESTART;
+                        else if (mode == "truncate")
+                            options.checkpoint_mode = SQLITE_CHECKPOINT_TRUNCATE;
+                        else
+                            ensure(!"SQLITE.MAINTENANCE: mode must be passive, full, restart, or truncate");
+                    }
+                    else if (key == "busy_timeout") {
+                        ensure(val.is_num() or !"SQLITE.MAINTENANCE: busy_timeout must be a number");
+                        options.busy_timeout = static_cast<int>(val.val.num);
+                    }
+                    else {
+                        ensure(!"SQLITE.MAINTENANCE: unknown option");
+                    }
+                }
+            }
+            sqlite::start_maintenance(*h_, options);
+        }
+        b = h_->maintenance != nullptr;
+    }
+    catch (const std::exception& ex) {
+        XLL_ERROR(ex.what());
+    }
+
+    return b;
+}
+
+AddIn xai_sqlite_maintenance_status(
+    Function(XLL_LPOPER, "xll_sqlite_maintenance_status", "SQLITE.MAINTENANCE.STATUS")
+    .Arguments({
+        Arg(XLL_HANDLE, "handle", "is the sqlite3 database handle returned by SQLITE.OPEN."),
+        })
+    .Category(CATEGORY)
+    .FunctionHelp("Return a two column range of names and values describing background maintenance.")
+    .HelpTopic("https://www.sqlite.org/c3ref/wal_checkpoint_v2.html")
+    .Documentation("Each task has runs, errors, last run as an Excel date, seconds taken, and the last error. "
+        "Recalculate to refresh.")
+);
+LPOPER WINAPI xll_sqlite_maintenance_status(HANDLEX h)
+{
+#pragma XLLEXPORT
+    static OPER o;
+    o = ErrNA;
+
+    try {
+        handle<sqlite::open> h_(h);
+        ensure(h_.ptr());
+
+        if (!h_->maintenance) {
+            o = ErrNull;
+        }
+        else {
+            auto status = h_->maintenance->status();
+            o.resize(19, 2);
+            unsigned r = 0;
+            auto row = [&r](const wchar_t* name, const OPER& value) {
+                o(r, 0) = name;
+                o(r, 1) = value;
+                ++r;
+            };
+            auto task = [&row](const std::wstring& name, const sqlite::maintenance_task& t) {
+                using namespace std::chrono;
+                row((name + L".runs").c_str(), OPER(static_cast<double>(t.runs)));
+                row((name + L".errors").c_str(), OPER(static_cast<double>(t.errors)));
+                if (t.runs) {
+                    // Excel date from Unix time
+                    double secs = duration<double>(t.last.time_since_epoch()).count();
+                    row((name + L".last").c_str(), OPER(secs / 86400 + 25569));
+                }
+                else {
+                    row((name + L".last").c_str(), ErrNA);
+                }
+                row((name + L".seconds").c_str(), OPER(t.seconds));
+                std::wstring error = widen(t.error.c_str(), static_cast<int>(t.error.size()));
+                row((name + L".error").c_str(), OPER(error.c_str(), error.size()));
+            };
+            row(L"running", OPER(status.running));
+            row(L"idle", OPER(status.idle));
+            task(L"optimize", status.optimize);
+            task(L"analyze", status.analyze);
+            task(L"checkpoint", status.checkpoint);
+            row(L"wal_frames", OPER(static_cast<double>(status.wal_frames)));
+            row(L"checkpointed_frames", OPER(static_cast<double>(status.checkpointed_frames)));
+        }
+    }
+    catch (const std::exception& ex) {
+        XLL_ERROR(ex.what());
+    }
+
+    return &o;
+}
+
+AddIn xai_sqlite_write_queue(
+    Function(XLL_HANDLE, "xll_sqlite_write_queue", "SQLITE.WRITE.QUEUE")
+    .Arguments({
+        Arg(XLL_HANDLE, "handle", "is the sqlite3 database handle returned by SQLITE.OPEN with SQLITE_OPEN_READWRITE."),
+        Arg(XLL_LPOPER4, "_options", "is an optional two column range of names and values for batch, delay, and busy_timeout."),
+        })
+    .Uncalced()
+    .Category(CATEGORY)
+    .FunctionHelp("Commit pending writes and configure the write queue used by SQLITE.WRITE. Return the database handle.")
+    .HelpTopic("https://www.sqlite.org/lang_transaction.html")
+    .Documentation("A batch commits when it has batch writes or its oldest write has waited delay seconds. "
+        "Defaults are 1000 and 0.05. The busy_timeout option is in milliseconds. Default is 5000.")
+);
+HANDLEX WINAPI xll_sqlite_write_queue(HANDLEX h, const LPOPER4 poptions)
+{
+#pragma XLLEXPORT
+    try {
+        handle<sqlite::open> h_(h);
+        ensure(h_.ptr());
+
+        sqlite::write_options options;
+        if (!poptions->is_missing()) {
+            ensure(poptions->columns() == 2);
+            for (unsigned i = 0; i < poptions->rows(); ++i) {
+                std::string_view key = view((*poptions)(i, 0));
+                const OPER4& val = (*poptions)(i, 1);
+                if (key == "batch") {
+                    ensure((val.is_num() and val.val.num >= 1) or !"SQLITE.WRITE.QUEUE: batch must be a positive number");
+                    options.batch = static_cast<size_t>(val.val.num);
+                }
+                else if (key == "delay") {
+                    ensure(val.is_num() or !"SQLITE.WRITE.QUEUE: delay must be a number of seconds");
+                    options.delay = std::chrono::milliseconds(static_cast<long long>(val.val.num * 1000));
+                }
+                else if (key == "busy_timeout") {
+                    ensure(val.is_num() or !"SQLITE.WRITE.QUEUE: busy_timeout must be a number");
+                    options.busy_timeout = static_cast<int>(val.val.num);
+                }
+                else {
+                    ensure(!"SQLITE.WRITE.QUEUE: unknown option");
+                }
+            }
+        }
+        // the old queue commits its writes before the new one starts
+        h_->writer.reset();
+        h_->writer = std::make_shared<sqlite::write_queue>(*h_, options);
+    }
+    catch (const std::exception& ex) {
+        XLL_ERROR(ex.what());
+    }
+
+    return h;
+}
+
+AddIn xai_sqlite_write(
+    Function(XLL_HANDLE, "xll_sqlite_write", "SQLITE.WRITE")
+    .Arguments({
+        Arg(XLL_HANDLE, "handle", "is the sqlite3 database handle returned by SQLITE.OPEN with SQLITE_OPEN_READWRITE."),
+        Arg(XLL_CSTRING4, "sql", "is a single INSERT, UPDATE, DELETE, or other statement."),
+        Arg(XLL_LPOPER4, "_params", "is an optional range of parameters to bind to ?1, ?2, ...."),
+        })
+    .Uncalced()
+    .Category(CATEGORY)
+    .FunctionHelp("Queue a statement to be committed with other writes and return a handle to its result.")
+    .HelpTopic("https://www.sqlite.org/lang_transaction.html")
+    .Documentation("Writes from many cells are grouped into one transaction instead of one each. "
+        "Use SQLITE.WRITE.RESULT for the outcome and SQLITE.WRITE.FLUSH to wait for pending writes. "
+        "Transaction control statements such as BEGIN and COMMIT are not allowed.")
+);
+HANDLEX WINAPI xll_sqlite_write(HANDLEX h, const char* sql, const LPOPER4 pparams)
+{
+#pragma XLLEXPORT
+    HANDLEX result = INVALID_HANDLEX;
+
+    try {
+        handle<sqlite::open> h_(h);
+        ensure(h_.ptr());
+
+        handle<sqlite::write_ticket> t_(new sqlite::write_ticket(sqlite::write(*h_, sql, sqlite_params(*pparams))));
+        result = t_.get();
+    }
+    catch (const std::exception& ex) {
+        XLL_ERROR(ex.what());
+    }
+
+    return result;
+}
+
+AddIn xai_sqlite_write_result(
+    Function(XLL_LPOPER, "xll_sqlite_write_result", "SQLITE.WRITE.RESULT")
+    .Arguments({
+        Arg(XLL_HANDLE, "write", "is a handle returned by SQLITE.WRITE."),
+        })
+    .Category(CATEGORY)
+    .FunctionHelp("Return the state, rows changed, and error message of a queued write.")
+    .Documentation("The state is pending, committed, or failed. Recalculate to refresh.")
+);
+LPOPER WINAPI xll_sqlite_write_result(HANDLEX w)
+{
+#pragma XLLEXPORT
+    static OPER o;
+    o = ErrNA;
+
+    try {
+        handle<sqlite::write_ticket> w_(w);
+        ensure(w_.ptr());
+
+        const sqlite::write_result& r = **w_;
+        o.resize(1, 3);
+        switch (r.state.load(std::memory_order_acquire)) {
+        case sqlite::write_result::pending:
+            o(0, 0) = L"pending";
+            o(0, 1) = ErrNA;
+            o(0, 2) = L"";
+            break;
+        case sqlite::write_result::committed:
+            o(0, 0) = L"committed";
+            o(0, 1) = r.rows;
+            o(0, 2) = L"";
+            break;
+        default: {
+            o(0, 0) = L"failed";
+            o(0, 1) = 0;
+            std::wstring error = widen(r.error.c_str(), static_cast<int>(r.error.size()));
+            o(0, 2) = OPER(error.c_str(), error.size());
+        }
+        }
+    }
+    catch (const std::exception& ex) {
+        XLL_ERROR(ex.what());
+    }
+
+    return &o;
+}
+
+AddIn xai_sqlite_write_flush(
+    Function(XLL_LPOPER, "xll_sqlite_write_flush", "SQLITE.WRITE.FLUSH")
+    .Arguments({
+        Arg(XLL_HANDLE, "handle", "is the sqlite3 database handle returned by SQLITE.OPEN."),
+        })
+    .Uncalced()
+    .Category(CATEGORY)
+    .FunctionHelp("Wait for queued writes to commit and return a two column range of write queue statistics.")
+    .Documentation("Statistics are writes, errors, batches, pending, rows, and seconds spent in transactions.")
+);
+LPOPER WINAPI xll_sqlite_write_flush(HANDLEX h)
+{
+#pragma XLLEXPORT
+    static OPER o;
+    o = ErrNA;
+
+    try {
+        handle<sqlite::open> h_(h);
+        ensure(h_.ptr());
+
+        if (!h_->writer) {
+            o = ErrNull;
+        }
+        else {
+            h_->writer->flush();
+            auto stats = h_->writer->stats();
+            o.resize(6, 2);
+            o(0, 0) = L"writes";
+            o(0, 1) = static_cast<double>(stats.writes);
+            o(1, 0) = L"errors";
+            o(1, 1) = static_cast<double>(stats.errors);
+            o(2, 0) = L"batches";
+            o(2, 1) = static_cast<double>(stats.batches);
+            o(3, 0) = L"pending";
+            o(3, 1) = static_cast<double>(stats.pending);
+            o(4, 0) = L"rows";
+            o(4, 1) = static_cast<double>(stats.rows);
+            o(5, 0) = L"seconds";
+            o(5, 1) = stats.seconds;
+        }
+    }
+    catch (const std::exception& ex) {
+        XLL_ERROR(ex.what());
+    }
+
+    return &o;
+}
+
+AddIn xai_sqlite_begin(
+    Function(XLL_HANDLE, "xll_sqlite_begin", "SQLITE.BEGIN")
+    .Arguments({
+        Arg(XLL_HANDLE, "handle", "is the sqlite3 database handle returned by SQLITE.OPEN."),
+        Arg(XLL_CSTRING4, "_mode", "is an optional mode of \"DEFERRED\", \"IMMEDIATE\", or \"EXCLUSIVE\". Default is \"DEFERRED\"."),
+        })
+    .Uncalced()
+    .Category(CATEGORY)
+    .FunctionHelp("Begin a transaction and return a handle to it.")
+    .HelpTopic("https://www.sqlite.org/lang_transaction.html")
+    .Documentation("Statements run on the database are part of the transaction until SQLITE.COMMIT or SQLITE.ROLLBACK. "
+        "The transaction is rolled back if its handle is deleted or recalculated before it ends.")
+);
+HANDLEX WINAPI xll_sqlite_begin(HANDLEX h, const char* mode)
+{
+#pragma XLLEXPORT
+    HANDLEX t = INVALID_HANDLEX;
+
+    try {
+        handle<sqlite::open> h_(h);
+        ensure(h_.ptr());
+
+        auto m = sqlite::transaction::mode::deferred;
+        if (!*mode || 0 == sqlite3_stricmp(mode, "DEFERRED"))
+            m = sqlite::transaction::mode::deferred;
+        else if (0 == sqlite3_stricmp(mode, "IMMEDIATE"))
+            m = sqlite::transaction::mode::immediate;
+        else if (0 == sqlite3_stricmp(mode, "EXCLUSIVE"))
+            m = sqlite::transaction::mode::exclusive;
+        else
+            ensure(!"SQLITE.BEGIN: mode must be DEFERRED, IMMEDIATE, or EXCLUSIVE");
+
+        handle<sqlite::transaction> t_(new sqlite::transaction(*h_, m));
+        t = t_.get();
+    }
+    catch (const std::exception& ex) {
+        XLL_ERROR(ex.what());
+    }
+
+    return t;
+}
+
+AddIn xai_sqlite_commit(
+    Function(XLL_BOOL, "xll_sqlite_commit", "SQLITE.COMMIT")
+    .Arguments({
+        Arg(XLL_HANDLE, "transaction", "is a handle returned by SQLITE.BEGIN."),
+        })
+    .Uncalced()
+    .Category(CATEGORY)
+    .FunctionHelp("Commit a transaction and return TRUE.")
+    .HelpTopic("https://www.sqlite.org/lang_transaction.html")
+);
+BOOL WINAPI xll_sqlite_commit(HANDLEX t)
+{
+#pragma XLLEXPORT
+    BOOL b = FALSE;
+
+    try {
+        handle<sqlite::transaction> t_(t);
+        ensure(t_.ptr());
+
+        t_->commit();
+        b = TRUE;
+    }
+    catch (const std::exception& ex) {
+        XLL_ERROR(ex.what());
+    }
+
+    return b;
+}
+
+AddIn xai_sqlite_rollback(
+    Function(XLL_BOOL, "xll_sqlite_rollback", "SQLITE.ROLLBACK")
+    .Arguments({
+        Arg(XLL_HANDLE, "transaction", "is a handle returned by SQLITE.BEGIN."),
+        })
+    .Uncalced()
+    .Category(CATEGORY)
+    .FunctionHelp("Roll back a transaction and return TRUE.")
+    .HelpTopic("https://www.sqlite.org/lang_transaction.html")
+);
+BOOL WINAPI xll_sqlite_rollback(HANDLEX t)
+{
+#pragma XLLEXPORT
+    BOOL b = FALSE;
+
+    try {
+        handle<sqlite::transaction> t_(t);
+        ensure(t_.ptr());
+
+        t_->rollback();
+        b = TRUE;
+    }
+    catch (const std::exception& ex) {
+        XLL_ERROR(ex.what());
+    }
+
+    return b;
+}
+
+AddIn xai_sqlite_savepoint(
+    Function(XLL_HANDLE, "xll_sqlite_savepoint", "SQLITE.SAVEPOINT")
+    .Arguments({
+        Arg(XLL_HANDLE, "transaction", "is a handle returned by SQLITE.BEGIN."),
+        Arg(XLL_CSTRING4, "_name", "is an optional name of the savepoint. Default is sp1, sp2, ...."),
+        })
+    .Uncalced()
+    .Category(CATEGORY)
+    .FunctionHelp("Start a savepoint in a transaction and return a handle to it.")
+    .HelpTopic("https://www.sqlite.org/lang_savepoint.html")
+    .Documentation("Savepoints nest in the order they are created. "
+        "Releasing or rolling back a savepoint also ends the savepoints created after it. "
+        "The savepoint is rolled back if its handle is deleted or recalculated before it ends.")
+);
+HANDLEX WINAPI xll_sqlite_savepoint(HANDLEX t, const char* name)
+{
+#pragma XLLEXPORT
+    HANDLEX s = INVALID_HANDLEX;
+
+    try {
+        handle<sqlite::transaction> t_(t);
+        ensure(t_.ptr());
+
+        handle<sqlite::savepoint> s_(new sqlite::savepoint(*t_, name));
+        s = s_.get();
+    }
+    catch (const std::exception& ex) {
+        XLL_ERROR(ex.what());
+    }
+
+    return s;
+}
+
+AddIn xai_sqlite_release(
+    Function(XLL_BOOL, "xll_sqlite_release", "SQLITE.RELEASE")
+    .Arguments({
+        Arg(XLL_HANDLE, "savepoint", "is a handle returned by SQLITE.SAVEPOINT."),
+        })
+    .Uncalced()
+    .Category(CATEGORY)
+    .FunctionHelp("Keep the changes made since a savepoint and return TRUE.")
+    .HelpTopic("https://www.sqlite.org/lang_savepoint.html")
+);
+BOOL WINAPI xll_sqlite_release(HANDLEX s)
+{
+#pragma XLLEXPORT
+    BOOL b = FALSE;
+
+    try {
+        handle<sqlite::savepoint> s_(s);
+        ensure(s_.ptr());
+
+        s_->release();
+        b = TRUE;
+    }
+    catch (const std::exception& ex) {
+        XLL_ERROR(ex.what());
+    }
+
+    return b;
+}
+
+AddIn xai_sqlite_rollback_to(
+    Function(XLL_BOOL, "xll_sqlite_rollback_to", "SQLITE.ROLLBACK_TO")
+    .Arguments({
+        Arg(XLL_HANDLE, "savepoint", "is a handle returned by SQLITE.SAVEPOINT."),
+        })
+    .Uncalced()
+    .Category(CATEGORY)
+    .FunctionHelp("Undo the changes made since a savepoint, end it, and return TRUE.")
+    .HelpTopic("https://www.sqlite.org/lang_savepoint.html")
+);
+BOOL WINAPI xll_sqlite_rollback_to(HANDLEX s)
+{
+#pragma XLLEXPORT
+    BOOL b = FALSE;
+
+    try {
+        handle<sqlite::savepoint> s_(s);
+        ensure(s_.ptr());
+
+        s_->rollback();
+        b = TRUE;
+    }
+    catch (const std::exception& ex) {
+        XLL_ERROR(ex.what());
+    }
+
+    return b;
+}
+
+AddIn xai_sqlite_lookaside(
+    Function(XLL_HANDLE, "xll_sqlite_lookaside", "SQLITE.LOOKASIDE")
+    .Arguments({
+        Arg(XLL_HANDLE, "handle", "is the sqlite3 database handle returned by SQLITE.OPEN."),
+        Arg(XLL_LONG, "size", "is the size in bytes of each lookaside slot."),
+        Arg(XLL_LONG, "count", "is the number of lookaside slots. Use 0 to disable lookaside."),
+        })
+    .Uncalced()
+    .Category(CATEGORY)
+    .FunctionHelp("Set the lookaside memory of a database connection and return the database handle.")
+    .HelpTopic("https://www.sqlite.org/malloc.html#lookaside")
+    .Documentation("Lookaside serves small allocations of a connection without calling the allocator. "
+        "Call before the connection runs any statement.")
+);
+HANDLEX WINAPI xll_sqlite_lookaside(HANDLEX h, LONG size, LONG count)
+{
+#pragma XLLEXPORT
+    try {
+        handle<sqlite::open> h_(h);
+        ensure(h_.ptr());
+        ensure(size >= 0 and count >= 0);
+
+        sqlite::lookaside(*h_, size, count);
+    }
+    catch (const std::exception& ex) {
+        XLL_ERROR(ex.what());
+    }
+
+    return h;
+}
+
+AddIn xai_sqlite_pool(
+    Function(XLL_LPOPER, "xll_sqlite_pool", "SQLITE.POOL")
+    .Category(CATEGORY)
+    .FunctionHelp("Return a two column range of pool allocator statistics.")
+    .HelpTopic("https://www.sqlite.org/c3ref/mem_methods.html")
+    .Documentation("Set the environment variable XLLSQLITE_MALLOC=pool before starting Excel to use the pool allocator. "
+        "Statistics are installed, allocations, frees, reallocs, large, cached, used, peak, and reserved bytes. "
+        "Recalculate to refresh.")
+);
+LPOPER WINAPI xll_sqlite_pool()
+{
+#pragma XLLEXPORT
+    static OPER o;
+    o = ErrNA;
+
+    try {
+        auto stats = sqlite::pool_status();
+        o.resize(9, 2);
+        o(0, 0) = L"installed";
+        o(0, 1) = stats.installed;
+        o(1, 0) = L"allocations";
+        o(1, 1) = static_cast<double>(stats.allocations);
+        o(2, 0) = L"frees";
+        o(2, 1) = static_cast<double>(stats.frees);
+        o(3, 0) = L"reallocs";
+        o(3, 1) = static_cast<double>(stats.reallocs);
+        o(4, 0) = L"large";
+        o(4, 1) = static_cast<double>(stats.large);
+        o(5, 0) = L"cached";
+        o(5, 1) = static_cast<double>(stats.cached);
+        o(6, 0) = L"used";
+        o(6, 1) = static_cast<double>(stats.used);
+        o(7, 0) = L"peak";
+        o(7, 1) = static_cast<double>(stats.peak);
+        o(8, 0) = L"reserved";
+        o(8, 1) = static_cast<double>(stats.reserved);
+    }
+    catch (const std::exception& ex) {
+        XLL_ERROR(ex.what());
+    }
+
+    return &o;
+}
+
+AddIn xai_sqlite_pcache(
+    Function(XLL_LPOPER, "xll_sqlite_pcache", "SQLITE.PCACHE")
+    .Arguments({
+        Arg(XLL_HANDLE, "_handle", "is an optional sqlite3 database handle returned by SQLITE.OPEN."),
+        })
+    .Category(CATEGORY)
+    .FunctionHelp("Return page cache statistics for each database of a connection, or for each database file if no handle is given.")
+    .HelpTopic("https://www.sqlite.org/c3ref/pcache_methods2.html")
+    .Documentation("Set the environment variable XLLSQLITE_PCACHE to a number of megabytes before starting Excel "
+        "to share one page cache budget between all connections. "
+        "Columns are file, schema, caches, pages, pinned, bytes, hits, misses, evictions, and hit rate. "
+        "The last row is the total over all connections. Recalculate to refresh.")
+);
+LPOPER WINAPI xll_sqlite_pcache(HANDLEX h)
+{
+#pragma XLLEXPORT
+    static OPER o;
+    o = ErrNA;
+
+    try {
+        ensure(sqlite::pcache_installed() or !"SQLITE.PCACHE: set XLLSQLITE_PCACHE before starting Excel");
+
+        std::vector<sqlite::pcache_stats> stats;
+        if (h) {
+            handle<sqlite::open> h_(h);
+            ensure(h_.ptr());
+            stats = sqlite::pcache_connection(*h_);
+        }
+        else {
+            stats = sqlite::pcache_files();
+        }
+        stats.push_back(sqlite::pcache_total());
+        stats.back().file = "total";
+
+        o.resize(static_cast<unsigned>(stats.size()) + 1, 10);
+        o(0, 0) = L"file";
+        o(0, 1) = L"schema";
+        o(0, 2) = L"caches";
+        o(0, 3) = L"pages";
+        o(0, 4) = L"pinned";
+        o(0, 5) = L"bytes";
+        o(0, 6) = L"hits";
+        o(0, 7) = L"misses";
+        o(0, 8) = L"evictions";
+        o(0, 9) = L"hit_rate";
+        unsigned r = 1;
+        for (const auto& s : stats) {
+            std::wstring file = widen(s.file.c_str(), static_cast<int>(s.file.size()));
+            o(r, 0) = OPER(file.c_str(), file.size());
+            std::wstring schema = widen(s.schema.c_str(), static_cast<int>(s.schema.size()));
+            o(r, 1) = OPER(schema.c_str(), schema.size());
+            o(r, 2) = static_cast<double>(s.caches);
+            o(r, 3) = static_cast<double>(s.pages);
+            o(r, 4) = static_cast<double>(s.pinned);
+            o(r, 5) = static_cast<double>(s.bytes);
+            o(r, 6) = static_cast<double>(s.hits);
+            o(r, 7) = static_cast<double>(s.misses);
+            o(r, 8) = static_cast<double>(s.evictions);
+            o(r, 9) = s.hit_rate();
+            ++r;
+        }
+    }
+    catch (const std::exception& ex) {
+        XLL_ERROR(ex.what());
+    }
+
+    return &o;
+}
+
+AddIn xai_sqlite_pcache_budget(
+    Function(XLL_DOUBLE, "xll_sqlite_pcache_budget", "SQLITE.PCACHE.BUDGET")
+    .Arguments({
+        Arg(XLL_DOUBLE, "_megabytes", "is an optional new budget for the shared page cache."),
+        })
+    .Uncalced()
+    .Category(CATEGORY)
+    .FunctionHelp("Set the memory budget of the shared page cache and return it in megabytes.")
+    .HelpTopic("https://www.sqlite.org/c3ref/pcache_methods2.html")
+    .Documentation("Lowering the budget evicts least recently used pages until the cache fits.")
+);
+double WINAPI xll_sqlite_pcache_budget(double megabytes)
+{
+#pragma XLLEXPORT
+    double mb = 0;
+
+    try {
+        ensure(sqlite::pcache_installed() or !"SQLITE.PCACHE.BUDGET: set XLLSQLITE_PCACHE before starting Excel");
+
+        if (megabytes > 0)
+            sqlite::pcache_budget(static_cast<sqlite_int64>(megabytes * 1024 * 1024));
+        mb = sqlite::pcache_budget() / (1024. * 1024);
+    }
+    catch (const std::exception& ex) {
+        XLL_ERROR(ex.what());
+    }
+
+    return mb;
+}
+
+AddIn xai_sqlite_status(
+    Function(XLL_LPOPER, "xll_sqlite_status", "SQLITE.STATUS")
+    .Arguments({
+        Arg(XLL_HANDLE, "_handle", "is an optional sqlite3 database handle returned by SQLITE.OPEN."),
+        Arg(XLL_BOOL, "_reset", "is an optional argument to reset highwater marks after reading them. Default is false."),
+        })
+    .Category(CATEGORY)
+    .FunctionHelp("Return memory and cache counters of a connection, or of the process if no handle is given.")
+    .HelpTopic("https://www.sqlite.org/c3ref/db_status.html")
+    .Documentation("Columns are name, current value, and highwater mark. "
+        "Connection counters come from sqlite3_db_status followed by the statement cache, schema cache, and write queue. "
+        "Process counters come from sqlite3_status64 followed by the pool allocator and shared page cache if installed.")
+);
+LPOPER WINAPI xll_sqlite_status(HANDLEX h, BOOL reset)
+{
+#pragma XLLEXPORT
+    static OPER o;
+    o = ErrNA;
+
+    try {
+        std::vector<sqlite::status_counter> counters;
+        if (h) {
+            handle<sqlite::open> h_(h);
+            ensure(h_.ptr());
+            counters = sqlite::status(*h_, reset != FALSE);
+        }
+        else {
+            counters = sqlite::status(reset != FALSE);
+        }
+
+        o.resize(static_cast<unsigned>(counters.size()) + 1, 3);
+        o(0, 0) = L"name";
+        o(0, 1) = L"current";
+        o(0, 2) = L"highwater";
+        unsigned r = 1;
+        for (const auto& c : counters) {
+            std::wstring name = widen(c.name.c_str(), static_cast<int>(c.name.size()));
+            o(r, 0) = OPER(name.c_str(), name.size());
+            o(r, 1) = static_cast<double>(c.current);
+            o(r, 2) = static_cast<double>(c.highwater);
+            ++r;
+        }
+    }
+    catch (const std::exception& ex) {
+        XLL_ERROR(ex.what());
+    }
+
+    return &o;
+}
@@ -1,154 +1,60 @@
 // xllsqlite.h - sqlite3 wrapper
 #pragma once
-#include "sqlite3.h"
+#include <cmath>
+#include "sqlite.h"
+#include "carray.h"
+#include "range.h"
+#include "utf.h"
+#include "builder.h"
 #include "xll/xll/xll.h"
 
 #define CATEGORY "SQLite"
 
-namespace sqlite {
-
-    enum class Type {
-        Integer = SQLITE_INTEGER,
-        Float = SQLITE_FLOAT,
-        Text = SQLITE_TEXT,
-        Blob = SQLITE_BLOB,
-        Null = SQLITE_NULL,
-    };
-
-    class value {
-        sqlite3_value* val;
-    public:
-        value()
-            : val(sqlite3_value_dup(nullptr))
-        { }
-        value(const value& v)
-            : val(sqlite3_value_dup(v.val))
-        { }
-        value& operator=(const value& v)
-        {
-            if (this != &v) {
-                sqlite3_value_free(val);
-                val = sqlite3_value_dup(v.val);
-            }
-
-            return *this;
-        }
-        value(value&& v) noexcept
-            : val(v.val)
-        {
-            v.val = sqlite3_value_dup(0);
-        }
-        value& operator=(value&& v) noexcept
-        {
-            std::swap(val, v.val);
+// convert wide string to UTF-8
+// Use utf::to_utf8 to avoid allocating.
+inline std::string narrow(const wchar_t* ws, int ns = -1)
+{
+    size_t n = ns == -1 ? wcslen(ws) : ns;
+    std::string s(utf::narrow_size(n), 0);
+    s.resize(utf::narrow(ws, n, s.data()));
 
-            return *this;
-        }
-        ~value()
-        {
-            sqlite3_value_free(val);
-        }
+    return s;
+}
 
-        int type() const
-        {
-            return sqlite3_value_type(val);
-        }
+// convert UTF-8 to wide string
+inline std::wstring widen(const char* s, int ns = -1)
+{
+    size_t n = ns == -1 ? strlen(s) : ns;
+    std::wstring ws(utf::widen_size(n), 0);
+    ws.resize(utf::widen(s, n, ws.data()));
 
-        int bytes() const
-        {
-            return sqlite3_value_bytes(val);
-        }
-    };
-
-    // Sqlite converts wide strings to UTF-8 so we avoid *16* functions.
-    class open {
-        sqlite3* pdb;
-    public:
-        open(const char* file, int flags = SQLITE_OPEN_READONLY)
-        {
-            if (SQLITE_OK != sqlite3_open_v2(file, &pdb, flags, 0))
-                throw std::runtime_error(sqlite3_errmsg(pdb));
-        }
-        open(const open&) = delete;
-        open& operator=(const open&) = delete;
-        ~open()
-        {
-            sqlite3_close(pdb);
-        }
-        // for use in sqlite3_* functions
-        operator sqlite3*() {
-            return pdb;
-        }
-        class stmt {
-            sqlite::open& db;
-            sqlite3_stmt* pstmt;
-            const char* tail_;
-        public:
-            stmt(sqlite::open& db)
-                : db(db), pstmt(nullptr), tail_(nullptr)
-            { }
-            stmt(const stmt&) = delete;
-            stmt& operator=(const stmt&) = delete;
-            ~stmt()
-            {
-                sqlite3_finalize(pstmt);
-            }
-            // for use in sqlite3_* functions
-            operator sqlite3_stmt*()
-            {
-                return pstmt;
-            }
-            const char* errmsg() const
-            {
-                return sqlite3_errmsg(db);
-            }
-            int prepare(const char* sql, int nsql = -1)
-            {
-                return sqlite3_prepare_v2(db, sql, nsql, &pstmt, &tail_);
-            }
-            const char* tail() const
-            {
-                return tail_;
-            }
-            int bind(int col, int i)
-            {
-                return sqlite3_bind_int(pstmt, col, i);
-            }
-            int bind(int col, sqlite_int64 i)
-            {
-                return sqlite3_bind_int64(pstmt, col, i);
-            }
-            int bind(int col, double d)
-            {
-                return sqlite3_bind_double(pstmt, col, d);
-            }
-            // Do not make a copy of text by default.
-            int bind(int col, const char* t, int n = -1, void(*dealloc)(void*) = SQLITE_STATIC)
-            {
-                return sqlite3_bind_text(pstmt, col, t, n, dealloc);
-            }
-        };
-    };
+    return ws;
 }
 
-// convert wide string to UTF-8
-inline std::string narrow(const wchar_t* ws, int ns = -1)
+// Characters of a string OPER.
+inline std::string_view view(const xll::OPER4& o)
 {
-    std::string s;
+    ensure(o.is_str());
 
-    int n;
-    if (ns == -1) {
-        n = WideCharToMultiByte(CP_UTF8, 0, ws, ns, 0, 0, 0, 0);
-    }
-    else {
-        n = ns;
-    }
-    s.reserve(n);
-    
-    int rc = WideCharToMultiByte(CP_UTF8, 0, ws, ns, &s[0], n, 0, 0);
-    ensure (rc != 0);
+    return std::string_view((const char*)o.val.str + 1, o.val.str[0]);
+}
+inline std::wstring_view view(const xll::OPER12& o)
+{
+    ensure(o.is_str());
 
-    return s;
+    return std::wstring_view(o.val.str + 1, o.val.str[0]);
+}
+
+// UTF-8 copy of a string OPER.
+inline std::string utf8(const xll::OPER4& o)
+{
+    return std::string(view(o));
+}
+inline std::string utf8(const xll::OPER12& o)
+{
+    auto v = view(o);
+
+    return narrow(v.data(), static_cast<int>(v.size()));
 }
 
 // Sqlite type of oper.
@@ -164,52 +70,181 @@ inline const char* sqlite_type(const xll::OPER4& o)
     return "TEXT";
 }
 
-// Works like sqlite3_exec but returns an OPER.
-inline xll::OPER4 sqlite_exec(sqlite::open& db, const char* sql, bool header = false)
+// Whether x is a whole number in the range of sqlite_int64.
+// The range is checked first since converting a double outside it is undefined.
+inline bool sqlite_is_int64(double x)
 {
-    xll::OPER4 o;
+    return x >= -9223372036854775808.0 && x < 9223372036854775808.0 && x == std::trunc(x);
+}
 
-    sqlite::open::stmt stmt(db);
-    int rc = stmt.prepare(sql);
-    if (SQLITE_OK != rc)
-        throw std::runtime_error(stmt.errmsg());
-    
-    rc = sqlite3_step(stmt);
-    if (rc != SQLITE_ROW && rc != SQLITE_DONE)
-        throw std::runtime_error(stmt.errmsg());
-   
-    int n = sqlite3_column_count(stmt);
-    if (header) {
-        xll::OPER4 head(1, n);
-        for (int i = 0; i < n; ++i) {
-            head[i] = sqlite3_column_name(stmt, i);
+// Bind cell of a range to parameter col without copying text.
+// Whole numbers bind as integers as in sqlite_param.
+inline int sqlite_bind(sqlite3_stmt* stmt, int col, const xll::OPER4& o)
+{
+    switch (o.type()) {
+    case xltypeNum:
+        if (sqlite_is_int64(o.val.num))
+            return sqlite3_bind_int64(stmt, col, (sqlite_int64)o.val.num);
+        return sqlite3_bind_double(stmt, col, o.val.num);
+    case xltypeStr:
+        return sqlite3_bind_text(stmt, col, (const char*)o.val.str + 1, o.val.str[0], SQLITE_STATIC);
+    case xltypeBool:
+        return sqlite3_bind_int(stmt, col, o.val.xbool ? 1 : 0);
+    case xltypeBigData:
+        return sqlite3_bind_blob(stmt, col, o.val.bigdata.h.lpbData, o.val.bigdata.cbData, SQLITE_STATIC);
+    }
+
+    return sqlite3_bind_null(stmt, col);
+}
+inline int sqlite_bind(sqlite3_stmt* stmt, int col, const xll::OPER12& o)
+{
+    switch (o.type()) {
+    case xltypeNum:
+        if (sqlite_is_int64(o.val.num))
+            return sqlite3_bind_int64(stmt, col, (sqlite_int64)o.val.num);
+        return sqlite3_bind_double(stmt, col, o.val.num);
+    case xltypeStr:
+        return sqlite3_bind_text16(stmt, col, o.val.str + 1, o.val.str[0] * sizeof(wchar_t), SQLITE_STATIC);
+    case xltypeBool:
+        return sqlite3_bind_int(stmt, col, o.val.xbool ? 1 : 0);
+    case xltypeBigData:
+        return sqlite3_bind_blob(stmt, col, o.val.bigdata.h.lpbData, o.val.bigdata.cbData, SQLITE_STATIC);
+    }
+
+    return sqlite3_bind_null(stmt, col);
+}
+// Bind cell to a named parameter such as :name, @name, or $name.
+template<class X>
+inline int sqlite_bind(sqlite3_stmt* stmt, const char* name, const X& o)
+{
+    int col = sqlite3_bind_parameter_index(stmt, name);
+    ensure(col != 0 || !"sqlite_bind: no parameter with that name");
+
+    return sqlite_bind(stmt, col, o);
+}
+// Bind row i of a range to ?first, ?first+1, ...
+template<class X>
+inline void sqlite_bind_row(sqlite3_stmt* stmt, const X& o, unsigned i, int first = 1)
+{
+    for (unsigned j = 0; j < o.columns(); ++j) {
+        if (SQLITE_OK != sqlite_bind(stmt, first + j, o[i * o.columns() + j]))
+            throw std::runtime_error(sqlite::errmsg(stmt));
+    }
+}
+
+// Array of numbers or strings in column j of a range, skipping empty cells.
+template<class X>
+inline sqlite::carray sqlite_carray(const X& o, unsigned j)
+{
+    std::vector<double> d;
+    std::vector<std::string> t;
+    bool integral = true;
+    for (unsigned i = 0; i < o.rows(); ++i) {
+        const auto& oij = o(i, j);
+        if (oij.type() == xltypeNum) {
+            d.push_back(oij.val.num);
+            integral = integral && sqlite_is_int64(oij.val.num);
+        }
+        else if (oij.type() == xltypeStr) {
+            t.emplace_back(utf8(oij));
         }
-        o.push_back(head);
     }
-    while (SQLITE_ROW == rc) {
-        xll::OPER4 row(1, n);
-        for (int i = 0; i < n; ++i) {
-            switch (sqlite3_column_type(stmt, i)) {
-            case SQLITE_FLOAT:
-                row[i] = sqlite3_column_double(stmt, i);
-                break;
-            case SQLITE_TEXT:
-                row[i] = (char*)sqlite3_column_text(stmt, i);
-                break;
-            case SQLITE_INTEGER:
-                row[i] = sqlite3_column_int(stmt, i);
-                break;
-            case SQLITE_NULL:
-                row[i] = xll::ErrNull4;
-                break;
-            default:
-                row[i] = xll::ErrNA4;
-            }
+    ensure(d.empty() or t.empty() or !"sqlite_carray: column must be all numbers or all strings");
+
+    if (!t.empty())
+        return sqlite::carray(std::move(t));
+    if (!integral)
+        return sqlite::carray(std::move(d));
+
+    return sqlite::carray(std::vector<sqlite_int64>(d.begin(), d.end()));
+}
+
+// Value of a cell for binding to a builder placeholder.
+template<class X>
+inline sqlite::param sqlite_param(const X& o)
+{
+    switch (o.type()) {
+    case xltypeNum:
+        if (sqlite_is_int64(o.val.num))
+            return (sqlite_int64)o.val.num;
+        return o.val.num;
+    case xltypeStr:
+        return utf8(o);
+    case xltypeBool:
+        return (sqlite_int64)(o.val.xbool ? 1 : 0);
+    }
+
+    return std::monostate{};
+}
+// Values of a range of cells, skipping a missing argument.
+template<class X>
+inline std::vector<sqlite::param> sqlite_params(const X& o)
+{
+    std::vector<sqlite::param> ps;
+
+    if (!o.is_missing()) {
+        for (const auto& oi : o)
+            ps.push_back(sqlite_param(oi));
+    }
+
+    return ps;
+}
+
+// Bind a range of parameters to ?first, ?first+1, ...
+// A single row binds each cell. Multiple rows bind each column as a carray
+// that must be kept alive until the statement is done.
+template<class X>
+inline std::vector<sqlite::carray> sqlite_bind(sqlite3_stmt* stmt, const X& params, int first = 1)
+{
+    std::vector<sqlite::carray> arrays;
+
+    if (params.rows() == 1) {
+        sqlite_bind_row(stmt, params, 0, first);
+    }
+    else {
+        arrays.reserve(params.columns());
+        for (unsigned j = 0; j < params.columns(); ++j) {
+            arrays.push_back(sqlite_carray(params, j));
+            if (SQLITE_OK != arrays.back().bind(stmt, first + j))
+                throw std::runtime_error(sqlite::errmsg(stmt));
         }
-        o.push_back(row);
-        rc = sqlite3_step(stmt);
-    };
+    }
+
+    return arrays;
+}
+
+// Set o to column i of the current row.
+inline void sqlite_column(sqlite3_stmt* stmt, int i, xll::OPER4& o)
+{
+    sqlite::column_cell<xll::OPER4>(stmt, i, o, xll::ErrNull4, xll::ErrNA4);
+}
+
+// Works like sqlite3_exec on a prepared statement but returns an OPER.
+inline xll::OPER4 sqlite_exec(sqlite3_stmt* stmt, bool header = false)
+{
+    return sqlite::rows<xll::OPER4, xll::OPER4>(stmt, header, xll::ErrNull4, xll::ErrNA4);
+}
+
+// Works like sqlite3_exec but returns an OPER.
+inline xll::OPER4 sqlite_exec(sqlite::open& db, const char* sql, bool header = false)
+{
+    sqlite::open::stmt stmt(db);
+    if (SQLITE_OK != stmt.prepare(sql))
+        throw std::runtime_error(stmt.errmsg());
 
-    return o;
+    return sqlite_exec(stmt, header);
 }
 
+// Maximum rows of an OPER4 range.
+constexpr size_t sqlite_max_rows4 = 65536;
+
+// Maximum rows and string length of Excel 2007 and later.
+constexpr size_t sqlite_max_rows12 = sqlite::max_rows12;
+constexpr int sqlite_max_chars12 = sqlite::max_chars12;
+
+// Works like sqlite3_exec on a prepared statement but returns an OPER12.
+// Text is read as UTF-16 with sqlite3_column_text16 into counted wide strings.
+inline xll::OPER sqlite_exec12(sqlite3_stmt* stmt, bool header = false)
+{
+    return sqlite::rows12<xll::OPER, wchar_t, xll::OPER>(stmt, header, xll::ErrNull, xll::ErrNA);
+}